@@ -372,7 +372,8 @@ module minx
         | irq_data_out
         | sys_batt;
 
-    wire [7:0] cpu_data_in =
+    // Public for the harnesses, which log the values of register reads.
+    wire [7:0] cpu_data_in /*verilator public*/ =
     (
         (address_out >= 24'h2000) &&
         (address_out <  24'h2100) &&
@@ -0,0 +1,43 @@
+import csv
+
+# Generates verilator/instruction_table.h, the decode table used by the
+# offline trace tools. Like the instruction_cycles table, entries are indexed
+# by the cpu's extended opcode: 0x000-0x0FF for single byte opcodes, 0x100 +
+# opext for CE-prefixed and 0x200 + opext for CF-prefixed opcodes.
+if __name__ == '__main__':
+
+    fp = open('docs/instructions.csv')
+    rows = list(csv.reader(fp, skipinitialspace=True))
+    fp.close()
+
+    table = [None] * 0x300
+    for row in rows:
+        parts = row[0].split(' ')
+        if parts[0] == 'CE':
+            instruction_index = 0x100 + int(parts[1], 16)
+        elif parts[0] == 'CF':
+            instruction_index = 0x200 + int(parts[1], 16)
+        else:
+            instruction_index = int(parts[0], 16)
+
+        # Strip footnote markers, e.g. 'CALLCB #ss *1'.
+        mnemonic = row[1].split(' *')[0]
+        table[instruction_index] = (mnemonic, len(parts))
+
+    with open('verilator/instruction_table.h', 'w') as fp:
+        fp.write('#pragma once\n\n')
+        fp.write('// Generated by scripts/make_instruction_table.py from docs/instructions.csv.\n')
+        fp.write('// Operand placeholders: #nn/#nnnn unsigned, #ss/#ssss signed, little-endian.\n')
+        fp.write('struct InstructionInfo\n{\n    const char* mnemonic;\n    uint8_t num_bytes;\n};\n\n')
+        fp.write('const InstructionInfo instruction_table[%d] = {\n' % 0x300)
+        for i, entry in enumerate(table):
+            if entry is None:
+                fp.write('    {nullptr, 0},\n')
+            else:
+                fp.write('    {"%s", %d},\n' % entry)
+        fp.write('};\n\n')
+        fp.write('// Returns the extended opcode of the instruction starting at opcode.\n')
+        fp.write('inline int instruction_index(const uint8_t* opcode)\n{\n')
+        fp.write('    if(opcode[0] == 0xCE) return 0x100 + opcode[1];\n')
+        fp.write('    if(opcode[0] == 0xCF) return 0x200 + opcode[1];\n')
+        fp.write('    return opcode[0];\n}\n')
@@ -0,0 +1,89 @@
+import re
+import sys
+
+# Generates the signal registry of a Verilated model (see
+# verilator/signal_registry.h), a table of the hierarchical name, pointer and
+# width of every signal in the model's root class. Run by the build scripts
+# after Verilator, e.g.:
+#
+#     python3 ../scripts/make_signal_registry.py obj_dir/Vminx___024root.h minx_signals.h minx
+#
+# The table is read from the member declarations Verilator writes, which carry
+# the bit range of each signal in a comment:
+#
+#     VL_IN8(clk,0,0);
+#     SData/*15:0*/ minx__DOT__cpu__DOT__BA;
+#     VlUnpacked<CData/*7:0*/, 8192> minx__DOT__eeprom__DOT__rom;
+
+TYPE_SIZES = {'CData': 1, 'SData': 2, 'IData': 4, 'QData': 8}
+PORT_SIZES = {'8': 1, '16': 2, '': 4, '64': 8}
+
+PORT_RE     = re.compile(r'^\s*VL_(?:IN|OUT|INOUT)(8|16|64|)\(&?(\w+),\s*(\d+),\s*(\d+)\);')
+WIDE_PORT_RE = re.compile(r'^\s*VL_(?:IN|OUT|INOUT)W\(&?(\w+),\s*(\d+),\s*(\d+),\s*(\d+)\);')
+SIGNAL_RE   = re.compile(r'^\s*(CData|SData|IData|QData|VlWide<(\d+)>)/\*(\d+):(\d+)\*/\s+(\w+);')
+ARRAY_RE    = re.compile(r'^\s*VlUnpacked<(CData|SData|IData|QData|VlWide<(\d+)>)/\*(\d+):(\d+)\*/,\s*(\d+)>\s+(\w+);')
+
+def signal_name(member):
+    name = member.replace('__DOT__', '.')
+    # Verilator escapes characters that are not valid in C++ as __0XX.
+    return re.sub(r'__0([0-9A-F]{2})', lambda m: chr(int(m.group(1), 16)), name)
+
+def is_internal(member):
+    return member.startswith('__') or '__V' in member
+
+if __name__ == '__main__':
+
+    if len(sys.argv) != 4:
+        print('Usage: make_signal_registry.py <root header> <output header> <top module>')
+        sys.exit(1)
+
+    root_header, output_path, top = sys.argv[1:]
+    root_class = root_header.replace('\\', '/').split('/')[-1][:-2]
+
+    # (name, member, width, size, count)
+    signals = []
+    for line in open(root_header):
+        m = PORT_RE.match(line)
+        if m:
+            size, member, msb, lsb = m.groups()
+            signals.append((member, member, int(msb) - int(lsb) + 1, PORT_SIZES[size], 1))
+            continue
+
+        m = WIDE_PORT_RE.match(line)
+        if m:
+            member, msb, lsb, words = m.groups()
+            signals.append((member, member, int(msb) - int(lsb) + 1, 4 * int(words), 1))
+            continue
+
+        m = SIGNAL_RE.match(line)
+        if m:
+            data_type, words, msb, lsb, member = m.groups()
+            if is_internal(member):
+                continue
+            size = 4 * int(words) if words else TYPE_SIZES[data_type]
+            signals.append((signal_name(member), member, int(msb) - int(lsb) + 1, size, 1))
+            continue
+
+        m = ARRAY_RE.match(line)
+        if m:
+            data_type, words, msb, lsb, count, member = m.groups()
+            if is_internal(member):
+                continue
+            size = 4 * int(words) if words else TYPE_SIZES[data_type]
+            signals.append((signal_name(member), member, int(msb) - int(lsb) + 1, size, int(count)))
+
+    with open(output_path, 'w') as fp:
+        fp.write('#pragma once\n\n')
+        fp.write('// Generated by scripts/make_signal_registry.py from %s.\n\n' % root_header)
+        fp.write('#include <vector>\n\n')
+        fp.write('#include "%s.h"\n' % root_class)
+        fp.write('#include "signal_registry.h"\n\n')
+        fp.write('inline std::vector<SignalInfo> %s_signals(%s* root)\n{\n    return {\n' % (top, root_class))
+        for name, member, width, size, count in signals:
+            if count == 1:
+                fp.write('        {"%s", &root->%s, %d, %d, 1},\n' % (name, member, width, size))
+            else:
+                fp.write('        {"%s", root->%s.m_storage, %d, %d, %d},\n' % (name, member, width, size, count))
+        fp.write('    };\n}\n')
+
+    print('%d signals written to %s.' % (len(signals), output_path))
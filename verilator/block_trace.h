@@ -0,0 +1,241 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.h"
+#include "instruction_table.h"
+
+// Compressed instruction trace. Retired instructions are grouped into basic
+// blocks, runs of sequential instructions that end at the first change in
+// control flow. A block is defined once by its physical start address and
+// length, after which each execution only references its id and timing.
+// Opcode bytes are not stored; trace_unpack reads them back from the bios and
+// cartridge when expanding the trace. Blocks executing from RAM are written
+// out in full every time since the RAM contents may have changed.
+//
+// After the BlockTraceHeader the file is a stream of entries. All integers are
+// LEB128 varints, except cycles and opcode bytes which are single bytes:
+//
+//     0                       <address> <n> <timing>, define and execute block
+//     1                       <address> <n> <timing> <4 opcode bytes * n>
+//     2 + 2 * id              <first delta>, execute block id with its timing
+//     2 + 2 * id + 1          <timing>, execute block id with new timing
+//
+// where <timing> is <first delta> <cycles * n> <delta * (n - 1)>, delta being
+// the timestamp difference to the previously retired instruction. Block ids
+// are assigned in order of definition.
+
+#define BLOCK_TRACE_MAGIC   0x54424D50 // 'PMBT'
+#define BLOCK_TRACE_VERSION 1
+
+const int BLOCK_TRACE_MAX_INSTRUCTIONS = 64;
+
+struct BlockTraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t bios_hash;
+    uint64_t cartridge_hash;
+};
+
+// FNV-1a, used to check that a block trace is expanded with the same bios and
+// cartridge it was recorded with.
+inline uint64_t block_trace_hash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+inline bool block_trace_is_literal(uint32_t address)
+{
+    return address >= 0x1000 && address < 0x2100;
+}
+
+namespace
+{
+    struct BlockTraceWriter
+    {
+        FILE* fp;
+
+        std::unordered_map<uint64_t, uint32_t> block_ids;
+        std::vector<uint32_t> block_timing_offsets;
+        std::vector<uint8_t> block_cycles;
+        std::vector<uint64_t> block_deltas;
+
+        // Block currently being built.
+        uint32_t start_address;
+        uint32_t next_address;
+        int num_instructions;
+        uint64_t first_delta;
+        uint8_t cycles[BLOCK_TRACE_MAX_INSTRUCTIONS];
+        uint64_t deltas[BLOCK_TRACE_MAX_INSTRUCTIONS];
+        uint8_t opcodes[BLOCK_TRACE_MAX_INSTRUCTIONS][4];
+        uint64_t last_timestamp;
+
+        uint64_t num_instructions_written;
+        uint64_t num_bytes_written;
+        size_t buffer_size;
+        uint8_t buffer[1 << 16];
+    };
+
+    void block_trace_flush(BlockTraceWriter* trace)
+    {
+        fwrite(trace->buffer, 1, trace->buffer_size, trace->fp);
+        trace->num_bytes_written += trace->buffer_size;
+        trace->buffer_size = 0;
+    }
+
+    inline void block_trace_put_byte(BlockTraceWriter* trace, uint8_t byte)
+    {
+        if(trace->buffer_size == sizeof(trace->buffer))
+            block_trace_flush(trace);
+        trace->buffer[trace->buffer_size++] = byte;
+    }
+
+    inline void block_trace_put_varint(BlockTraceWriter* trace, uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            block_trace_put_byte(trace, (value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        block_trace_put_byte(trace, value);
+    }
+
+    void block_trace_put_timing(BlockTraceWriter* trace)
+    {
+        block_trace_put_varint(trace, trace->first_delta);
+        for(int i = 0; i < trace->num_instructions; ++i)
+            block_trace_put_byte(trace, trace->cycles[i]);
+        for(int i = 1; i < trace->num_instructions; ++i)
+            block_trace_put_varint(trace, trace->deltas[i]);
+    }
+
+    void block_trace_end_block(BlockTraceWriter* trace)
+    {
+        int n = trace->num_instructions;
+        if(n == 0) return;
+
+        if(block_trace_is_literal(trace->start_address))
+        {
+            block_trace_put_varint(trace, 1);
+            block_trace_put_varint(trace, trace->start_address);
+            block_trace_put_varint(trace, n);
+            block_trace_put_timing(trace);
+            for(int i = 0; i < n; ++i)
+                for(int j = 0; j < 4; ++j)
+                    block_trace_put_byte(trace, trace->opcodes[i][j]);
+        }
+        else
+        {
+            uint64_t key = ((uint64_t)trace->start_address << 8) | n;
+            auto it = trace->block_ids.find(key);
+            if(it == trace->block_ids.end())
+            {
+                trace->block_ids[key] = trace->block_timing_offsets.size();
+                trace->block_timing_offsets.push_back(trace->block_cycles.size());
+                trace->block_cycles.insert(trace->block_cycles.end(), trace->cycles, trace->cycles + n);
+                trace->block_deltas.insert(trace->block_deltas.end(), trace->deltas, trace->deltas + n);
+
+                block_trace_put_varint(trace, 0);
+                block_trace_put_varint(trace, trace->start_address);
+                block_trace_put_varint(trace, n);
+                block_trace_put_timing(trace);
+            }
+            else
+            {
+                uint32_t offset = trace->block_timing_offsets[it->second];
+                bool differs =
+                    memcmp(&trace->block_cycles[offset], trace->cycles, n) != 0 ||
+                    memcmp(&trace->block_deltas[offset + 1], trace->deltas + 1, (n - 1) * sizeof(uint64_t)) != 0;
+
+                block_trace_put_varint(trace, 2 + 2 * (uint64_t)it->second + differs);
+                if(differs)
+                    block_trace_put_timing(trace);
+                else
+                    block_trace_put_varint(trace, trace->first_delta);
+            }
+        }
+
+        trace->num_instructions_written += n;
+        trace->num_instructions = 0;
+    }
+
+    BlockTraceWriter* block_trace_open(const char* filepath, const uint8_t* bios, size_t bios_size, const uint8_t* cartridge, size_t cartridge_size)
+    {
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening block trace file %s.\n", filepath);
+            return nullptr;
+        }
+
+        BlockTraceHeader header = {
+            BLOCK_TRACE_MAGIC, BLOCK_TRACE_VERSION,
+            block_trace_hash(bios, bios_size),
+            block_trace_hash(cartridge, cartridge_size)
+        };
+        fwrite(&header, sizeof(header), 1, fp);
+
+        BlockTraceWriter* trace = new BlockTraceWriter;
+        trace->fp                       = fp;
+        trace->num_instructions         = 0;
+        trace->last_timestamp           = 0;
+        trace->num_instructions_written = 0;
+        trace->num_bytes_written        = sizeof(header);
+        trace->buffer_size              = 0;
+        return trace;
+    }
+
+    void block_trace_close(BlockTraceWriter* trace)
+    {
+        block_trace_end_block(trace);
+        block_trace_flush(trace);
+        fclose(trace->fp);
+
+        printf("Block trace: %llu instructions in %zu blocks, %llu bytes (%.2f bytes/instruction).\n",
+            (unsigned long long)trace->num_instructions_written, trace->block_timing_offsets.size(),
+            (unsigned long long)trace->num_bytes_written,
+            trace->num_instructions_written? (double)trace->num_bytes_written / trace->num_instructions_written: 0.0
+        );
+
+        delete trace;
+    }
+
+    inline void block_trace_write(BlockTraceWriter* trace, const TraceRecord& record)
+    {
+        uint32_t address = trace_physical_address(record.pc, record.cb);
+        uint64_t delta   = record.timestamp - trace->last_timestamp;
+        trace->last_timestamp = record.timestamp;
+
+        if(trace->num_instructions > 0 &&
+            (address != trace->next_address || trace->num_instructions == BLOCK_TRACE_MAX_INSTRUCTIONS))
+        {
+            block_trace_end_block(trace);
+        }
+
+        int i = trace->num_instructions++;
+        if(i == 0)
+        {
+            trace->start_address = address;
+            trace->first_delta   = delta;
+        }
+        trace->deltas[i] = delta;
+        trace->cycles[i] = record.num_cycles;
+        memcpy(trace->opcodes[i], record.opcode, 4);
+
+        // Unknown opcodes always end the block, their length is not known
+        // when expanding.
+        uint8_t num_bytes = instruction_table[instruction_index(record.opcode)].num_bytes;
+        trace->next_address = num_bytes? address + num_bytes: 0xFFFFFFFF;
+    }
+}
@@ -7,5 +7,6 @@ elif [ "$(expr substr $(uname -s) 1 5)" == "Linux" ]
 then
     $VERILATOR_ROOT/bin/verilator -O3 -Wno-fatal -trace --top-module minx -I../rtl --cc ../rtl/minx.sv --exe minx_sdl2_sim.cpp -LDFLAGS "-lGL `sdl2-config  --libs` -lGLEW"
 fi
+python3 ../scripts/make_signal_registry.py obj_dir/Vminx___024root.h minx_signals.h minx
 
 make -C obj_dir/ -f Vminx.mk
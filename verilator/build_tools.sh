@@ -0,0 +1,11 @@
+#!/bin/bash
+# Offline tools for inspecting the output of the simulators.
+mkdir -p tools
+g++ -O2 -o tools/trace_print trace_print.cpp
+g++ -O2 -o tools/trace_diff trace_diff.cpp
+g++ -O2 -o tools/trace_unpack trace_unpack.cpp
+g++ -O2 -o tools/vcd_query vcd_query.cpp
+g++ -O2 -o tools/watch_print watch_print.cpp
+g++ -O2 -o tools/coverage_merge coverage_merge.cpp
+g++ -O2 -o tools/ram_heatmap ram_heatmap.cpp
+g++ -O2 -o tools/video_export video_export.cpp
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+// The bus access of a simulation step, decoded once per step from the bus
+// outputs of the model and passed to everything that counts or logs accesses.
+//
+// An access lasts several simulation steps, is_new is only set on its first.
+// For the CPU that is the rising edge of the read or write condition the
+// harness serves memory on, as pl toggles between two accesses. The PRC keeps
+// pl low while it holds the bus, so its back-to-back reads are told apart by
+// the rising edge of its read and write strobes instead. Accesses to the same
+// address one after the other are new accesses each.
+
+enum
+{
+    BUS_ACCESS_READ,
+    BUS_ACCESS_WRITE,
+    BUS_ACCESS_NUM_TYPES,
+    BUS_ACCESS_NONE = BUS_ACCESS_NUM_TYPES
+};
+
+enum
+{
+    BUS_ACCESS_CPU,
+    BUS_ACCESS_PRC,
+    BUS_ACCESS_NUM_MASTERS
+};
+
+enum
+{
+    BUS_ACCESS_BIOS,
+    BUS_ACCESS_RAM,
+    BUS_ACCESS_IO, // Hardware registers at 0x2000-0x20FF.
+    BUS_ACCESS_CARTRIDGE,
+    BUS_ACCESS_NUM_REGIONS
+};
+
+struct BusAccess
+{
+    int type;
+    int master;
+    int region;
+    uint32_t address;
+    uint8_t data;   // The byte written, or read from a hardware register.
+    bool is_new;    // First step of the access.
+    bool strobe;    // Of the previous step, for the edge.
+};
+
+inline int bus_access_region(uint32_t address)
+{
+    if(address < 0x1000) return BUS_ACCESS_BIOS;
+    if(address < 0x2000) return BUS_ACCESS_RAM;
+    if(address < 0x2100) return BUS_ACCESS_IO;
+    return BUS_ACCESS_CARTRIDGE;
+}
+
+// Call every simulation step. read_cycle and write_cycle are the conditions
+// the harness serves reads and writes on, prc_strobe is read || write of the
+// model. data_in is cpu_data_in of minx.sv, the byte the CPU latches; for
+// the hardware registers minx.sv answers it itself, other reads are served by
+// the harness later in the step and their data is left 0.
+inline void bus_access_decode(BusAccess* access, bool read_cycle, bool write_cycle, bool prc_strobe, bool bus_ack, uint32_t address, uint8_t data_out, uint8_t data_in)
+{
+    access->type    = read_cycle? BUS_ACCESS_READ: (write_cycle? BUS_ACCESS_WRITE: BUS_ACCESS_NONE);
+    access->master  = bus_ack? BUS_ACCESS_PRC: BUS_ACCESS_CPU;
+    access->address = (access->type == BUS_ACCESS_NONE)? 0: address;
+    access->region  = bus_access_region(access->address);
+    if(access->type == BUS_ACCESS_WRITE)
+        access->data = data_out;
+    else if(access->type == BUS_ACCESS_READ && access->region == BUS_ACCESS_IO)
+        access->data = data_in;
+    else
+        access->data = 0;
+
+    bool strobe = access->type != BUS_ACCESS_NONE && (!bus_ack || prc_strobe);
+    access->is_new = strobe && !access->strobe;
+    access->strobe = strobe;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "bus_access.h"
+
+// Bus utilization: the cycles with a bus access by master (CPU, or PRC while
+// bus_ack is set), region (bios, RAM, I/O registers at 0x2000-0x20FF,
+// cartridge) and access type, per frame and in total, and the runs of
+// back-to-back cartridge accesses. A run is a sequence of cartridge accesses
+// without an access to another region in between; its sequential accesses
+// are those to the address after the one before.
+//
+// If a CSV file is open, a row is appended for every frame (ending at
+// frame_complete), with a <master>_<region>_<access> column of cycles for
+// each combination:
+//
+//     frame,timestamp,cycles,busy_cycles,busy_percent,cpu_bios_read,...,prc_cartridge_write,
+//     cartridge_runs,cartridge_run_accesses,cartridge_sequential_accesses,max_cartridge_run
+
+// Run lengths above this are counted in the last bucket.
+const int BUS_STATS_MAX_RUN = 32;
+
+const char* const bus_stats_master_names[BUS_ACCESS_NUM_MASTERS] = {"cpu", "prc"};
+const char* const bus_stats_region_names[BUS_ACCESS_NUM_REGIONS] = {"bios", "ram", "io", "cartridge"};
+const char* const bus_stats_access_names[BUS_ACCESS_NUM_TYPES] = {"read", "write"};
+
+struct BusCounters
+{
+    uint64_t cycles;
+    uint64_t busy_cycles;
+    uint64_t access_cycles[BUS_ACCESS_NUM_MASTERS][BUS_ACCESS_NUM_REGIONS][BUS_ACCESS_NUM_TYPES];
+
+    uint64_t cartridge_runs;
+    uint64_t cartridge_run_accesses;
+    uint64_t cartridge_sequential_accesses;
+    uint32_t max_cartridge_run;
+};
+
+struct BusStats
+{
+    uint32_t frame;
+    BusCounters frame_counters;
+    BusCounters total;
+    uint64_t run_lengths[BUS_STATS_MAX_RUN + 1]; // In total.
+    FILE* csv_fp;
+
+    uint32_t run_length;
+    uint32_t run_address;
+};
+
+inline void bus_stats_end_run(BusStats* stats)
+{
+    if(stats->run_length == 0) return;
+    BusCounters& counters = stats->frame_counters;
+    ++counters.cartridge_runs;
+    counters.cartridge_run_accesses += stats->run_length;
+    counters.max_cartridge_run = std::max(counters.max_cartridge_run, stats->run_length);
+    ++stats->run_lengths[std::min<uint32_t>(stats->run_length, BUS_STATS_MAX_RUN)];
+    stats->run_length = 0;
+}
+
+// Call every clock cycle with its bus access.
+inline void bus_stats_update(BusStats* stats, const BusAccess& bus_access)
+{
+    int master       = bus_access.master;
+    int access       = bus_access.type;
+    uint32_t address = bus_access.address;
+    BusCounters& counters = stats->frame_counters;
+    ++counters.cycles;
+    if(access == BUS_ACCESS_NONE) return;
+
+    int region = bus_access.region;
+    ++counters.busy_cycles;
+    ++counters.access_cycles[master][region][access];
+
+    if(!bus_access.is_new) return;
+    if(region != BUS_ACCESS_CARTRIDGE)
+    {
+        bus_stats_end_run(stats);
+        return;
+    }
+    if(stats->run_length > 0 && address == stats->run_address + 1)
+        ++counters.cartridge_sequential_accesses;
+    ++stats->run_length;
+    stats->run_address = address;
+}
+
+namespace
+{
+    void bus_stats_init(BusStats* stats)
+    {
+        memset(stats, 0, sizeof(BusStats));
+    }
+
+    bool bus_stats_open_csv(BusStats* stats, const char* filepath)
+    {
+        if(stats->csv_fp) fclose(stats->csv_fp);
+        stats->csv_fp = fopen(filepath, "w");
+        if(!stats->csv_fp)
+        {
+            fprintf(stderr, "Error opening bus statistics file %s.\n", filepath);
+            return false;
+        }
+
+        fprintf(stats->csv_fp, "frame,timestamp,cycles,busy_cycles,busy_percent");
+        for(int master = 0; master < BUS_ACCESS_NUM_MASTERS; ++master)
+            for(int region = 0; region < BUS_ACCESS_NUM_REGIONS; ++region)
+                for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+                    fprintf(stats->csv_fp, ",%s_%s_%s", bus_stats_master_names[master], bus_stats_region_names[region], bus_stats_access_names[access]);
+        fprintf(stats->csv_fp, ",cartridge_runs,cartridge_run_accesses,cartridge_sequential_accesses,max_cartridge_run\n");
+        return true;
+    }
+
+    void bus_stats_close_csv(BusStats* stats)
+    {
+        if(!stats->csv_fp) return;
+        fclose(stats->csv_fp);
+        stats->csv_fp = nullptr;
+    }
+
+    void bus_counters_add(BusCounters* total, const BusCounters& counters)
+    {
+        total->cycles      += counters.cycles;
+        total->busy_cycles += counters.busy_cycles;
+        for(int master = 0; master < BUS_ACCESS_NUM_MASTERS; ++master)
+            for(int region = 0; region < BUS_ACCESS_NUM_REGIONS; ++region)
+                for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+                    total->access_cycles[master][region][access] += counters.access_cycles[master][region][access];
+        total->cartridge_runs                += counters.cartridge_runs;
+        total->cartridge_run_accesses        += counters.cartridge_run_accesses;
+        total->cartridge_sequential_accesses += counters.cartridge_sequential_accesses;
+        total->max_cartridge_run = std::max(total->max_cartridge_run, counters.max_cartridge_run);
+    }
+
+    // Call at frame_complete. A run of cartridge accesses in progress is
+    // counted in the frame it ends in.
+    void bus_stats_end_frame(BusStats* stats, uint64_t timestamp)
+    {
+        const BusCounters& counters = stats->frame_counters;
+        if(stats->csv_fp)
+        {
+            FILE* fp = stats->csv_fp;
+            fprintf(fp, "%u,%llu,%llu,%llu,%.2f", stats->frame, (unsigned long long)timestamp,
+                (unsigned long long)counters.cycles, (unsigned long long)counters.busy_cycles,
+                counters.cycles? 100.0 * counters.busy_cycles / counters.cycles: 0.0
+            );
+            for(int master = 0; master < BUS_ACCESS_NUM_MASTERS; ++master)
+                for(int region = 0; region < BUS_ACCESS_NUM_REGIONS; ++region)
+                    for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+                        fprintf(fp, ",%llu", (unsigned long long)counters.access_cycles[master][region][access]);
+            fprintf(fp, ",%llu,%llu,%llu,%u\n",
+                (unsigned long long)counters.cartridge_runs, (unsigned long long)counters.cartridge_run_accesses,
+                (unsigned long long)counters.cartridge_sequential_accesses, counters.max_cartridge_run
+            );
+        }
+
+        bus_counters_add(&stats->total, counters);
+        memset(&stats->frame_counters, 0, sizeof(BusCounters));
+        ++stats->frame;
+    }
+
+    void bus_stats_print_summary(const BusStats* stats)
+    {
+        BusCounters total = stats->total;
+        bus_counters_add(&total, stats->frame_counters);
+        if(total.cycles == 0) return;
+
+        printf("Bus busy for %.2f%% of %llu cycles:\n", 100.0 * total.busy_cycles / total.cycles, (unsigned long long)total.cycles);
+        for(int master = 0; master < BUS_ACCESS_NUM_MASTERS; ++master)
+        {
+            for(int region = 0; region < BUS_ACCESS_NUM_REGIONS; ++region)
+            {
+                const uint64_t* cycles = total.access_cycles[master][region];
+                if(cycles[BUS_ACCESS_READ] + cycles[BUS_ACCESS_WRITE] == 0) continue;
+                printf("    %s %-9s read %6.2f%%, write %6.2f%%\n",
+                    bus_stats_master_names[master], bus_stats_region_names[region],
+                    100.0 * cycles[BUS_ACCESS_READ] / total.cycles, 100.0 * cycles[BUS_ACCESS_WRITE] / total.cycles
+                );
+            }
+        }
+
+        if(total.cartridge_runs == 0) return;
+        printf("%llu cartridge access runs, mean length %.2f, %.2f%% sequential, longest %u:",
+            (unsigned long long)total.cartridge_runs, (double)total.cartridge_run_accesses / total.cartridge_runs,
+            100.0 * total.cartridge_sequential_accesses / total.cartridge_run_accesses, total.max_cartridge_run
+        );
+        for(int length = 1; length <= BUS_STATS_MAX_RUN; ++length)
+        {
+            if(stats->run_lengths[length] == 0) continue;
+            printf(" %d%s:%llu", length, (length == BUS_STATS_MAX_RUN)? "+": "", (unsigned long long)stats->run_lengths[length]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "trace.h"
+#include "instruction_table.h"
+
+// Shadow call stack of the guest code, built from the retired instructions.
+// A frame is pushed by a taken call (CALL*, CINT) or an interrupt entry and
+// popped by RET, RETSKIP or RETI. The entry address of a frame is only known
+// once the next instruction in it retires, which is not the next instruction
+// overall if an interrupt is taken in between.
+//
+// Code that leaves a function without returning, e.g. by dropping the return
+// address from the stack, leaves dead frames behind. A frame is known to be
+// dead once a call or interrupt happens with SP at or above the SP the frame
+// was entered with, and is dropped then.
+//
+// call_stack_retire also checks that the CPU got back where it came from:
+// after a return, the next instruction in the caller must be at the return
+// address (unknown for hardware interrupts) with SP as it was before the call.
+// A return must match the kind of the frame on top, RET a call and RETI an
+// interrupt. The first failed check of an instruction is returned, with the
+// expected value in CallStack::expected, and all are counted.
+
+const uint32_t CALL_STACK_UNRESOLVED = 0xFFFFFFFF;
+
+enum
+{
+    CALL_FRAME_ROOT,
+    CALL_FRAME_CALL,
+    CALL_FRAME_INTERRUPT
+};
+
+enum
+{
+    CALL_STACK_OK,
+    CALL_STACK_RETURN_ADDRESS,  // Returned to an address other than the return address.
+    CALL_STACK_RETURN_SP,       // Returned with SP other than before the call.
+    CALL_STACK_UNMATCHED_RETURN, // RET without a call or RETI without an interrupt on top.
+    CALL_STACK_DEAD_FRAME,      // A frame was dropped without returning.
+    CALL_STACK_NUM_RESULTS
+};
+
+enum
+{
+    CALL_RESUME_NONE,
+    CALL_RESUME_SP,
+    CALL_RESUME_ADDRESS_AND_SP
+};
+
+struct CallFrame
+{
+    uint8_t kind;
+    uint32_t entry;          // Physical address of the first instruction.
+    uint32_t call_site;      // Physical address of the call, CALL_STACK_UNRESOLVED for interrupts.
+    uint16_t return_address; // Logical address, for calls and CINT.
+    uint16_t sp;             // SP before the call or interrupt.
+    uint64_t entry_cycles;   // CallStack::cycles when the frame was pushed.
+    void* data;              // Owned by the CallStackHooks.
+
+    // Checked at the next instruction in this frame after a callee returns.
+    uint8_t resume_check;
+    uint16_t resume_address;
+    uint16_t resume_sp;
+};
+
+struct CallStackHooks
+{
+    // Called once the entry address of a frame is known.
+    void (*enter)(CallFrame* frame, void* user_data);
+    // Called for every frame popped, including dead frames, with the frame
+    // below it.
+    void (*leave)(const CallFrame* frame, CallFrame* caller, uint64_t cycles, void* user_data);
+    void* user_data;
+};
+
+struct CallStack
+{
+    std::vector<CallFrame> frames;
+    uint64_t cycles;
+    const uint8_t* cycles_table; // instruction_cycles, to tell taken calls.
+    CallStackHooks hooks;
+
+    size_t max_depth;
+    uint64_t num_mismatches[CALL_STACK_NUM_RESULTS];
+    uint32_t expected; // Of the last failed check.
+};
+
+inline bool call_stack_is_call(uint16_t extended_opcode)
+{
+    return (extended_opcode >= 0xE0 && extended_opcode <= 0xE3) ||
+           (extended_opcode >= 0xE8 && extended_opcode <= 0xEB) ||
+           extended_opcode == 0xF0 || extended_opcode == 0xF2 || extended_opcode == 0xFB ||
+           (extended_opcode >= 0x1F0 && extended_opcode <= 0x1FF);
+}
+
+namespace
+{
+    const uint16_t CALL_STACK_CINT    = 0xFC;
+    const uint16_t CALL_STACK_RET     = 0xF8;
+    const uint16_t CALL_STACK_RETI    = 0xF9;
+    const uint16_t CALL_STACK_RETSKIP = 0xFA;
+
+    void call_stack_init(CallStack* stack, const uint8_t* cycles_table, CallStackHooks hooks = {})
+    {
+        stack->frames.clear();
+        stack->frames.reserve(256);
+        stack->cycles       = 0;
+        stack->cycles_table = cycles_table;
+        stack->hooks        = hooks;
+        stack->max_depth    = 0;
+        stack->expected     = 0;
+        memset(stack->num_mismatches, 0, sizeof(stack->num_mismatches));
+
+        CallFrame root = {CALL_FRAME_ROOT, CALL_STACK_UNRESOLVED, CALL_STACK_UNRESOLVED, 0, 0xFFFF, 0, nullptr, CALL_RESUME_NONE, 0, 0};
+        stack->frames.push_back(root);
+    }
+
+    inline int call_stack_mismatch(CallStack* stack, int result, uint32_t expected)
+    {
+        ++stack->num_mismatches[result];
+        stack->expected = expected;
+        return result;
+    }
+
+    void call_stack_pop(CallStack* stack)
+    {
+        CallFrame frame = stack->frames.back();
+        stack->frames.pop_back();
+        if(stack->hooks.leave)
+            stack->hooks.leave(&frame, &stack->frames.back(), stack->cycles - frame.entry_cycles, stack->hooks.user_data);
+    }
+
+    int call_stack_push(CallStack* stack, uint8_t kind, uint32_t call_site, uint16_t return_address, uint16_t sp)
+    {
+        int result = CALL_STACK_OK;
+        while(stack->frames.size() > 1 && stack->frames.back().sp <= sp)
+        {
+            if(result == CALL_STACK_OK)
+                result = call_stack_mismatch(stack, CALL_STACK_DEAD_FRAME, stack->frames.back().entry);
+            else
+                ++stack->num_mismatches[CALL_STACK_DEAD_FRAME];
+            call_stack_pop(stack);
+        }
+
+        CallFrame frame = {kind, CALL_STACK_UNRESOLVED, call_site, return_address, sp, stack->cycles, nullptr, CALL_RESUME_NONE, 0, 0};
+        stack->frames.push_back(frame);
+        stack->max_depth = std::max(stack->max_depth, stack->frames.size() - 1);
+        return result;
+    }
+
+    // Pops the innermost frame of the given kind and the frames above it, or
+    // just the frame on top if there is none. skip is the number of bytes
+    // the return skips past the return address.
+    int call_stack_return(CallStack* stack, uint8_t kind, uint16_t skip = 0)
+    {
+        size_t top = stack->frames.size() - 1;
+        if(top == 0)
+            return call_stack_mismatch(stack, CALL_STACK_UNMATCHED_RETURN, kind);
+
+        size_t i = top;
+        while(i > 0 && stack->frames[i].kind != kind) --i;
+        if(i == 0) i = top;
+
+        while(stack->frames.size() - 1 > i)
+            call_stack_pop(stack);
+        CallFrame frame = stack->frames.back();
+        call_stack_pop(stack);
+
+        // A hardware interrupt does not know its return address, and does not
+        // override the check of a return it interrupted.
+        CallFrame& caller = stack->frames.back();
+        if(frame.call_site != CALL_STACK_UNRESOLVED)
+        {
+            caller.resume_check   = CALL_RESUME_ADDRESS_AND_SP;
+            caller.resume_address = frame.return_address + skip;
+            caller.resume_sp      = frame.sp;
+        }
+        else if(caller.resume_check == CALL_RESUME_NONE)
+        {
+            caller.resume_check = CALL_RESUME_SP;
+            caller.resume_sp    = frame.sp;
+        }
+
+        if(i != top || frame.kind != kind)
+            return call_stack_mismatch(stack, CALL_STACK_UNMATCHED_RETURN, kind);
+        return CALL_STACK_OK;
+    }
+
+    // The CPU has entered an interrupt, sp is SP before the entry and
+    // num_cycles the cycles the entry took.
+    int call_stack_interrupt(CallStack* stack, uint16_t sp, uint8_t num_cycles)
+    {
+        int result = call_stack_push(stack, CALL_FRAME_INTERRUPT, CALL_STACK_UNRESOLVED, 0, sp);
+        stack->cycles += num_cycles;
+        return result;
+    }
+
+    // Resolves the entry of the frame on top if this is its first instruction,
+    // and checks the return into it if there was one.
+    inline int call_stack_resolve(CallStack* stack, const TraceRecord& record)
+    {
+        CallFrame* top = &stack->frames.back();
+        if(top->entry == CALL_STACK_UNRESOLVED)
+        {
+            top->entry = trace_physical_address(record.pc, record.cb);
+            if(stack->hooks.enter)
+                stack->hooks.enter(top, stack->hooks.user_data);
+        }
+
+        if(top->resume_check == CALL_RESUME_NONE) return CALL_STACK_OK;
+        int check = top->resume_check;
+        top->resume_check = CALL_RESUME_NONE;
+
+        if(check == CALL_RESUME_ADDRESS_AND_SP && record.pc != top->resume_address)
+            return call_stack_mismatch(stack, CALL_STACK_RETURN_ADDRESS, top->resume_address);
+        if(record.sp != top->resume_sp)
+            return call_stack_mismatch(stack, CALL_STACK_RETURN_SP, top->resume_sp);
+        return CALL_STACK_OK;
+    }
+
+    // record holds the registers at the start of the retired instruction.
+    // Returns the first failed check, CALL_STACK_OK if there was none.
+    int call_stack_retire(CallStack* stack, const TraceRecord& record)
+    {
+        int result = call_stack_resolve(stack, record);
+        stack->cycles += record.num_cycles;
+
+        int call_result = CALL_STACK_OK;
+        uint16_t op = record.extended_opcode;
+        uint16_t next_pc = record.pc + instruction_table[op].num_bytes;
+        if(call_stack_is_call(op))
+        {
+            uint8_t branch_cycles = stack->cycles_table[2*op+1];
+            if(branch_cycles == 0 || record.num_cycles != branch_cycles)
+                call_result = call_stack_push(stack, CALL_FRAME_CALL, trace_physical_address(record.pc, record.cb), next_pc, record.sp);
+        }
+        else if(op == CALL_STACK_CINT)
+            call_result = call_stack_push(stack, CALL_FRAME_INTERRUPT, trace_physical_address(record.pc, record.cb), next_pc, record.sp);
+        else if(op == CALL_STACK_RET)
+            call_result = call_stack_return(stack, CALL_FRAME_CALL);
+        else if(op == CALL_STACK_RETSKIP)
+            call_result = call_stack_return(stack, CALL_FRAME_CALL, 2);
+        else if(op == CALL_STACK_RETI)
+            call_result = call_stack_return(stack, CALL_FRAME_INTERRUPT);
+
+        return (result != CALL_STACK_OK)? result: call_result;
+    }
+
+    const char* const call_stack_result_names[CALL_STACK_NUM_RESULTS] = {
+        "ok", "return address", "return SP", "unmatched return", "dead frame"
+    };
+
+    void call_stack_print_summary(const CallStack* stack)
+    {
+        uint64_t total = 0;
+        for(int i = 1; i < CALL_STACK_NUM_RESULTS; ++i)
+            total += stack->num_mismatches[i];
+        printf("%llu call stack mismatches", (unsigned long long)total);
+        const char* separator = ": ";
+        for(int i = 1; i < CALL_STACK_NUM_RESULTS; ++i)
+        {
+            if(stack->num_mismatches[i] == 0) continue;
+            printf("%s%llu %s", separator, (unsigned long long)stack->num_mismatches[i], call_stack_result_names[i]);
+            separator = ", ";
+        }
+        printf(", maximum depth %zu.\n", stack->max_depth);
+    }
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "bus_access.h"
+
+// Address coverage of the bios, RAM (0x1000-0x1FFF) and cartridge, separately
+// for reads and writes. Every byte has a bit in a packed bitset; in counter
+// mode it also has a counter of the number of accesses, saturating at 255.
+//
+// Coverage files can be merged across runs with tools/coverage_merge. A file
+// starts with a CoverageHeader, followed by the bitset and, in counter mode,
+// the counters of each region below and access type of bus_access.h, in
+// enum order. Cartridge offsets 0x000000-0x0020FF are never touched, the bios,
+// RAM and hardware registers are mapped there.
+
+#define COVERAGE_MAGIC   0x56434D50 // 'PMCV'
+#define COVERAGE_VERSION 1
+
+enum
+{
+    COVERAGE_BITSET,
+    COVERAGE_COUNTERS
+};
+
+enum
+{
+    COVERAGE_BIOS,
+    COVERAGE_RAM,
+    COVERAGE_CARTRIDGE,
+    COVERAGE_NUM_REGIONS
+};
+
+const char* const coverage_region_names[COVERAGE_NUM_REGIONS] = {"bios", "ram", "cartridge"};
+
+struct CoverageHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t mode;
+    uint32_t sizes[COVERAGE_NUM_REGIONS];
+    uint64_t cartridge_hash;
+};
+
+struct CoverageMap
+{
+    uint32_t size;
+    uint64_t* bits;
+    uint8_t* counters;
+};
+
+// Counts the set bits of a bitset.
+inline uint64_t coverage_popcount(const uint64_t* words, size_t num_words)
+{
+    uint64_t count = 0;
+    for(size_t i = 0; i < num_words; ++i)
+        count += __builtin_popcountll(words[i]);
+    return count;
+}
+
+inline size_t coverage_num_words(uint32_t size)
+{
+    return (size + 63) / 64;
+}
+
+// FNV-1a, identifies the cartridge a coverage file was recorded with.
+inline uint64_t coverage_hash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+namespace
+{
+    struct Coverage
+    {
+        uint32_t mode;
+        uint64_t cartridge_hash;
+        CoverageMap maps[COVERAGE_NUM_REGIONS][BUS_ACCESS_NUM_TYPES];
+    };
+
+    Coverage* coverage_create(uint32_t mode, const uint32_t sizes[COVERAGE_NUM_REGIONS], uint64_t cartridge_hash)
+    {
+        Coverage* coverage = new Coverage;
+        coverage->mode           = mode;
+        coverage->cartridge_hash = cartridge_hash;
+
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                CoverageMap& map = coverage->maps[region][access];
+                map.size     = sizes[region];
+                map.bits     = (uint64_t*) calloc(coverage_num_words(map.size), sizeof(uint64_t));
+                map.counters = (mode == COVERAGE_COUNTERS)? (uint8_t*) calloc(map.size, 1): nullptr;
+            }
+        }
+        return coverage;
+    }
+
+    Coverage* coverage_init(uint32_t mode, size_t bios_size, const uint8_t* cartridge, size_t cartridge_size)
+    {
+        uint32_t sizes[COVERAGE_NUM_REGIONS] = {(uint32_t)bios_size, 0x1000, (uint32_t)cartridge_size};
+        return coverage_create(mode, sizes, coverage_hash(cartridge, cartridge_size));
+    }
+
+    void coverage_free(Coverage* coverage)
+    {
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                free(coverage->maps[region][access].bits);
+                free(coverage->maps[region][access].counters);
+            }
+        }
+        delete coverage;
+    }
+
+    inline void coverage_mark(CoverageMap* map, uint32_t offset)
+    {
+        map->bits[offset >> 6] |= 1ull << (offset & 63);
+        if(map->counters && map->counters[offset] != 0xFF)
+            ++map->counters[offset];
+    }
+
+    // Records the bus access of the current simulation step.
+    inline void coverage_update(Coverage* coverage, const BusAccess& bus_access)
+    {
+        if(!bus_access.is_new) return;
+        int access = bus_access.type;
+
+        // Offsets as the harnesses serve them: the bios is mirrored, the
+        // cartridge is not, reads past its end return zeros and are not
+        // counted.
+        CoverageMap* maps;
+        uint32_t offset;
+        switch(bus_access.region)
+        {
+            case BUS_ACCESS_BIOS:
+                maps   = coverage->maps[COVERAGE_BIOS];
+                offset = bus_access.address & (maps[access].size - 1);
+                break;
+            case BUS_ACCESS_RAM:
+                maps   = coverage->maps[COVERAGE_RAM];
+                offset = bus_access.address & 0xFFF;
+                break;
+            case BUS_ACCESS_CARTRIDGE:
+                maps   = coverage->maps[COVERAGE_CARTRIDGE];
+                offset = bus_access.address & 0x1FFFFF;
+                break;
+            default:
+                return;
+        }
+
+        if(offset < maps[access].size)
+            coverage_mark(&maps[access], offset);
+    }
+
+    void coverage_print_summary(const Coverage* coverage)
+    {
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                const CoverageMap& map = coverage->maps[region][access];
+                uint64_t num_covered = coverage_popcount(map.bits, coverage_num_words(map.size));
+                if(access == BUS_ACCESS_WRITE && num_covered == 0 && region != COVERAGE_RAM) continue;
+
+                printf("%llu bytes out of total %u %s %s (%.2f%%).\n",
+                    (unsigned long long)num_covered, map.size,
+                    (access == BUS_ACCESS_READ)? "read from": "written to", coverage_region_names[region],
+                    map.size? 100.0 * num_covered / map.size: 0.0
+                );
+            }
+        }
+    }
+
+    bool coverage_save(const Coverage* coverage, const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening coverage file %s.\n", filepath);
+            return false;
+        }
+
+        CoverageHeader header = {COVERAGE_MAGIC, COVERAGE_VERSION, coverage->mode, {}, coverage->cartridge_hash};
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+            header.sizes[region] = coverage->maps[region][0].size;
+        fwrite(&header, sizeof(header), 1, fp);
+
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                const CoverageMap& map = coverage->maps[region][access];
+                fwrite(map.bits, sizeof(uint64_t), coverage_num_words(map.size), fp);
+                if(map.counters)
+                    fwrite(map.counters, 1, map.size, fp);
+            }
+        }
+
+        fclose(fp);
+        return true;
+    }
+
+    Coverage* coverage_load(const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "rb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening %s.\n", filepath);
+            return nullptr;
+        }
+
+        CoverageHeader header;
+        if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != COVERAGE_MAGIC || header.version != COVERAGE_VERSION)
+        {
+            fprintf(stderr, "%s is not a coverage file.\n", filepath);
+            fclose(fp);
+            return nullptr;
+        }
+
+        Coverage* coverage = coverage_create(header.mode, header.sizes, header.cartridge_hash);
+        bool ok = true;
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                CoverageMap& map = coverage->maps[region][access];
+                size_t num_words = coverage_num_words(map.size);
+                ok = ok && fread(map.bits, sizeof(uint64_t), num_words, fp) == num_words;
+                if(map.counters)
+                    ok = ok && fread(map.counters, 1, map.size, fp) == map.size;
+            }
+        }
+        fclose(fp);
+
+        if(!ok)
+        {
+            fprintf(stderr, "Error: Truncated coverage file %s.\n", filepath);
+            coverage_free(coverage);
+            return nullptr;
+        }
+        return coverage;
+    }
+
+    // Adds the coverage of other to coverage. Both must have been recorded
+    // with the same bios and cartridge sizes. The counters are dropped if
+    // other only has a bitset.
+    bool coverage_merge(Coverage* coverage, const Coverage* other)
+    {
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+            if(coverage->maps[region][0].size != other->maps[region][0].size)
+                return false;
+
+        if(other->mode == COVERAGE_BITSET && coverage->mode == COVERAGE_COUNTERS)
+        {
+            coverage->mode = COVERAGE_BITSET;
+            for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+            {
+                for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+                {
+                    free(coverage->maps[region][access].counters);
+                    coverage->maps[region][access].counters = nullptr;
+                }
+            }
+        }
+
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                CoverageMap& map = coverage->maps[region][access];
+                const CoverageMap& other_map = other->maps[region][access];
+                for(size_t i = 0; i < coverage_num_words(map.size); ++i)
+                    map.bits[i] |= other_map.bits[i];
+
+                if(map.counters)
+                {
+                    for(uint32_t i = 0; i < map.size; ++i)
+                    {
+                        unsigned sum = map.counters[i] + other_map.counters[i];
+                        map.counters[i] = (sum > 0xFF)? 0xFF: sum;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "coverage.h"
+
+// Merges coverage files written by the simulators and prints the summary of
+// the merged coverage. Reads are combined bitwise, counters are added.
+//
+// Usage: coverage_merge [-o <output>] <coverage>...
+
+int main(int argc, char** argv)
+{
+    const char* output_filepath = nullptr;
+    Coverage* coverage = nullptr;
+    int num_inputs = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            output_filepath = argv[++i];
+            continue;
+        }
+
+        Coverage* input = coverage_load(argv[i]);
+        if(!input) return 1;
+        ++num_inputs;
+
+        if(!coverage)
+        {
+            coverage = input;
+            continue;
+        }
+
+        if(input->cartridge_hash != coverage->cartridge_hash)
+            fprintf(stderr, "Warning: %s was recorded with a different cartridge.\n", argv[i]);
+        if(!coverage_merge(coverage, input))
+        {
+            fprintf(stderr, "Error: %s has different bios or cartridge sizes.\n", argv[i]);
+            return 1;
+        }
+        coverage_free(input);
+    }
+
+    if(!coverage)
+    {
+        fprintf(stderr, "Usage: %s [-o <output>] <coverage>...\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d coverage files merged.\n", num_inputs);
+    coverage_print_summary(coverage);
+
+    bool ok = !output_filepath || coverage_save(coverage, output_filepath);
+    coverage_free(coverage);
+    return ok? 0: 1;
+}
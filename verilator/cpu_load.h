@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// Guest CPU load: the share of the cycles of each frame (ending at
+// frame_complete) in which the CPU executed, rather than being halted by HALT
+// (STATE_HALT of s1c88.sv) or stalled while the PRC owns the bus. A game that
+// never halts gains nothing from skipping idle time.
+//
+// The load of the last complete frame is cpu_load_percent(&load->last_frame).
+// The summary classifies a run by its mean load and the share of frames in
+// which the CPU never halted.
+
+const uint8_t CPU_LOAD_STATE_HALT = 4;
+const int CPU_LOAD_NUM_BUCKETS = 10;
+
+struct CpuLoadFrame
+{
+    uint64_t cycles;
+    uint64_t halted_cycles;
+    uint64_t stalled_cycles;
+};
+
+struct CpuLoad
+{
+    CpuLoadFrame frame;
+    CpuLoadFrame last_frame;
+    CpuLoadFrame total;
+
+    uint32_t num_frames;
+    uint32_t num_busy_frames; // Frames without a halted cycle.
+    uint32_t histogram[CPU_LOAD_NUM_BUCKETS]; // Frames by load, in steps of 10%.
+};
+
+inline double cpu_load_percent(const CpuLoadFrame* frame)
+{
+    if(frame->cycles == 0) return 0.0;
+    return 100.0 * (frame->cycles - frame->halted_cycles - frame->stalled_cycles) / frame->cycles;
+}
+
+// Call every clock cycle with the state of the CPU and bus_ack. A halted
+// cycle with the bus owned by the PRC counts as halted only, so the two
+// shares never add up to more than the frame.
+inline void cpu_load_update(CpuLoad* load, uint8_t cpu_state, bool bus_ack)
+{
+    bool halted = cpu_state == CPU_LOAD_STATE_HALT;
+    ++load->frame.cycles;
+    load->frame.halted_cycles  += halted;
+    load->frame.stalled_cycles += bus_ack && !halted;
+}
+
+namespace
+{
+    void cpu_load_init(CpuLoad* load)
+    {
+        memset(load, 0, sizeof(CpuLoad));
+    }
+
+    // Call at frame_complete.
+    void cpu_load_end_frame(CpuLoad* load)
+    {
+        const CpuLoadFrame& frame = load->frame;
+        int bucket = (int)(cpu_load_percent(&frame) / 10.0);
+        bucket = (bucket < 0)? 0: (bucket >= CPU_LOAD_NUM_BUCKETS)? CPU_LOAD_NUM_BUCKETS - 1: bucket;
+        ++load->histogram[bucket];
+        load->num_busy_frames += (frame.halted_cycles == 0);
+        ++load->num_frames;
+
+        load->total.cycles         += frame.cycles;
+        load->total.halted_cycles  += frame.halted_cycles;
+        load->total.stalled_cycles += frame.stalled_cycles;
+        load->last_frame = frame;
+        memset(&load->frame, 0, sizeof(CpuLoadFrame));
+    }
+
+    void cpu_load_print_summary(const CpuLoad* load)
+    {
+        if(load->num_frames == 0) return;
+        const CpuLoadFrame& total = load->total;
+        printf("CPU load %.2f%% over %u frames (halted %.2f%%, stalled %.2f%%), never halted in %.2f%% of the frames.\n",
+            cpu_load_percent(&total), load->num_frames,
+            100.0 * total.halted_cycles / total.cycles, 100.0 * total.stalled_cycles / total.cycles,
+            100.0 * load->num_busy_frames / load->num_frames
+        );
+        printf("Frames by CPU load:");
+        for(int i = 0; i < CPU_LOAD_NUM_BUCKETS; ++i)
+            printf(" %d%%:%u", 10 * i, load->histogram[i]);
+        printf("\n");
+    }
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Blends the last frames of the LCD into a 96x64 grayscale image, as the LCD
+// shows flickering pixels, writing into a buffer owned by the caller. Each
+// frame has a weight, the newest one first; a pixel is the mean of the level
+// of its state in each frame, weighted and rounded down:
+//
+//     (level_off * weight_off + level_on * weight_on) / total_weight
+//
+// weight_on being the sum of the weights of the frames the pixel is on in.
+// With the default of 4 frames of weight 1 this is the plain 4-frame average.
+//
+// A frame is 8 pages of 96 bytes, bit i of a byte being row i of the page.
+// Each byte is expanded to the 8 rows with a lookup table, and the weights are
+// accumulated for 16 pixels at a time with SSE2, in sums laid out in page and
+// column order. As the levels only depend on the accumulated weight, the
+// image is then written through a table of the level of each weight sum.
+//
+// A FrameBlender keeps the history of frames and blends them for display.
+// With fixed weights it blends them as above on every draw. In adaptive mode
+// the frames have equal weights and the sums are kept as running sums, adding
+// the newest frame and subtracting the one leaving the window as frames are
+// pushed, so drawing does not depend on the number of frames blended, K.
+//
+// K adapts to the flicker of grayscale games. With the PRC rendering, the LCD
+// only changes every rate divider frames (PRC_RATE), so a flicker pattern of
+// P rendered frames spans P times that many frames; without it the divider is
+// 1. K is the shortest such period, for P of 1 to 4, over which the recent
+// frames repeat, compared by hash. The history covers P of 4 at the largest
+// divider, 12. While the frames do not repeat, e.g. while the picture moves,
+// K stays the same for up to K frames and then falls back to the divider, so
+// a pattern that stopped does not keep blurring the picture.
+
+const int FRAME_COMPOSER_WIDTH      = 96;
+const int FRAME_COMPOSER_HEIGHT     = 64;
+// The adaptive window of a FrameBlender, FRAME_BLENDER_MAX_DIVIDER *
+// FRAME_BLENDER_MAX_PATTERN.
+const int FRAME_COMPOSER_MAX_FRAMES = 48;
+// The weight sums of a pixel are bytes.
+const int FRAME_COMPOSER_MAX_TOTAL_WEIGHT = 255;
+
+struct FrameComposer
+{
+    int num_frames;
+    uint8_t weights[FRAME_COMPOSER_MAX_FRAMES]; // Newest frame first.
+    uint32_t total_weight;
+
+    // Byte i of the entry of a byte is 0xFF if its bit i is set.
+    uint64_t expand[256];
+    // Weight of the frames each pixel is on in, 8 rows of a page per column.
+    alignas(16) uint8_t sums[FRAME_COMPOSER_WIDTH * FRAME_COMPOSER_HEIGHT];
+    uint8_t levels[FRAME_COMPOSER_MAX_TOTAL_WEIGHT + 1];
+};
+
+namespace
+{
+    // Sets the number of frames blended and their weights, newest first, all
+    // 1 if weights is null. Returns false if they are out of range.
+    bool frame_composer_configure(FrameComposer* composer, int num_frames, const uint8_t* weights)
+    {
+        if(num_frames < 1 || num_frames > FRAME_COMPOSER_MAX_FRAMES)
+        {
+            fprintf(stderr, "Error: Cannot blend %d frames, at most %d.\n", num_frames, FRAME_COMPOSER_MAX_FRAMES);
+            return false;
+        }
+
+        uint32_t total_weight = 0;
+        for(int i = 0; i < num_frames; ++i)
+            total_weight += weights? weights[i]: 1;
+        if(total_weight == 0 || total_weight > FRAME_COMPOSER_MAX_TOTAL_WEIGHT)
+        {
+            fprintf(stderr, "Error: Total frame weight %u out of range, 1-%d.\n", total_weight, FRAME_COMPOSER_MAX_TOTAL_WEIGHT);
+            return false;
+        }
+
+        composer->num_frames   = num_frames;
+        composer->total_weight = total_weight;
+        for(int i = 0; i < num_frames; ++i)
+            composer->weights[i] = weights? weights[i]: 1;
+        return true;
+    }
+
+    void frame_composer_init(FrameComposer* composer, int num_frames, const uint8_t* weights = nullptr)
+    {
+        memset(composer, 0, sizeof(FrameComposer));
+        for(int byte = 0; byte < 256; ++byte)
+            for(int i = 0; i < 8; ++i)
+                if((byte >> i) & 1) composer->expand[byte] |= 0xFFull << (8 * i);
+        if(!frame_composer_configure(composer, num_frames, weights))
+            frame_composer_configure(composer, 1, nullptr);
+    }
+
+    // Adds the weight to the sums of the pixels on in a frame of 8 pages of
+    // 96 bytes, each stride bytes after the one before.
+    void frame_composer_accumulate(FrameComposer* composer, const uint8_t* frame, int stride, uint8_t weight)
+    {
+        const uint64_t* expand = composer->expand;
+        for(int page = 0; page < FRAME_COMPOSER_HEIGHT / 8; ++page)
+        {
+            const uint8_t* data = frame + page * stride;
+            uint8_t* sums = composer->sums + page * FRAME_COMPOSER_WIDTH * 8;
+            int x = 0;
+#if defined(__SSE2__)
+            const __m128i weights = _mm_set1_epi8(weight);
+            for(; x + 2 <= FRAME_COMPOSER_WIDTH; x += 2)
+            {
+                __m128i on  = _mm_set_epi64x(expand[data[x + 1]], expand[data[x]]);
+                __m128i sum = _mm_load_si128((const __m128i*)(sums + 8 * x));
+                _mm_store_si128((__m128i*)(sums + 8 * x), _mm_add_epi8(sum, _mm_and_si128(on, weights)));
+            }
+#endif
+            // The sums never carry from one byte into the next.
+            const uint64_t weights8 = weight * 0x0101010101010101ull;
+            for(; x < FRAME_COMPOSER_WIDTH; ++x)
+            {
+                uint64_t sum;
+                memcpy(&sum, sums + 8 * x, 8);
+                sum += expand[data[x]] & weights8;
+                memcpy(sums + 8 * x, &sum, 8);
+            }
+        }
+    }
+
+    // Writes the image, rows from the bottom up as the GL texture expects,
+    // level_off and level_on being the levels of a pixel that is off and on.
+    void frame_composer_resolve(FrameComposer* composer, uint8_t level_off, uint8_t level_on, uint8_t* image)
+    {
+        uint32_t total_weight = composer->total_weight;
+        for(uint32_t weight_on = 0; weight_on <= total_weight; ++weight_on)
+            composer->levels[weight_on] = (level_off * (total_weight - weight_on) + level_on * weight_on) / total_weight;
+
+        const uint8_t* sums = composer->sums;
+        for(int page = 0; page < FRAME_COMPOSER_HEIGHT / 8; ++page)
+        {
+            for(int i = 0; i < 8; ++i)
+            {
+                uint8_t* row = image + FRAME_COMPOSER_WIDTH * (FRAME_COMPOSER_HEIGHT - 1 - 8 * page - i);
+                const uint8_t* page_sums = sums + page * FRAME_COMPOSER_WIDTH * 8 + i;
+                for(int x = 0; x < FRAME_COMPOSER_WIDTH; ++x)
+                    row[x] = composer->levels[page_sums[8 * x]];
+            }
+        }
+    }
+
+    // Blends frames, the newest first, see frame_composer_accumulate.
+    void frame_composer_draw(FrameComposer* composer, const uint8_t* const* frames, int stride, uint8_t level_off, uint8_t level_on, uint8_t* image)
+    {
+        memset(composer->sums, 0, sizeof(composer->sums));
+        for(int i = 0; i < composer->num_frames; ++i)
+            frame_composer_accumulate(composer, frames[i], stride, composer->weights[i]);
+        frame_composer_resolve(composer, level_off, level_on, image);
+    }
+
+    // Subtracts a frame added with a weight of 1 from the sums.
+    void frame_composer_subtract(FrameComposer* composer, const uint8_t* frame, int stride)
+    {
+        const uint64_t* expand = composer->expand;
+        for(int page = 0; page < FRAME_COMPOSER_HEIGHT / 8; ++page)
+        {
+            const uint8_t* data = frame + page * stride;
+            uint8_t* sums = composer->sums + page * FRAME_COMPOSER_WIDTH * 8;
+            int x = 0;
+#if defined(__SSE2__)
+            const __m128i ones = _mm_set1_epi8(1);
+            for(; x + 2 <= FRAME_COMPOSER_WIDTH; x += 2)
+            {
+                __m128i on  = _mm_set_epi64x(expand[data[x + 1]], expand[data[x]]);
+                __m128i sum = _mm_load_si128((const __m128i*)(sums + 8 * x));
+                _mm_store_si128((__m128i*)(sums + 8 * x), _mm_sub_epi8(sum, _mm_and_si128(on, ones)));
+            }
+#endif
+            for(; x < FRAME_COMPOSER_WIDTH; ++x)
+            {
+                uint64_t sum;
+                memcpy(&sum, sums + 8 * x, 8);
+                sum -= expand[data[x]] & 0x0101010101010101ull;
+                memcpy(sums + 8 * x, &sum, 8);
+            }
+        }
+    }
+}
+
+const int FRAME_BLENDER_FRAME_SIZE = FRAME_COMPOSER_WIDTH * FRAME_COMPOSER_HEIGHT / 8;
+const int FRAME_BLENDER_MAX_DIVIDER = 12; // Of PRC_RATE, see prc_rate_dividers.
+const int FRAME_BLENDER_MAX_PATTERN = 4;
+const int FRAME_BLENDER_NUM_FRAMES  = FRAME_BLENDER_MAX_DIVIDER * FRAME_BLENDER_MAX_PATTERN;
+// Twice the history, to find periods of up to all of it.
+const int FRAME_BLENDER_NUM_HASHES  = 2 * FRAME_BLENDER_NUM_FRAMES;
+
+static_assert(FRAME_BLENDER_NUM_FRAMES <= FRAME_COMPOSER_MAX_FRAMES, "The window must fit the composer");
+
+struct FrameBlender
+{
+    FrameComposer composer;
+    bool adaptive;
+
+    uint8_t frames[FRAME_BLENDER_NUM_FRAMES][FRAME_BLENDER_FRAME_SIZE];
+    uint64_t hashes[FRAME_BLENDER_NUM_HASHES];
+    uint64_t num_pushed;
+    uint32_t num_unmatched; // Frames pushed since a period was last found.
+};
+
+namespace
+{
+    // In adaptive mode K starts at num_frames and the weights are ignored.
+    void frame_blender_init(FrameBlender* blender, bool adaptive, int num_frames, const uint8_t* weights = nullptr)
+    {
+        memset(blender->frames, 0, sizeof(blender->frames));
+        memset(blender->hashes, 0, sizeof(blender->hashes));
+        blender->num_pushed    = 0;
+        blender->num_unmatched = 0;
+        blender->adaptive      = adaptive;
+        frame_composer_init(&blender->composer, num_frames, adaptive? nullptr: weights);
+    }
+
+    // The age of a frame is 0 for the newest one.
+    const uint8_t* frame_blender_frame(const FrameBlender* blender, int age)
+    {
+        return blender->frames[(blender->num_pushed - 1 - age) % FRAME_BLENDER_NUM_FRAMES];
+    }
+
+    // Recomputes the running sums of the newest num_frames frames.
+    void frame_blender_reset_window(FrameBlender* blender, int num_frames)
+    {
+        FrameComposer* composer = &blender->composer;
+        frame_composer_configure(composer, num_frames, nullptr);
+        memset(composer->sums, 0, sizeof(composer->sums));
+        for(int age = 0; age < num_frames; ++age)
+            frame_composer_accumulate(composer, frame_blender_frame(blender, age), FRAME_COMPOSER_WIDTH, 1);
+    }
+
+    // Returns the shortest period of the recent frames that is a multiple of
+    // rate_divider, or 0 if they do not repeat.
+    int frame_blender_find_period(const FrameBlender* blender, int rate_divider)
+    {
+        uint64_t num_hashes = std::min<uint64_t>(blender->num_pushed, FRAME_BLENDER_NUM_HASHES);
+        for(int pattern = 1; pattern <= FRAME_BLENDER_MAX_PATTERN; ++pattern)
+        {
+            uint64_t period = pattern * rate_divider;
+            if(period > FRAME_BLENDER_NUM_FRAMES || 2 * period > num_hashes) break;
+
+            bool repeats = true;
+            for(uint64_t age = 0; age < period && repeats; ++age)
+            {
+                uint64_t newer = (blender->num_pushed - 1 - age) % FRAME_BLENDER_NUM_HASHES;
+                uint64_t older = (blender->num_pushed - 1 - age - period) % FRAME_BLENDER_NUM_HASHES;
+                repeats = blender->hashes[newer] == blender->hashes[older];
+            }
+            if(repeats) return period;
+        }
+        return 0;
+    }
+
+    // Adds a frame at frame_complete, 8 pages of 96 bytes. rate_divider is
+    // the number of frames per frame the PRC renders, 1 if it does not.
+    void frame_blender_push(FrameBlender* blender, const uint8_t* frame, int rate_divider)
+    {
+        FrameComposer* composer = &blender->composer;
+        uint8_t* slot = blender->frames[blender->num_pushed % FRAME_BLENDER_NUM_FRAMES];
+        int num_frames = composer->num_frames;
+        // The frame leaving the window is overwritten if the window is the
+        // whole history.
+        if(blender->adaptive && blender->num_pushed >= (uint64_t)num_frames)
+            frame_composer_subtract(composer, frame_blender_frame(blender, num_frames - 1), FRAME_COMPOSER_WIDTH);
+
+        memcpy(slot, frame, FRAME_BLENDER_FRAME_SIZE);
+        uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a
+        for(int i = 0; i < FRAME_BLENDER_FRAME_SIZE; ++i)
+            hash = (hash ^ frame[i]) * 0x100000001B3ull;
+        blender->hashes[blender->num_pushed % FRAME_BLENDER_NUM_HASHES] = hash;
+        ++blender->num_pushed;
+        if(!blender->adaptive) return;
+
+        frame_composer_accumulate(composer, slot, FRAME_COMPOSER_WIDTH, 1);
+        rate_divider = std::min(std::max(rate_divider, 1), FRAME_BLENDER_MAX_DIVIDER);
+        int period = frame_blender_find_period(blender, rate_divider);
+        if(period)
+        {
+            blender->num_unmatched = 0;
+            if(period != num_frames)
+                frame_blender_reset_window(blender, period);
+        }
+        else if(++blender->num_unmatched >= (uint32_t)num_frames)
+        {
+            blender->num_unmatched = 0;
+            if(rate_divider != num_frames)
+                frame_blender_reset_window(blender, rate_divider);
+        }
+    }
+
+    void frame_blender_set_adaptive(FrameBlender* blender, bool adaptive, int num_frames)
+    {
+        blender->adaptive      = adaptive;
+        blender->num_unmatched = 0;
+        if(adaptive)
+            frame_blender_reset_window(blender, num_frames);
+        else
+            frame_composer_configure(&blender->composer, num_frames, nullptr);
+    }
+
+    // Writes the blend of the frames into image, see frame_composer_resolve.
+    void frame_blender_draw(FrameBlender* blender, uint8_t level_off, uint8_t level_on, uint8_t* image)
+    {
+        FrameComposer* composer = &blender->composer;
+        if(blender->adaptive)
+        {
+            frame_composer_resolve(composer, level_off, level_on, image);
+            return;
+        }
+
+        const uint8_t* frames[FRAME_COMPOSER_MAX_FRAMES];
+        for(int age = 0; age < composer->num_frames; ++age)
+            frames[age] = frame_blender_frame(blender, age);
+        frame_composer_draw(composer, frames, FRAME_COMPOSER_WIDTH, level_off, level_on, image);
+    }
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+
+// The implementation is included by the harness, do not include it twice.
+#ifndef INCLUDE_STB_IMAGE_WRITE_H
+#include "stb_image_write.h"
+#endif
+
+// Writes LCD frames on a pool of worker threads, so the simulation does not
+// wait on zlib and the disk. frame_dump_submit copies the 1bpp LCD content of
+// a frame into a bounded queue of preallocated slots; the workers convert and
+// write them as <directory>/frame_<index>.png, a 96x64 grayscale image, or as
+// <directory>/frame_<index>.raw, the 8 pages of 96 bytes of the LCD with bit i
+// of a byte being row i of its page. The index has at least 6 digits.
+//
+// When the queue is full the simulation either waits for a free slot, the
+// time being counted as blocked, or the frame is dropped and counted.
+
+enum
+{
+    FRAME_DUMP_PNG,
+    FRAME_DUMP_RAW
+};
+
+const int FRAME_DUMP_WIDTH     = 96;
+const int FRAME_DUMP_HEIGHT    = 64;
+const int FRAME_DUMP_DATA_SIZE = FRAME_DUMP_WIDTH * FRAME_DUMP_HEIGHT / 8;
+
+struct FrameDumpJob
+{
+    uint32_t frame;
+    uint8_t contrast;
+    uint8_t data[FRAME_DUMP_DATA_SIZE];
+};
+
+namespace
+{
+    struct FrameDumper
+    {
+        char directory[256];
+        int format;
+        bool drop_when_full;
+
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::vector<FrameDumpJob> jobs; // Ring of queue_size slots.
+        size_t head;                    // Next job to write.
+        size_t num_queued;
+        bool closing;
+        std::vector<std::thread> workers;
+
+        uint64_t num_submitted;
+        uint64_t num_written;
+        uint64_t num_dropped;
+        uint64_t num_errors;
+        size_t max_queued;
+        uint64_t blocked_ns;
+    };
+
+    bool frame_dump_write(const FrameDumper* dumper, const FrameDumpJob& job)
+    {
+        char path[300];
+        snprintf(path, sizeof(path), "%s/frame_%06u.%s", dumper->directory, job.frame, (dumper->format == FRAME_DUMP_PNG)? "png": "raw");
+
+        if(dumper->format == FRAME_DUMP_RAW)
+        {
+            FILE* fp = fopen(path, "wb");
+            if(!fp) return false;
+            bool ok = fwrite(job.data, 1, FRAME_DUMP_DATA_SIZE, fp) == (size_t)FRAME_DUMP_DATA_SIZE;
+            return (fclose(fp) == 0) && ok;
+        }
+
+        uint8_t contrast = (job.contrast > 0x20)? 0x20: job.contrast;
+        uint8_t image_data[FRAME_DUMP_WIDTH * FRAME_DUMP_HEIGHT];
+        for (int yC=0; yC<8; yC++)
+        {
+            for (int xC=0; xC<FRAME_DUMP_WIDTH; xC++)
+            {
+                uint8_t data = job.data[yC * FRAME_DUMP_WIDTH + xC];
+                for(int i = 0; i < 8; ++i)
+                    image_data[FRAME_DUMP_WIDTH * (8 * yC + i) + xC] = ((~data >> i) & 1)? 255.0: 255.0 * (1.0 - (float)contrast / 0x20);
+            }
+        }
+        return stbi_write_png(path, FRAME_DUMP_WIDTH, FRAME_DUMP_HEIGHT, 1, image_data, FRAME_DUMP_WIDTH) != 0;
+    }
+
+    void frame_dump_worker(FrameDumper* dumper)
+    {
+        std::unique_lock<std::mutex> lock(dumper->mutex);
+        for(;;)
+        {
+            dumper->not_empty.wait(lock, [dumper]{ return dumper->num_queued > 0 || dumper->closing; });
+            if(dumper->num_queued == 0) return;
+
+            // Copy the job out so the slot is free while writing.
+            FrameDumpJob job = dumper->jobs[dumper->head];
+            dumper->head = (dumper->head + 1) % dumper->jobs.size();
+            --dumper->num_queued;
+            dumper->not_full.notify_one();
+
+            lock.unlock();
+            bool ok = frame_dump_write(dumper, job);
+            lock.lock();
+
+            if(ok)
+                ++dumper->num_written;
+            else if(dumper->num_errors++ == 0)
+            {
+                lock.unlock();
+                LOG_ERROR("Error writing frame %u to %s.\n", job.frame, dumper->directory);
+                lock.lock();
+            }
+        }
+    }
+
+    // Starts num_threads workers writing to an existing directory.
+    FrameDumper* frame_dump_open(const char* directory, int format, int num_threads, size_t queue_size, bool drop_when_full)
+    {
+        FrameDumper* dumper = new FrameDumper();
+        snprintf(dumper->directory, sizeof(dumper->directory), "%s", directory);
+        dumper->format         = format;
+        dumper->drop_when_full = drop_when_full;
+        dumper->jobs.resize(queue_size? queue_size: 1);
+        for(int i = 0; i < (num_threads > 0? num_threads: 1); ++i)
+            dumper->workers.emplace_back(frame_dump_worker, dumper);
+        return dumper;
+    }
+
+    // Queues a frame, lcd_data being the LCD memory of lcd.sv, 8 pages of 132
+    // bytes. Returns false if the frame was dropped.
+    bool frame_dump_submit(FrameDumper* dumper, uint32_t frame, uint8_t contrast, const uint8_t* lcd_data)
+    {
+        std::unique_lock<std::mutex> lock(dumper->mutex);
+        ++dumper->num_submitted;
+        if(dumper->num_queued == dumper->jobs.size())
+        {
+            if(dumper->drop_when_full)
+            {
+                ++dumper->num_dropped;
+                return false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            dumper->not_full.wait(lock, [dumper]{ return dumper->num_queued < dumper->jobs.size(); });
+            dumper->blocked_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        FrameDumpJob& job = dumper->jobs[(dumper->head + dumper->num_queued) % dumper->jobs.size()];
+        job.frame    = frame;
+        job.contrast = contrast;
+        for(int page = 0; page < 8; ++page)
+            memcpy(job.data + page * FRAME_DUMP_WIDTH, lcd_data + page * 132, FRAME_DUMP_WIDTH);
+        ++dumper->num_queued;
+        dumper->max_queued = std::max(dumper->max_queued, dumper->num_queued);
+        dumper->not_empty.notify_one();
+        return true;
+    }
+
+    // Writes the queued frames, stops the workers and prints the counts.
+    void frame_dump_close(FrameDumper* dumper)
+    {
+        {
+            std::lock_guard<std::mutex> lock(dumper->mutex);
+            dumper->closing = true;
+        }
+        dumper->not_empty.notify_all();
+        for(std::thread& worker: dumper->workers)
+            worker.join();
+
+        printf("%llu frames written to %s, %llu dropped, %llu failed, queue peaked at %zu of %zu, blocked for %.3f s.\n",
+            (unsigned long long)dumper->num_written, dumper->directory, (unsigned long long)dumper->num_dropped,
+            (unsigned long long)dumper->num_errors, dumper->max_queued, dumper->jobs.size(), dumper->blocked_ns * 1e-9
+        );
+        delete dumper;
+    }
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.h"
+#include "call_stack.h"
+
+// Cycle profile of the guest code, written in the callgrind format for
+// KCachegrind or callgrind_annotate. The cycles of each retired instruction
+// are attributed to its address in the function on top of the shadow call
+// stack (call_stack.h), and the cycles spent in a call, including the callees
+// and interrupts taken during it, to the call site. Functions are identified
+// by their entry address and named after the labels of data/bios.asm in the
+// bios.
+
+struct GuestCallCost
+{
+    uint64_t num_calls;
+    uint64_t inclusive_cycles;
+};
+
+struct GuestFunction
+{
+    uint32_t entry;
+    std::unordered_map<uint32_t, uint64_t> cycles; // Self cycles by address.
+    std::map<std::pair<uint32_t, uint32_t>, GuestCallCost> calls; // By call site and callee entry.
+};
+
+namespace
+{
+    struct GuestProfile
+    {
+        CallStack stack;
+        std::unordered_map<uint32_t, GuestFunction*> functions;
+        GuestFunction* current;
+        std::map<uint32_t, std::string> bios_labels;
+    };
+
+    GuestFunction* guest_profile_function(GuestProfile* profile, uint32_t entry)
+    {
+        GuestFunction*& function = profile->functions[entry];
+        if(!function)
+        {
+            function = new GuestFunction;
+            function->entry = entry;
+        }
+        return function;
+    }
+
+    void guest_profile_enter(CallFrame* frame, void* user_data)
+    {
+        GuestProfile* profile = (GuestProfile*)user_data;
+        GuestFunction* function = guest_profile_function(profile, frame->entry);
+        frame->data = function;
+        profile->current = function;
+
+        // The interrupt entry sequence itself.
+        if(frame->kind == CALL_FRAME_INTERRUPT && frame->call_site == CALL_STACK_UNRESOLVED)
+            function->cycles[frame->entry] += profile->stack.cycles - frame->entry_cycles;
+    }
+
+    void guest_profile_leave(const CallFrame* frame, CallFrame* caller, uint64_t cycles, void* user_data)
+    {
+        GuestProfile* profile = (GuestProfile*)user_data;
+        profile->current = (GuestFunction*)caller->data;
+        if(frame->entry == CALL_STACK_UNRESOLVED || !profile->current) return;
+
+        // Interrupts are attributed to the interrupted function, at its entry.
+        uint32_t call_site = (frame->call_site != CALL_STACK_UNRESOLVED)? frame->call_site: caller->entry;
+        GuestCallCost& cost = profile->current->calls[{call_site, frame->entry}];
+        ++cost.num_calls;
+        cost.inclusive_cycles += cycles;
+    }
+
+    // Reads the labels of a disassembly such as data/bios.asm, where a label
+    // line is followed by the address of the instruction it labels:
+    //
+    //     reset_vector:
+    //     0x00009A: LD EP,#00h ; 009a
+    void guest_profile_load_labels(GuestProfile* profile, const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "r");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening %s, bios functions will not be named.\n", filepath);
+            return;
+        }
+
+        char line[256];
+        char label[256] = {};
+        while(fgets(line, sizeof(line), fp))
+        {
+            size_t length = strcspn(line, "\r\n");
+            line[length] = '\0';
+
+            unsigned address;
+            if(label[0] && sscanf(line, "0x%x:", &address) == 1)
+            {
+                profile->bios_labels[address] = label;
+                label[0] = '\0';
+            }
+            else if(length > 1 && line[length - 1] == ':' && strchr(line, ' ') == nullptr)
+            {
+                line[length - 1] = '\0';
+                strcpy(label, line);
+            }
+        }
+        fclose(fp);
+    }
+
+    GuestProfile* guest_profile_init(const uint8_t* cycles_table, const char* bios_labels_filepath)
+    {
+        GuestProfile* profile = new GuestProfile;
+        profile->current = nullptr;
+        call_stack_init(&profile->stack, cycles_table, {guest_profile_enter, guest_profile_leave, profile});
+        if(bios_labels_filepath)
+            guest_profile_load_labels(profile, bios_labels_filepath);
+        return profile;
+    }
+
+    void guest_profile_free(GuestProfile* profile)
+    {
+        for(auto& function: profile->functions)
+            delete function.second;
+        delete profile;
+    }
+
+    inline void guest_profile_interrupt(GuestProfile* profile, uint16_t sp, uint8_t num_cycles)
+    {
+        call_stack_interrupt(&profile->stack, sp, num_cycles);
+    }
+
+    inline void guest_profile_retire(GuestProfile* profile, const TraceRecord& record)
+    {
+        // Resolving the entry of a new frame updates current.
+        uint32_t address = trace_physical_address(record.pc, record.cb);
+        call_stack_resolve(&profile->stack, record);
+        profile->current->cycles[address] += record.num_cycles;
+        call_stack_retire(&profile->stack, record);
+    }
+
+    std::string guest_profile_name(const GuestProfile* profile, uint32_t entry)
+    {
+        char name[300];
+        if(entry < 0x1000 && !profile->bios_labels.empty())
+        {
+            auto label = profile->bios_labels.upper_bound(entry);
+            if(label != profile->bios_labels.begin())
+            {
+                --label;
+                if(label->first == entry)
+                    return label->second;
+                snprintf(name, sizeof(name), "%s+0x%X", label->second.c_str(), entry - label->first);
+                return name;
+            }
+        }
+        snprintf(name, sizeof(name), "func_0x%06X", entry);
+        return name;
+    }
+
+    const char* guest_profile_file(uint32_t address)
+    {
+        return (address < 0x1000)? "bios": "cartridge";
+    }
+
+    bool guest_profile_save_callgrind(const GuestProfile* profile, const char* filepath, const char* command)
+    {
+        FILE* fp = fopen(filepath, "w");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening profile file %s.\n", filepath);
+            return false;
+        }
+
+        fprintf(fp, "# callgrind format\n");
+        fprintf(fp, "version: 1\n");
+        fprintf(fp, "creator: minx_sim\n");
+        fprintf(fp, "cmd: %s\n", command);
+        fprintf(fp, "positions: instr\n");
+        fprintf(fp, "events: Cycles\n");
+        fprintf(fp, "summary: %llu\n\n", (unsigned long long)profile->stack.cycles);
+
+        // Sorted by entry for stable output.
+        std::map<uint32_t, const GuestFunction*> functions(profile->functions.begin(), profile->functions.end());
+        for(auto& entry: functions)
+        {
+            const GuestFunction* function = entry.second;
+            fprintf(fp, "fl=%s\n", guest_profile_file(function->entry));
+            fprintf(fp, "fn=%s\n", guest_profile_name(profile, function->entry).c_str());
+
+            std::map<uint32_t, uint64_t> cycles(function->cycles.begin(), function->cycles.end());
+            for(auto& cost: cycles)
+                fprintf(fp, "0x%X %llu\n", cost.first, (unsigned long long)cost.second);
+
+            for(auto& call: function->calls)
+            {
+                uint32_t callee = call.first.second;
+                fprintf(fp, "cfi=%s\n", guest_profile_file(callee));
+                fprintf(fp, "cfn=%s\n", guest_profile_name(profile, callee).c_str());
+                fprintf(fp, "calls=%llu 0x%X\n", (unsigned long long)call.second.num_calls, callee);
+                fprintf(fp, "0x%X %llu\n", call.first.first, (unsigned long long)call.second.inclusive_cycles);
+            }
+            fprintf(fp, "\n");
+        }
+
+        fclose(fp);
+        return true;
+    }
+}
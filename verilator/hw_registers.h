@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "bus_access.h"
+
+// Access statistics of the hardware registers (0x2000-0x20FF): the number of
+// reads and writes of each register and the last value read and written.
+//
+// Accesses to selected registers are also written to a text log, one per
+// line:
+//
+//     <timestamp>\t<pc>\t<R|W>\t<register>\t<value>
+//
+// The registers are selected with a list of names or addresses separated by
+// commas, e.g. "IRQ_ACT1,PRC_MODE,0x61" or "all", in the MINX_HW_LOG
+// environment variable or hw_registers_select(). The value of a read is the
+// byte the CPU latches, as answered by minx.sv.
+
+struct HwRegisterName
+{
+    uint8_t address;
+    const char* name;
+};
+
+const HwRegisterName hw_register_names[] = {
+    {0x00, "SYS_CTRL1"}, {0x01, "SYS_CTRL2"}, {0x02, "SYS_CTRL3"},
+    {0x08, "SEC_CTRL"}, {0x09, "SEC_CNT_LO"}, {0x0A, "SEC_CNT_MID"}, {0x0B, "SEC_CNT_HI"},
+    {0x10, "SYS_BATT"},
+    {0x18, "TMR1_SCALE"}, {0x19, "TMR1_OSC"}, {0x1A, "TMR2_SCALE"}, {0x1B, "TMR2_OSC"},
+    {0x1C, "TMR3_SCALE"}, {0x1D, "TMR3_OSC"},
+    {0x20, "IRQ_PRI1"}, {0x21, "IRQ_PRI2"}, {0x22, "IRQ_PRI3"},
+    {0x23, "IRQ_ENA1"}, {0x24, "IRQ_ENA2"}, {0x25, "IRQ_ENA3"}, {0x26, "IRQ_ENA4"},
+    {0x27, "IRQ_ACT1"}, {0x28, "IRQ_ACT2"}, {0x29, "IRQ_ACT3"}, {0x2A, "IRQ_ACT4"},
+    {0x30, "TMR1_CTRL_L"}, {0x31, "TMR1_CTRL_H"}, {0x32, "TMR1_PRE_L"}, {0x33, "TMR1_PRE_H"},
+    {0x34, "TMR1_PVT_L"}, {0x35, "TMR1_PVT_H"}, {0x36, "TMR1_CNT_L"}, {0x37, "TMR1_CNT_H"},
+    {0x38, "TMR2_CTRL_L"}, {0x39, "TMR2_CTRL_H"}, {0x3A, "TMR2_PRE_L"}, {0x3B, "TMR2_PRE_H"},
+    {0x3C, "TMR2_PVT_L"}, {0x3D, "TMR2_PVT_H"}, {0x3E, "TMR2_CNT_L"}, {0x3F, "TMR2_CNT_H"},
+    {0x40, "TMR256_CTRL"}, {0x41, "TMR256_CNT"},
+    {0x48, "TMR3_CTRL_L"}, {0x49, "TMR3_CTRL_H"}, {0x4A, "TMR3_PRE_L"}, {0x4B, "TMR3_PRE_H"},
+    {0x4C, "TMR3_PVT_L"}, {0x4D, "TMR3_PVT_H"}, {0x4E, "TMR3_CNT_L"}, {0x4F, "TMR3_CNT_H"},
+    {0x52, "KEY_PAD"}, {0x53, "CART_BUS"},
+    {0x60, "IO_DIR"}, {0x61, "IO_DATA"},
+    {0x70, "AUD_CTRL"}, {0x71, "AUD_VOL"},
+    {0x80, "PRC_MODE"}, {0x81, "PRC_RATE"},
+    {0x82, "PRC_MAP_LO"}, {0x83, "PRC_MAP_MID"}, {0x84, "PRC_MAP_HI"},
+    {0x85, "PRC_SCROLL_Y"}, {0x86, "PRC_SCROLL_X"},
+    {0x87, "PRC_SPR_LO"}, {0x88, "PRC_SPR_MID"}, {0x89, "PRC_SPR_HI"},
+    {0x8A, "PRC_CNT"},
+    {0xFE, "LCD_CTRL"}, {0xFF, "LCD_DATA"},
+};
+
+namespace
+{
+    struct HwRegisters
+    {
+        char names[256][16];
+        uint64_t counts[256][BUS_ACCESS_NUM_TYPES];
+        uint8_t last_values[256][BUS_ACCESS_NUM_TYPES];
+
+        bool logged[256];
+        FILE* log_fp;
+        uint64_t num_logged;
+    };
+
+    // Parses a list of register names or addresses separated by commas, or
+    // "all", and opens the log if any register is selected.
+    bool hw_registers_select(HwRegisters* registers, const char* selection, const char* log_filepath)
+    {
+        bool ok = true;
+        while(*selection)
+        {
+            const char* end = strchr(selection, ',');
+            if(!end) end = selection + strlen(selection);
+
+            char entry[32] = {};
+            strncpy(entry, selection, std::min<size_t>(end - selection, sizeof(entry) - 1));
+            selection = *end? end + 1: end;
+
+            bool found = false;
+            char* number_end;
+            unsigned long address = strtoul(entry, &number_end, 0);
+            if(entry[0] && *number_end == '\0')
+            {
+                found = (address & 0xFFF00) == 0x2000 || address < 0x100;
+                if(found) registers->logged[address & 0xFF] = true;
+            }
+            else
+            {
+                for(int i = 0; i < 256; ++i)
+                {
+                    if(strcmp(entry, "all") == 0 || strcmp(entry, registers->names[i]) == 0)
+                    {
+                        registers->logged[i] = true;
+                        found = true;
+                    }
+                }
+            }
+            if(!found)
+            {
+                fprintf(stderr, "Error: Unknown hardware register %s.\n", entry);
+                ok = false;
+            }
+        }
+
+        bool any_logged = std::find(registers->logged, registers->logged + 256, true) != registers->logged + 256;
+        if(any_logged && !registers->log_fp)
+        {
+            registers->log_fp = fopen(log_filepath, "w");
+            if(!registers->log_fp)
+            {
+                fprintf(stderr, "Error opening hardware register log %s.\n", log_filepath);
+                return false;
+            }
+        }
+        return ok;
+    }
+
+    // Applies MINX_HW_LOG, the log is written to log_filepath.
+    HwRegisters* hw_registers_init(const char* log_filepath)
+    {
+        HwRegisters* registers = (HwRegisters*) calloc(1, sizeof(HwRegisters));
+        for(int i = 0; i < 256; ++i)
+            snprintf(registers->names[i], sizeof(registers->names[i]), "0x%02X", i);
+        for(const HwRegisterName& name: hw_register_names)
+            strcpy(registers->names[name.address], name.name);
+
+        if(const char* selection = getenv("MINX_HW_LOG"))
+            hw_registers_select(registers, selection, log_filepath);
+        return registers;
+    }
+
+    void hw_registers_free(HwRegisters* registers)
+    {
+        if(registers->log_fp)
+            fclose(registers->log_fp);
+        free(registers);
+    }
+
+    // Records the bus access of the current simulation step, pc being the
+    // physical address of the accessing instruction.
+    inline void hw_registers_update(HwRegisters* registers, const BusAccess& bus_access, uint64_t timestamp, uint32_t pc)
+    {
+        if(!bus_access.is_new || bus_access.region != BUS_ACCESS_IO) return;
+        int access    = bus_access.type;
+        uint8_t value = bus_access.data;
+
+        uint8_t index = bus_access.address & 0xFF;
+        ++registers->counts[index][access];
+        registers->last_values[index][access] = value;
+
+        if(registers->logged[index] && registers->log_fp)
+        {
+            fprintf(registers->log_fp, "%llu\t0x%06X\t%c\t%s\t0x%02X\n",
+                (unsigned long long)timestamp, pc, (access == BUS_ACCESS_READ)? 'R': 'W', registers->names[index], value
+            );
+            ++registers->num_logged;
+        }
+    }
+
+    // Prints the accessed registers, most accessed first.
+    void hw_registers_print_summary(const HwRegisters* registers)
+    {
+        int order[256];
+        int num_accessed = 0;
+        for(int i = 0; i < 256; ++i)
+            if(registers->counts[i][BUS_ACCESS_READ] + registers->counts[i][BUS_ACCESS_WRITE] > 0)
+                order[num_accessed++] = i;
+        std::sort(order, order + num_accessed, [registers](int a, int b){
+            return registers->counts[a][BUS_ACCESS_READ] + registers->counts[a][BUS_ACCESS_WRITE] >
+                   registers->counts[b][BUS_ACCESS_READ] + registers->counts[b][BUS_ACCESS_WRITE];
+        });
+
+        printf("%d hardware registers accessed:\n", num_accessed);
+        printf("%-14s %-7s %12s %12s %10s %10s\n", "register", "address", "reads", "writes", "last read", "last write");
+        for(int n = 0; n < num_accessed; ++n)
+        {
+            int i = order[n];
+            const uint64_t* counts = registers->counts[i];
+            char last_read[8] = "-";
+            char last_write[8] = "-";
+            if(counts[BUS_ACCESS_READ])
+                snprintf(last_read, sizeof(last_read), "0x%02X", registers->last_values[i][BUS_ACCESS_READ]);
+            if(counts[BUS_ACCESS_WRITE])
+                snprintf(last_write, sizeof(last_write), "0x%02X", registers->last_values[i][BUS_ACCESS_WRITE]);
+
+            printf("%-14s 0x%04X  %12llu %12llu %10s %10s\n", registers->names[i], 0x2000 + i,
+                (unsigned long long)counts[BUS_ACCESS_READ], (unsigned long long)counts[BUS_ACCESS_WRITE], last_read, last_write
+            );
+        }
+        if(registers->log_fp)
+            printf("%llu hardware register accesses logged.\n", (unsigned long long)registers->num_logged);
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+// Input-to-display latency: presses keys (bits of keys_active) and measures
+// the number of frames and cycles until the LCD content, sampled at
+// frame_complete, differs from the content at the press. The keys are then
+// released, and once the LCD has not changed for settle_frames frames they
+// are pressed again after a random number of cycles of up to a frame, so that
+// the presses fall at random phases of the frame.
+//
+// Any change of the LCD counts, run it on a screen that only changes in
+// response to the keys, e.g. a menu. A press without a change within
+// timeout_frames frames is counted as a timeout.
+//
+// If a CSV file is open, a row is appended for every press:
+//
+//     press,press_cycles,phase_cycles,frames,cycles
+//
+// phase_cycles being the cycles from the last frame_complete to the press,
+// and frames and cycles empty for a timeout.
+
+const int INPUT_LATENCY_LCD_SIZE = 8 * 132;
+// Latencies of this many frames or more are counted in the last bucket.
+const int INPUT_LATENCY_MAX_FRAMES = 16;
+
+enum
+{
+    INPUT_LATENCY_SETTLING, // Keys released, waiting for the LCD to settle.
+    INPUT_LATENCY_WAITING,  // Waiting for the cycle of the next press.
+    INPUT_LATENCY_PRESSED,  // Keys pressed, waiting for the LCD to change.
+};
+
+struct InputLatency
+{
+    uint16_t keys;
+    uint32_t settle_frames;
+    uint32_t timeout_frames;
+    FILE* csv_fp;
+
+    int state;
+    uint32_t rng;
+    uint32_t frames;             // Frames since the press, or since the LCD last changed.
+    uint64_t frame_start_cycles; // Cycle of the last frame_complete.
+    uint64_t frame_cycles;       // Length of the last frame.
+    uint64_t press_cycles;       // Cycle of the next or last press.
+    uint64_t phase_cycles;       // Cycles from the last frame_complete to the press.
+    uint8_t lcd[INPUT_LATENCY_LCD_SIZE];
+    uint8_t press_lcd[INPUT_LATENCY_LCD_SIZE];
+
+    uint32_t num_presses;
+    uint32_t num_timeouts;
+    uint32_t frame_counts[INPUT_LATENCY_MAX_FRAMES + 1];
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+    uint64_t sum_cycles;
+};
+
+namespace
+{
+    void input_latency_init(InputLatency* latency, uint16_t keys, uint32_t settle_frames, uint32_t timeout_frames)
+    {
+        memset(latency, 0, sizeof(InputLatency));
+        latency->keys           = keys;
+        latency->settle_frames  = settle_frames;
+        latency->timeout_frames = timeout_frames;
+        latency->state          = INPUT_LATENCY_SETTLING;
+        latency->rng            = 0x12345678; // Fixed, for repeatable runs.
+    }
+
+    bool input_latency_open_csv(InputLatency* latency, const char* filepath)
+    {
+        if(latency->csv_fp) fclose(latency->csv_fp);
+        latency->csv_fp = fopen(filepath, "w");
+        if(!latency->csv_fp)
+        {
+            fprintf(stderr, "Error opening input latency file %s.\n", filepath);
+            return false;
+        }
+        fprintf(latency->csv_fp, "press,press_cycles,phase_cycles,frames,cycles\n");
+        return true;
+    }
+
+    void input_latency_close_csv(InputLatency* latency)
+    {
+        if(!latency->csv_fp) return;
+        fclose(latency->csv_fp);
+        latency->csv_fp = nullptr;
+    }
+
+    uint32_t input_latency_random(InputLatency* latency)
+    {
+        uint32_t x = latency->rng;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return latency->rng = x;
+    }
+
+    void input_latency_release(InputLatency* latency, uint16_t* keys_active, bool changed, uint64_t cycles)
+    {
+        *keys_active &= ~latency->keys;
+        if(changed)
+        {
+            uint64_t latency_cycles = cycles - latency->press_cycles;
+            ++latency->frame_counts[std::min<uint32_t>(latency->frames, INPUT_LATENCY_MAX_FRAMES)];
+            latency->min_cycles = (latency->num_presses == latency->num_timeouts)? latency_cycles: std::min(latency->min_cycles, latency_cycles);
+            latency->max_cycles = std::max(latency->max_cycles, latency_cycles);
+            latency->sum_cycles += latency_cycles;
+            if(latency->csv_fp)
+                fprintf(latency->csv_fp, "%u,%llu,%llu,%u,%llu\n", latency->num_presses, (unsigned long long)latency->press_cycles,
+                    (unsigned long long)latency->phase_cycles, latency->frames, (unsigned long long)latency_cycles);
+        }
+        else
+        {
+            ++latency->num_timeouts;
+            if(latency->csv_fp)
+                fprintf(latency->csv_fp, "%u,%llu,%llu,,\n", latency->num_presses, (unsigned long long)latency->press_cycles,
+                    (unsigned long long)latency->phase_cycles);
+        }
+        ++latency->num_presses;
+        latency->state  = INPUT_LATENCY_SETTLING;
+        latency->frames = 0;
+    }
+
+    // Call every clock cycle. frame_complete is set on the rising edge of
+    // frame_complete, lcd_data is the LCD memory of lcd.sv, the pressed keys
+    // are set in keys_active and cleared again on release.
+    void input_latency_update(InputLatency* latency, uint64_t cycles, bool frame_complete, const uint8_t* lcd_data, uint16_t* keys_active)
+    {
+        if(latency->state == INPUT_LATENCY_WAITING && cycles >= latency->press_cycles)
+        {
+            *keys_active |= latency->keys;
+            memcpy(latency->press_lcd, latency->lcd, INPUT_LATENCY_LCD_SIZE);
+            latency->phase_cycles = cycles - latency->frame_start_cycles;
+            latency->state  = INPUT_LATENCY_PRESSED;
+            latency->frames = 0;
+        }
+        if(!frame_complete) return;
+
+        latency->frame_cycles       = cycles - latency->frame_start_cycles;
+        latency->frame_start_cycles = cycles;
+        bool changed = memcmp(latency->lcd, lcd_data, INPUT_LATENCY_LCD_SIZE) != 0;
+        memcpy(latency->lcd, lcd_data, INPUT_LATENCY_LCD_SIZE);
+        ++latency->frames;
+
+        switch(latency->state)
+        {
+        case INPUT_LATENCY_SETTLING:
+            if(changed)
+                latency->frames = 0;
+            else if(latency->frames >= latency->settle_frames)
+            {
+                latency->press_cycles = cycles + input_latency_random(latency) % std::max<uint64_t>(latency->frame_cycles, 1);
+                latency->state        = INPUT_LATENCY_WAITING;
+            }
+            break;
+        case INPUT_LATENCY_PRESSED:
+            if(memcmp(latency->lcd, latency->press_lcd, INPUT_LATENCY_LCD_SIZE) != 0)
+                input_latency_release(latency, keys_active, true, cycles);
+            else if(latency->frames >= latency->timeout_frames)
+                input_latency_release(latency, keys_active, false, cycles);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void input_latency_print_summary(const InputLatency* latency)
+    {
+        if(latency->num_presses == 0) return;
+        uint32_t num_changes = latency->num_presses - latency->num_timeouts;
+        printf("Input latency of %u presses, %u without a change of the LCD within %u frames",
+            latency->num_presses, latency->num_timeouts, latency->timeout_frames);
+        if(num_changes == 0)
+        {
+            printf(".\n");
+            return;
+        }
+        printf(": %llu min, %.1f mean, %llu max cycles.\n", (unsigned long long)latency->min_cycles,
+            (double)latency->sum_cycles / num_changes, (unsigned long long)latency->max_cycles);
+        printf("Presses by frames to the change:");
+        for(int frames = 0; frames <= INPUT_LATENCY_MAX_FRAMES; ++frames)
+        {
+            if(latency->frame_counts[frames] == 0) continue;
+            printf(" %d%s:%u", frames, (frames == INPUT_LATENCY_MAX_FRAMES)? "+": "", latency->frame_counts[frames]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,788 @@
+#pragma once
+
+// Generated by scripts/make_instruction_table.py from docs/instructions.csv.
+// Operand placeholders: #nn/#nnnn unsigned, #ss/#ssss signed, little-endian.
+struct InstructionInfo
+{
+    const char* mnemonic;
+    uint8_t num_bytes;
+};
+
+const InstructionInfo instruction_table[768] = {
+    {"ADD A, A", 1},
+    {"ADD A, B", 1},
+    {"ADD A, #nn", 2},
+    {"ADD A, [HL]", 1},
+    {"ADD A, [N+#nn]", 2},
+    {"ADD A, [#nnnn]", 3},
+    {"ADD A, [X]", 1},
+    {"ADD A, [Y]", 1},
+    {"ADC A, A", 1},
+    {"ADC A, B", 1},
+    {"ADC A, #nn", 2},
+    {"ADC A, [HL]", 1},
+    {"ADC A, [N+#nn]", 2},
+    {"ADC A, [#nnnn]", 3},
+    {"ADC A, [X]", 1},
+    {"ADC A, [Y]", 1},
+    {"SUB A, A", 1},
+    {"SUB A, B", 1},
+    {"SUB A, #nn", 2},
+    {"SUB A, [HL]", 1},
+    {"SUB A, [N+#nn]", 2},
+    {"SUB A, [#nnnn]", 3},
+    {"SUB A, [X]", 1},
+    {"SUB A, [Y]", 1},
+    {"SBC A, A", 1},
+    {"SBC A, B", 1},
+    {"SBC A, #nn", 2},
+    {"SBC A, [HL]", 1},
+    {"SBC A, [N+#nn]", 2},
+    {"SBC A, [#nnnn]", 3},
+    {"SBC A, [X]", 1},
+    {"SBC A, [Y]", 1},
+    {"AND A, A", 1},
+    {"AND A, B", 1},
+    {"AND A, #nn", 2},
+    {"AND A, [HL]", 1},
+    {"AND A, [N+#nn]", 2},
+    {"AND A, [#nnnn]", 3},
+    {"AND A, [X]", 1},
+    {"AND A, [Y]", 1},
+    {"OR A, A", 1},
+    {"OR A, B", 1},
+    {"OR A, #nn", 2},
+    {"OR A, [HL]", 1},
+    {"OR A, [N+#nn]", 2},
+    {"OR A, [#nnnn]", 3},
+    {"OR A, [X]", 1},
+    {"OR A, [Y]", 1},
+    {"CMP A, A", 1},
+    {"CMP A, B", 1},
+    {"CMP A, #nn", 2},
+    {"CMP A, [HL]", 1},
+    {"CMP A, [N+#nn]", 2},
+    {"CMP A, [#nnnn]", 3},
+    {"CMP A, [X]", 1},
+    {"CMP A, [Y]", 1},
+    {"XOR A, A", 1},
+    {"XOR A, B", 1},
+    {"XOR A, #nn", 2},
+    {"XOR A, [HL]", 1},
+    {"XOR A, [N+#nn]", 2},
+    {"XOR A, [#nnnn]", 3},
+    {"XOR A, [X]", 1},
+    {"XOR A, [Y]", 1},
+    {"MOV A, A", 1},
+    {"MOV A, B", 1},
+    {"MOV A, L", 1},
+    {"MOV A, H", 1},
+    {"MOV A, [N+#nn]", 2},
+    {"MOV A, [HL]", 1},
+    {"MOV A, [X]", 1},
+    {"MOV A, [Y]", 1},
+    {"MOV B, A", 1},
+    {"MOV B, B", 1},
+    {"MOV B, L", 1},
+    {"MOV B, H", 1},
+    {"MOV B, [N+#nn]", 2},
+    {"MOV B, [HL]", 1},
+    {"MOV B, [X]", 1},
+    {"MOV B, [Y]", 1},
+    {"MOV L, A", 1},
+    {"MOV L, B", 1},
+    {"MOV L, L", 1},
+    {"MOV L, H", 1},
+    {"MOV L, [N+#nn]", 2},
+    {"MOV L, [HL]", 1},
+    {"MOV L, [X]", 1},
+    {"MOV L, [Y]", 1},
+    {"MOV H, A", 1},
+    {"MOV H, B", 1},
+    {"MOV H, L", 1},
+    {"MOV H, H", 1},
+    {"MOV H, [N+#nn]", 2},
+    {"MOV H, [HL]", 1},
+    {"MOV H, [X]", 1},
+    {"MOV H, [Y]", 1},
+    {"MOV [X], A", 1},
+    {"MOV [X], B", 1},
+    {"MOV [X], L", 1},
+    {"MOV [X], H", 1},
+    {"MOV [X], [N+#nn]", 2},
+    {"MOV [X], [HL]", 1},
+    {"MOV [X], [X]", 1},
+    {"MOV [X], [Y]", 1},
+    {"MOV [HL], A", 1},
+    {"MOV [HL], B", 1},
+    {"MOV [HL], L", 1},
+    {"MOV [HL], H", 1},
+    {"MOV [HL], [N+#nn]", 2},
+    {"MOV [HL], [HL]", 1},
+    {"MOV [HL], [X]", 1},
+    {"MOV [HL], [Y]", 1},
+    {"MOV [Y], A", 1},
+    {"MOV [Y], B", 1},
+    {"MOV [Y], L", 1},
+    {"MOV [Y], H", 1},
+    {"MOV [Y], [N+#nn]", 2},
+    {"MOV [Y], [HL]", 1},
+    {"MOV [Y], [X]", 1},
+    {"MOV [Y], [Y]", 1},
+    {"MOV [N+#nn], A", 2},
+    {"MOV [N+#nn], B", 2},
+    {"MOV [N+#nn], L", 2},
+    {"MOV [N+#nn], H", 2},
+    {nullptr, 0},
+    {"MOV [N+#nn], [HL]", 2},
+    {"MOV [N+#nn], [X]", 2},
+    {"MOV [N+#nn], [Y]", 2},
+    {"INC A", 1},
+    {"INC B", 1},
+    {"INC L", 1},
+    {"INC H", 1},
+    {"INC N", 1},
+    {"INC [N+#nn]", 2},
+    {"INC [HL]", 1},
+    {"INC SP", 1},
+    {"DEC A", 1},
+    {"DEC B", 1},
+    {"DEC L", 1},
+    {"DEC H", 1},
+    {"DEC N", 1},
+    {"DEC [N+#nn]", 2},
+    {"DEC [HL]", 1},
+    {"DEC SP", 1},
+    {"INC BA", 1},
+    {"INC HL", 1},
+    {"INC X", 1},
+    {"INC Y", 1},
+    {"TST A, B", 1},
+    {"TST [HL], #nn", 2},
+    {"TST A, #nn", 2},
+    {"TST B, #nn", 2},
+    {"DEC BA", 1},
+    {"DEC HL", 1},
+    {"DEC X", 1},
+    {"DEC Y", 1},
+    {"AND F, #nn", 2},
+    {"OR F, #nn", 2},
+    {"XOR F, #nn", 2},
+    {"MOV F, #nn", 2},
+    {"PUSH BA", 1},
+    {"PUSH HL", 1},
+    {"PUSH X", 1},
+    {"PUSH Y", 1},
+    {"PUSH N", 1},
+    {"PUSH I", 1},
+    {"PUSHX", 1},
+    {"PUSH F", 1},
+    {"POP BA", 1},
+    {"POP HL", 1},
+    {"POP X", 1},
+    {"POP Y", 1},
+    {"POP N", 1},
+    {"POP I", 1},
+    {"POPX", 1},
+    {"POP F", 1},
+    {"MOV A, #nn", 2},
+    {"MOV B, #nn", 2},
+    {"MOV L, #nn", 2},
+    {"MOV H, #nn", 2},
+    {"MOV N, #nn", 2},
+    {"MOV [HL], #nn", 2},
+    {"MOV [X], #nn", 2},
+    {"MOV [Y], #nn", 2},
+    {"MOV BA, [#nnnn]", 3},
+    {"MOV HL, [#nnnn]", 3},
+    {"MOV X, [#nnnn]", 3},
+    {"MOV Y, [#nnnn]", 3},
+    {"MOV [#nnnn], BA", 3},
+    {"MOV [#nnnn], HL", 3},
+    {"MOV [#nnnn], X", 3},
+    {"MOV [#nnnn], Y", 3},
+    {"ADD BA, #nnnn", 3},
+    {"ADD HL, #nnnn", 3},
+    {"ADD X, #nnnn", 3},
+    {"ADD Y, #nnnn", 3},
+    {"MOV BA, #nnnn", 3},
+    {"MOV HL, #nnnn", 3},
+    {"MOV X, #nnnn", 3},
+    {"MOV Y, #nnnn", 3},
+    {"XCHG BA, HL", 1},
+    {"XCHG BA, X", 1},
+    {"XCHG BA, Y", 1},
+    {"XCHG BA, SP", 1},
+    {"XCHG A, B", 1},
+    {"XCHG A, [HL]", 1},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"SUB BA, #nnnn", 3},
+    {"SUB HL, #nnnn", 3},
+    {"SUB X, #nnnn", 3},
+    {"SUB Y, #nnnn", 3},
+    {"CMP BA, #nnnn", 3},
+    {"CMP HL, #nnnn", 3},
+    {"CMP X, #nnnn", 3},
+    {"CMP Y, #nnnn", 3},
+    {"AND [N+#nn], #nn", 3},
+    {"OR [N+#nn], #nn", 3},
+    {"XOR [N+#nn], #nn", 3},
+    {"CMP [N+#nn], #nn", 3},
+    {"TST [N+#nn], #nn", 3},
+    {"MOV [N+#nn], #nn", 3},
+    {"PACK", 1},
+    {"UNPACK", 1},
+    {"CALLCB #ss", 2},
+    {"CALLNCB #ss", 2},
+    {"CALLZB #ss", 2},
+    {"CALLNZB #ss", 2},
+    {"JCB #ss", 2},
+    {"JNCB #ss", 2},
+    {"JZB #ss", 2},
+    {"JNZB #ss", 2},
+    {"CALLCW #ssss", 3},
+    {"CALLNCW #ssss", 3},
+    {"CALLZW #ssss", 3},
+    {"CALLNZW #ssss", 3},
+    {"JCW #ssss", 3},
+    {"JNCW #ssss", 3},
+    {"JZW #ssss", 3},
+    {"JNZW #ssss", 3},
+    {"CALLB #ss", 2},
+    {"JMPB #ss", 2},
+    {"CALLW #ssss", 3},
+    {"JMPW #ssss", 3},
+    {"JMP HL", 1},
+    {"JDBNZ #ss", 2},
+    {"SWAP A", 1},
+    {"SWAP [HL]", 1},
+    {"RET", 1},
+    {"RETI", 1},
+    {"RETSKIP", 1},
+    {"CALL [#nnnn]", 3},
+    {"CINT #nn", 2},
+    {"JINT #nn", 2},
+    {nullptr, 0},
+    {"NOP", 1},
+    {"ADD A, [X+#ss]", 3},
+    {"ADD A, [Y+#ss]", 3},
+    {"ADD A, [X+L]", 2},
+    {"ADD A, [Y+L]", 2},
+    {"ADD [HL], A", 2},
+    {"ADD [HL], #nn", 3},
+    {"ADD [HL], [X]", 2},
+    {"ADD [HL], [Y]", 2},
+    {"ADC A, [X+#ss]", 3},
+    {"ADC A, [Y+#ss]", 3},
+    {"ADC A, [X+L]", 2},
+    {"ADC A, [Y+L]", 2},
+    {"ADC [HL], A", 2},
+    {"ADC [HL], #nn", 3},
+    {"ADC [HL], [X]", 2},
+    {"ADC [HL], [Y]", 2},
+    {"SUB A, [X+#ss]", 3},
+    {"SUB A, [Y+#ss]", 3},
+    {"SUB A, [X+L]", 2},
+    {"SUB A, [Y+L]", 2},
+    {"SUB [HL], A", 2},
+    {"SUB [HL], #nn", 3},
+    {"SUB [HL], [X]", 2},
+    {"SUB [HL], [Y]", 2},
+    {"SBC A, [X+#ss]", 3},
+    {"SBC A, [Y+#ss]", 3},
+    {"SBC A, [X+L]", 2},
+    {"SBC A, [Y+L]", 2},
+    {"SBC [HL], A", 2},
+    {"SBC [HL], #nn", 3},
+    {"SBC [HL], [X]", 2},
+    {"SBC [HL], [Y]", 2},
+    {"AND A, [X+#ss]", 3},
+    {"AND A, [Y+#ss]", 3},
+    {"AND A, [X+L]", 2},
+    {"AND A, [Y+L]", 2},
+    {"AND [HL], A", 2},
+    {"AND [HL], #nn", 3},
+    {"AND [HL], [X]", 2},
+    {"AND [HL], [Y]", 2},
+    {"OR A, [X+#ss]", 3},
+    {"OR A, [Y+#ss]", 3},
+    {"OR A, [X+L]", 2},
+    {"OR A, [Y+L]", 2},
+    {"OR [HL], A", 2},
+    {"OR [HL], #nn", 3},
+    {"OR [HL], [X]", 2},
+    {"OR [HL], [Y]", 2},
+    {"CMP A, [X+#ss]", 3},
+    {"CMP A, [Y+#ss]", 3},
+    {"CMP A, [X+L]", 2},
+    {"CMP A, [Y+L]", 2},
+    {"CMP [HL], A", 2},
+    {"CMP [HL], #nn", 3},
+    {"CMP [HL], [X]", 2},
+    {"CMP [HL], [Y]", 2},
+    {"XOR A, [X+#ss]", 3},
+    {"XOR A, [Y+#ss]", 3},
+    {"XOR A, [X+L]", 2},
+    {"XOR A, [Y+L]", 2},
+    {"XOR [HL], A", 2},
+    {"XOR [HL], #nn", 3},
+    {"XOR [HL], [X]", 2},
+    {"XOR [HL], [Y]", 2},
+    {"MOV A, [X+#ss]", 3},
+    {"MOV A, [Y+#ss]", 3},
+    {"MOV A, [X+L]", 2},
+    {"MOV A, [Y+L]", 2},
+    {"MOV [X+#ss], A", 3},
+    {"MOV [Y+#ss], A", 3},
+    {"MOV [X+L], A", 2},
+    {"MOV [Y+L], A", 2},
+    {"MOV B, [X+#ss]", 3},
+    {"MOV B, [Y+#ss]", 3},
+    {"MOV B, [X+L]", 2},
+    {"MOV B, [Y+L]", 2},
+    {"MOV [X+#ss], B", 3},
+    {"MOV [Y+#ss], B", 3},
+    {"MOV [X+L], B", 2},
+    {"MOV [Y+L], B", 2},
+    {"MOV L, [X+#ss]", 3},
+    {"MOV L, [Y+#ss]", 3},
+    {"MOV L, [X+L]", 2},
+    {"MOV L, [Y+L]", 2},
+    {"MOV [X+#ss], L", 3},
+    {"MOV [Y+#ss], L", 3},
+    {"MOV [X+L], L", 2},
+    {"MOV [Y+L], L", 2},
+    {"MOV H, [X+#ss]", 3},
+    {"MOV H, [Y+#ss]", 3},
+    {"MOV H, [X+L]", 2},
+    {"MOV H, [Y+L]", 2},
+    {"MOV [X+#ss], H", 3},
+    {"MOV [Y+#ss], H", 3},
+    {"MOV [X+L], H", 2},
+    {"MOV [Y+L], H", 2},
+    {"MOV [HL], [X+#ss]", 3},
+    {"MOV [HL], [Y+#ss]", 3},
+    {"MOV [HL], [X+L]", 2},
+    {"MOV [HL], [Y+L]", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV [X], [X+#ss]", 3},
+    {"MOV [X], [Y+#ss]", 3},
+    {"MOV [X], [X+L]", 2},
+    {"MOV [X], [Y+L]", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV [Y], [X+#ss]", 3},
+    {"MOV [Y], [Y+#ss]", 3},
+    {"MOV [Y], [X+L]", 2},
+    {"MOV [Y], [Y+L]", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"SAL A", 2},
+    {"SAL B", 2},
+    {"SAL [N+#nn]", 3},
+    {"SAL [HL]", 2},
+    {"SHL A", 2},
+    {"SHL B", 2},
+    {"SHL [N+#nn]", 3},
+    {"SHL [HL]", 2},
+    {"SAR A", 2},
+    {"SAR B", 2},
+    {"SAR [N+#nn]", 3},
+    {"SAR [HL]", 2},
+    {"SHR A", 2},
+    {"SHR B", 2},
+    {"SHR [N+#nn]", 3},
+    {"SHR [HL]", 2},
+    {"ROLC A", 2},
+    {"ROLC B", 2},
+    {"ROLC [N+#nn]", 3},
+    {"ROLC [HL]", 2},
+    {"ROL A", 2},
+    {"ROL B", 2},
+    {"ROL [N+#nn]", 3},
+    {"ROL [HL]", 2},
+    {"RORC A", 2},
+    {"RORC B", 2},
+    {"RORC [N+#nn]", 3},
+    {"RORC [HL]", 2},
+    {"ROR A", 2},
+    {"ROR B", 2},
+    {"ROR [N+#nn]", 3},
+    {"ROR [HL]", 2},
+    {"NOT A", 2},
+    {"NOT B", 2},
+    {"NOT [N+#nn]", 3},
+    {"NOT [HL]", 2},
+    {"NEG A", 2},
+    {"NEG B", 2},
+    {"NEG [N+#nn]", 3},
+    {"NEG [HL]", 2},
+    {"EX BA, A", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"HALT", 2},
+    {"STOP", 2},
+    {"AND B, #nn", 3},
+    {"AND L, #nn", 3},
+    {"AND H, #nn", 3},
+    {nullptr, 0},
+    {"OR B, #nn", 3},
+    {"OR L, #nn", 3},
+    {"OR H, #nn", 3},
+    {nullptr, 0},
+    {"XOR B, #nn", 3},
+    {"XOR L, #nn", 3},
+    {"XOR H, #nn", 3},
+    {nullptr, 0},
+    {"CMP B, #nn", 3},
+    {"CMP L, #nn", 3},
+    {"CMP H, #nn", 3},
+    {"CMP N, #nn", 3},
+    {"MOV A, N", 2},
+    {"MOV A, F", 2},
+    {"MOV N, A", 2},
+    {"MOV F, A", 2},
+    {"MOV U, #nn", 3},
+    {"MOV I, #nn", 3},
+    {"MOV XI, #nn", 3},
+    {"MOV YI, #nn", 3},
+    {"MOV A, V", 2},
+    {"MOV A, I", 2},
+    {"MOV A, XI", 2},
+    {"MOV A, YI", 2},
+    {"MOV U, A", 2},
+    {"MOV I, A", 2},
+    {"MOV XI, A", 2},
+    {"MOV YI, A", 2},
+    {"MOV A, [#nnnn]", 4},
+    {"MOV B, [#nnnn]", 4},
+    {"MOV L, [#nnnn]", 4},
+    {"MOV H, [#nnnn]", 4},
+    {"MOV [#nnnn], A", 4},
+    {"MOV [#nnnn], B", 4},
+    {"MOV [#nnnn], L", 4},
+    {"MOV [#nnnn], H", 4},
+    {"MUL L, A", 2},
+    {"DIV HL, A", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"JL #ss", 3},
+    {"JLE #ss", 3},
+    {"JG #ss", 3},
+    {"JGE #ss", 3},
+    {"JO #ss", 3},
+    {"JNO #ss", 3},
+    {"JNS #ss", 3},
+    {"JS #ss", 3},
+    {"JNX0 #ss", 3},
+    {"JNX1 #ss", 3},
+    {"JNX2 #ss", 3},
+    {"JNX3 #ss", 3},
+    {"JX0 #ss", 3},
+    {"JX1 #ss", 3},
+    {"JX2 #ss", 3},
+    {"JX3 #ss", 3},
+    {"CALLL #ss", 3},
+    {"CALLLE #ss", 3},
+    {"CALLG #ss", 3},
+    {"CALLGE #ss", 3},
+    {"CALLO #ss", 3},
+    {"CALLNO #ss", 3},
+    {"CALLNS #ss", 3},
+    {"CALLS #ss", 3},
+    {"CALLNX0 #ss", 3},
+    {"CALLNX1 #ss", 3},
+    {"CALLNX2 #ss", 3},
+    {"CALLNX3 #ss", 3},
+    {"CALLX0 #ss", 3},
+    {"CALLX1 #ss", 3},
+    {"CALLX2 #ss", 3},
+    {"CALLX3 #ss", 3},
+    {"ADD BA, BA", 2},
+    {"ADD BA, HL", 2},
+    {"ADD BA, X", 2},
+    {"ADD BA, Y", 2},
+    {"ADC BA, BA", 2},
+    {"ADC BA, HL", 2},
+    {"ADC BA, X", 2},
+    {"ADC BA, Y", 2},
+    {"SUB BA, BA", 2},
+    {"SUB BA, HL", 2},
+    {"SUB BA, X", 2},
+    {"SUB BA, Y", 2},
+    {"SBC BA, BA", 2},
+    {"SBC BA, HL", 2},
+    {"SBC BA, X", 2},
+    {"SBC BA, Y", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"CMP BA, BA", 2},
+    {"CMP BA, HL", 2},
+    {"CMP BA, X", 2},
+    {"CMP BA, Y", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"ADD HL, BA", 2},
+    {"ADD HL, HL", 2},
+    {"ADD HL, X", 2},
+    {"ADD HL, Y", 2},
+    {"ADC HL, BA", 2},
+    {"ADC HL, HL", 2},
+    {"ADC HL, X", 2},
+    {"ADC HL, Y", 2},
+    {"SUB HL, BA", 2},
+    {"SUB HL, HL", 2},
+    {"SUB HL, X", 2},
+    {"SUB HL, Y", 2},
+    {"SBC HL, BA", 2},
+    {"SBC HL, HL", 2},
+    {"SBC HL, X", 2},
+    {"SBC HL, Y", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"CMP HL, BA", 2},
+    {"CMP HL, HL", 2},
+    {"CMP HL, X", 2},
+    {"CMP HL, Y", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"ADD X, BA", 2},
+    {"ADD X, HL", 2},
+    {"ADD Y, BA", 2},
+    {"ADD Y, HL", 2},
+    {"ADD SP, BA", 2},
+    {"ADD SP, HL", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"SUB X, BA", 2},
+    {"SUB X, HL", 2},
+    {"SUB Y, BA", 2},
+    {"SUB Y, HL", 2},
+    {"SUB SP, BA", 2},
+    {"SUB SP, HL", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"CMP SP, BA", 2},
+    {"CMP SP, HL", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"ADC BA, #nnnn", 4},
+    {"ADC HL, #nnnn", 4},
+    {"SBC BA, #nnnn", 4},
+    {"SBC HL, #nnnn", 4},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"ADD SP, #nnnn", 4},
+    {nullptr, 0},
+    {"SUB SP, #nnnn", 4},
+    {nullptr, 0},
+    {"CMP SP, #nnnn", 4},
+    {nullptr, 0},
+    {"MOV SP, #nnnn", 4},
+    {nullptr, 0},
+    {"MOV BA, [SP+#ss]", 3},
+    {"MOV HL, [SP+#ss]", 3},
+    {"MOV X, [SP+#ss]", 3},
+    {"MOV Y, [SP+#ss]", 3},
+    {"MOV [SP+#ss], BA", 3},
+    {"MOV [SP+#ss], HL", 3},
+    {"MOV [SP+#ss], X", 3},
+    {"MOV [SP+#ss], Y", 3},
+    {"MOV SP, [#nnnn]", 4},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV [#nnnn], SP", 4},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"PUSH A", 2},
+    {"PUSH B", 2},
+    {"PUSH L", 2},
+    {"PUSH H", 2},
+    {"POP A", 2},
+    {"POP B", 2},
+    {"POP L", 2},
+    {"POP H", 2},
+    {"PUSHA", 2},
+    {"PUSHAX", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"POPA", 2},
+    {"POPAX", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV BA, [HL]", 2},
+    {"MOV HL, [HL]", 2},
+    {"MOV X, [HL]", 2},
+    {"MOV Y, [HL]", 2},
+    {"MOV [HL], BA", 2},
+    {"MOV [HL], HL", 2},
+    {"MOV [HL], X", 2},
+    {"MOV [HL], Y", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV BA, [X]", 2},
+    {"MOV HL, [X]", 2},
+    {"MOV X, [X]", 2},
+    {"MOV Y, [X]", 2},
+    {"MOV [X], BA", 2},
+    {"MOV [X], HL", 2},
+    {"MOV [X], X", 2},
+    {"MOV [X], Y", 2},
+    {"MOV BA, [Y]", 2},
+    {"MOV HL, [Y]", 2},
+    {"MOV X, [Y]", 2},
+    {"MOV Y, [Y]", 2},
+    {"MOV [Y], BA", 2},
+    {"MOV [Y], HL", 2},
+    {"MOV [Y], X", 2},
+    {"MOV [Y], Y", 2},
+    {"MOV BA, BA", 2},
+    {"MOV BA, HL", 2},
+    {"MOV BA, X", 2},
+    {"MOV BA, Y", 2},
+    {"MOV HL, BA", 2},
+    {"MOV HL, HL", 2},
+    {"MOV HL, X", 2},
+    {"MOV HL, Y", 2},
+    {"MOV X, BA", 2},
+    {"MOV X, HL", 2},
+    {"MOV X, X", 2},
+    {"MOV X, Y", 2},
+    {"MOV Y, BA", 2},
+    {"MOV Y, HL", 2},
+    {"MOV Y, X", 2},
+    {"MOV Y, Y", 2},
+    {"MOV SP, BA", 2},
+    {"MOV SP, HL", 2},
+    {"MOV SP, X", 2},
+    {"MOV SP, Y", 2},
+    {"MOV HL, SP", 2},
+    {"MOV HL, PC", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV BA, SP", 2},
+    {"MOV BA, PC", 2},
+    {"MOV X, SP", 2},
+    {nullptr, 0},
+    {nullptr, 0},
+    {nullptr, 0},
+    {"MOV Y, SP", 2},
+    {nullptr, 0},
+};
+
+// Returns the extended opcode of the instruction starting at opcode.
+inline int instruction_index(const uint8_t* opcode)
+{
+    if(opcode[0] == 0xCE) return 0x100 + opcode[1];
+    if(opcode[0] == 0xCF) return 0x200 + opcode[1];
+    return opcode[0];
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+// Interrupt latency and handler duration of each IRQ source of minx.sv's irqs
+// vector, as histograms with power of two buckets. The latency is the number
+// of cycles from the rising edge of the IRQ line to the iack of the CPU that
+// serves it, the duration the number of cycles from that iack to the RETI of
+// the handler, including nested interrupts.
+//
+// An IRQ line that rises again before it was served keeps the cycle of its
+// first edge. A pending IRQ is dropped without a latency when its flag in
+// IRQ_ACT is cleared by the guest code, e.g. after polling it.
+//
+// The statistics are printed and written as CSV, one row per source and
+// measure:
+//
+//     irq,name,measure,count,min,mean,max,histogram
+//
+// histogram lists <first cycles of the bucket>:<count> pairs separated by
+// spaces.
+
+const int IRQ_STATS_NUM_SOURCES = 32;
+// Bucket 0 holds 0 cycles, bucket i > 0 holds [2^(i-1), 2^i).
+const int IRQ_STATS_NUM_BUCKETS = 28;
+const int IRQ_STATS_MAX_NESTING = 16;
+
+enum
+{
+    IRQ_STATS_LATENCY,
+    IRQ_STATS_DURATION,
+    IRQ_STATS_NUM_MEASURES
+};
+
+const char* const irq_stats_measure_names[IRQ_STATS_NUM_MEASURES] = {"latency", "duration"};
+
+// The bit of each IRQ source in the IRQ_ACT registers, irq_reg_map of irq.sv.
+const uint8_t irq_stats_register_bits[IRQ_STATS_NUM_SOURCES] = {
+    29, 28, 27, 7, 6, 5, 4, 3, 2, 1, 0,
+    13, 12, 11, 10, 31, 30, 15, 14, 9, 8,
+    23, 22, 21, 20, 19, 18, 17, 16, 26, 25, 24
+};
+
+const char* const irq_stats_source_names[IRQ_STATS_NUM_SOURCES] = {
+    "nmi0", "nmi1", "nmi2",
+    "prc_copy_complete", "prc_render_done",
+    "tmr2_hi", "tmr2_lo", "tmr1_hi", "tmr1_lo", "tmr3_hi", "tmr3_pivot",
+    "tmr256_0", "tmr256_1", "tmr256_2", "tmr256_3",
+    "irq_0x0F", "key_8", "irq_0x11", "irq_0x12", "irq_0x13", "irq_0x14",
+    "key_7", "key_6", "key_5", "key_4", "key_3", "key_2", "key_1", "key_0",
+    "irq_0x1D", "irq_0x1E", "irq_0x1F"
+};
+
+struct IrqHistogram
+{
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t buckets[IRQ_STATS_NUM_BUCKETS];
+};
+
+struct IrqHandler
+{
+    uint8_t source;
+    uint64_t iack_cycles;
+};
+
+struct IrqStats
+{
+    IrqHistogram histograms[IRQ_STATS_NUM_SOURCES][IRQ_STATS_NUM_MEASURES];
+
+    uint32_t previous_irqs;
+    uint32_t previous_active;
+    bool previous_iack;
+    uint32_t pending;
+    uint64_t pending_cycles[IRQ_STATS_NUM_SOURCES];
+
+    IrqHandler handlers[IRQ_STATS_MAX_NESTING];
+    int num_handlers;
+};
+
+inline void irq_histogram_add(IrqHistogram* histogram, uint64_t cycles)
+{
+    int bucket = cycles? std::min(64 - __builtin_clzll(cycles), IRQ_STATS_NUM_BUCKETS - 1): 0;
+    histogram->min = (histogram->count == 0)? cycles: std::min(histogram->min, cycles);
+    histogram->max = std::max(histogram->max, cycles);
+    histogram->sum += cycles;
+    ++histogram->count;
+    ++histogram->buckets[bucket];
+}
+
+// Call every simulation step. irqs is minx.sv's irqs vector, active the
+// reg_irq_active register of irq.sv, vector the IRQ latched for the iack
+// (next_irq_latch) and cycles the current cycle.
+inline void irq_stats_update(IrqStats* stats, uint32_t irqs, uint32_t active, bool iack, uint8_t vector, uint64_t cycles)
+{
+    if(irqs != stats->previous_irqs)
+    {
+        uint32_t rising = irqs & ~stats->previous_irqs & ~stats->pending;
+        stats->previous_irqs = irqs;
+        stats->pending |= rising;
+        for(; rising; rising &= rising - 1)
+            stats->pending_cycles[__builtin_ctz(rising)] = cycles;
+    }
+
+    if(active != stats->previous_active)
+    {
+        uint32_t cleared = stats->previous_active & ~active;
+        stats->previous_active = active;
+        for(int i = 0; i < IRQ_STATS_NUM_SOURCES && cleared; ++i)
+            if((cleared >> irq_stats_register_bits[i]) & 1)
+                stats->pending &= ~(1u << i);
+    }
+
+    if(iack && !stats->previous_iack)
+    {
+        uint8_t source = vector % IRQ_STATS_NUM_SOURCES;
+        if((stats->pending >> source) & 1)
+            irq_histogram_add(&stats->histograms[source][IRQ_STATS_LATENCY], cycles - stats->pending_cycles[source]);
+        stats->pending &= ~(1u << source);
+
+        if(stats->num_handlers < IRQ_STATS_MAX_NESTING)
+            stats->handlers[stats->num_handlers++] = {source, cycles};
+    }
+    stats->previous_iack = iack;
+}
+
+// Call for every retired instruction.
+inline void irq_stats_retire(IrqStats* stats, uint16_t extended_opcode, uint64_t cycles)
+{
+    const uint16_t RETI = 0xF9;
+    if(extended_opcode != RETI || stats->num_handlers == 0) return;
+
+    const IrqHandler& handler = stats->handlers[--stats->num_handlers];
+    irq_histogram_add(&stats->histograms[handler.source][IRQ_STATS_DURATION], cycles - handler.iack_cycles);
+}
+
+namespace
+{
+    void irq_stats_print_summary(const IrqStats* stats)
+    {
+        printf("%-18s %-8s %10s %10s %12s %10s\n", "irq", "measure", "count", "min", "mean", "max");
+        for(int i = 0; i < IRQ_STATS_NUM_SOURCES; ++i)
+        {
+            for(int measure = 0; measure < IRQ_STATS_NUM_MEASURES; ++measure)
+            {
+                const IrqHistogram& histogram = stats->histograms[i][measure];
+                if(histogram.count == 0) continue;
+                printf("%-18s %-8s %10llu %10llu %12.1f %10llu\n",
+                    irq_stats_source_names[i], irq_stats_measure_names[measure], (unsigned long long)histogram.count,
+                    (unsigned long long)histogram.min, (double)histogram.sum / histogram.count, (unsigned long long)histogram.max
+                );
+            }
+        }
+    }
+
+    bool irq_stats_save_csv(const IrqStats* stats, const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "w");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening IRQ statistics file %s.\n", filepath);
+            return false;
+        }
+
+        fprintf(fp, "irq,name,measure,count,min,mean,max,histogram\n");
+        for(int i = 0; i < IRQ_STATS_NUM_SOURCES; ++i)
+        {
+            for(int measure = 0; measure < IRQ_STATS_NUM_MEASURES; ++measure)
+            {
+                const IrqHistogram& histogram = stats->histograms[i][measure];
+                if(histogram.count == 0) continue;
+                fprintf(fp, "0x%02X,%s,%s,%llu,%llu,%.3f,%llu,",
+                    i, irq_stats_source_names[i], irq_stats_measure_names[measure], (unsigned long long)histogram.count,
+                    (unsigned long long)histogram.min, (double)histogram.sum / histogram.count, (unsigned long long)histogram.max
+                );
+
+                const char* separator = "";
+                for(int b = 0; b < IRQ_STATS_NUM_BUCKETS; ++b)
+                {
+                    if(histogram.buckets[b] == 0) continue;
+                    fprintf(fp, "%s%llu:%llu", separator, b? 1ull << (b - 1): 0ull, (unsigned long long)histogram.buckets[b]);
+                    separator = " ";
+                }
+                fprintf(fp, "\n");
+            }
+        }
+
+        fclose(fp);
+        return true;
+    }
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstdarg>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Logging for the simulation loop. Messages are formatted on the calling
+// thread into a lock-free ring of that thread, and a background thread writes
+// them to the log file, so a message costs a vsnprintf and no I/O. Messages
+// of different threads are not ordered with respect to each other.
+//
+// The log level is selected at runtime with log_set_level() or the
+// MINX_LOG_LEVEL environment variable (0 or none, 1 or error, 2 or debug), and
+// messages above it cost a single comparison. Each LOG_ERROR/LOG_DEBUG call
+// site is limited to a number of messages per second (MINX_LOG_RATE, 0 for no
+// limit); messages beyond it are counted and reported as suppressed once per
+// second and at log_close().
+//
+// A message that does not end with a newline is continued by the next message
+// of the same thread, which is then written or dropped along with it. A line
+// is only written once it is complete, so lines of different threads and the
+// suppressed counts are never interleaved within a line.
+
+enum
+{
+    LOG_LEVEL_NONE,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_DEBUG,
+    LOG_NUM_LEVELS
+};
+
+const char* const log_level_names[LOG_NUM_LEVELS] = {"none", "error", "debug"};
+
+const size_t LOG_MESSAGE_SIZE  = 256;
+const size_t LOG_RING_SIZE     = 4096; // Messages, a power of two.
+const uint32_t LOG_DEFAULT_RATE = 100; // Messages per second per call site.
+
+#define LOG_MESSAGE(level, ...) do{ \
+    if((level) <= log_level.load(std::memory_order_relaxed)) \
+    { \
+        static LogSite log_site(__FILE__, __LINE__); \
+        log_write(&log_site, __VA_ARGS__); \
+    } \
+} while( false )
+
+#define LOG_ERROR(...) LOG_MESSAGE(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_MESSAGE(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+struct LogSite
+{
+    // Constant initialized, so a static LogSite costs no guard.
+    constexpr LogSite(const char* file, int line):
+        file(file), line(line), window_start(0), window_count(0), num_suppressed(0), registered(false), next(nullptr) {}
+
+    const char* file;
+    int line;
+
+    int64_t window_start; // Milliseconds.
+    uint32_t window_count;
+    std::atomic<uint64_t> num_suppressed;
+    std::atomic<bool> registered;
+    LogSite* next;
+};
+
+struct LogMessage
+{
+    uint32_t length;
+    char text[LOG_MESSAGE_SIZE - sizeof(uint32_t)];
+};
+
+// Single producer, single consumer.
+struct LogRing
+{
+    std::atomic<uint64_t> head; // Written by the consumer.
+    std::atomic<uint64_t> tail; // Written by the producer.
+    LogMessage messages[LOG_RING_SIZE];
+
+    // State of the producing thread.
+    bool line_open;
+    bool dropping_line;
+};
+
+namespace
+{
+    std::atomic<int> log_level{LOG_LEVEL_ERROR};
+    std::atomic<uint32_t> log_rate{LOG_DEFAULT_RATE};
+
+    struct Logger
+    {
+        FILE* fp;
+        bool owns_fp;
+
+        std::mutex rings_mutex;
+        std::vector<LogRing*> rings;
+        std::atomic<LogSite*> sites;
+        std::atomic<uint64_t> num_dropped;
+
+        std::atomic<bool> running;
+        std::thread writer;
+    };
+
+    Logger logger;
+    thread_local LogRing* log_thread_ring = nullptr;
+
+    int64_t log_time_ms()
+    {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    LogRing* log_ring()
+    {
+        if(!log_thread_ring)
+        {
+            log_thread_ring = new LogRing;
+            log_thread_ring->head          = 0;
+            log_thread_ring->tail          = 0;
+            log_thread_ring->line_open     = false;
+            log_thread_ring->dropping_line = false;
+
+            std::lock_guard<std::mutex> lock(logger.rings_mutex);
+            logger.rings.push_back(log_thread_ring);
+        }
+        return log_thread_ring;
+    }
+
+    void log_push(LogRing* ring, const char* format, va_list args, bool ends_line)
+    {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        if(tail - ring->head.load(std::memory_order_acquire) == LOG_RING_SIZE)
+        {
+            logger.num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        LogMessage& message = ring->messages[tail & (LOG_RING_SIZE - 1)];
+        int length = vsnprintf(message.text, sizeof(message.text), format, args);
+        if(length < 0) length = 0;
+        message.length = ((size_t)length < sizeof(message.text))? length: sizeof(message.text) - 1;
+        if(ends_line && message.length > 0)
+            message.text[message.length - 1] = '\n'; // Also if truncated.
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Returns true if the call site is within its rate limit.
+    bool log_site_allow(LogSite* site)
+    {
+        if(!site->registered.exchange(true))
+        {
+            site->next = logger.sites.load();
+            while(!logger.sites.compare_exchange_weak(site->next, site));
+        }
+
+        uint32_t rate = log_rate.load(std::memory_order_relaxed);
+        if(rate == 0) return true;
+
+        int64_t now = log_time_ms();
+        if(now - site->window_start >= 1000)
+        {
+            site->window_start = now;
+            site->window_count = 0;
+        }
+        if(site->window_count < rate)
+        {
+            ++site->window_count;
+            return true;
+        }
+        site->num_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    __attribute__((format(printf, 2, 3)))
+    void log_write(LogSite* site, const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        if(!logger.running.load(std::memory_order_relaxed))
+        {
+            // Not opened yet or already closed.
+            vfprintf(stderr, format, args);
+            va_end(args);
+            return;
+        }
+
+        LogRing* ring = log_ring();
+        size_t length = strlen(format);
+        bool ends_line = length > 0 && format[length - 1] == '\n';
+
+        if(ring->dropping_line || (!ring->line_open && !log_site_allow(site)))
+            ring->dropping_line = !ends_line;
+        else
+        {
+            ring->line_open = !ends_line;
+            log_push(ring, format, args, ends_line);
+        }
+        va_end(args);
+    }
+
+    void log_report_suppressed()
+    {
+        for(LogSite* site = logger.sites.load(); site; site = site->next)
+        {
+            uint64_t num_suppressed = site->num_suppressed.exchange(0);
+            if(num_suppressed)
+                fprintf(logger.fp, "** %llu messages from %s:%d suppressed **\n", (unsigned long long)num_suppressed, site->file, site->line);
+        }
+
+        uint64_t num_dropped = logger.num_dropped.exchange(0);
+        if(num_dropped)
+            fprintf(logger.fp, "** %llu messages dropped, log ring full **\n", (unsigned long long)num_dropped);
+    }
+
+    // Writes out the pending complete lines of all threads, or with
+    // partial_lines all pending messages, ending an unfinished line. Returns
+    // false if nothing was written.
+    bool log_drain(bool partial_lines = false)
+    {
+        std::vector<LogRing*> rings;
+        {
+            std::lock_guard<std::mutex> lock(logger.rings_mutex);
+            rings = logger.rings;
+        }
+
+        bool wrote = false;
+        for(LogRing* ring: rings)
+        {
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            uint64_t tail = ring->tail.load(std::memory_order_acquire);
+            uint64_t end  = partial_lines? tail: head;
+            for(uint64_t i = head; i != tail && !partial_lines; ++i)
+            {
+                const LogMessage& message = ring->messages[i & (LOG_RING_SIZE - 1)];
+                if(message.length > 0 && message.text[message.length - 1] == '\n')
+                    end = i + 1;
+            }
+
+            bool line_ended = true;
+            for(; head != end; ++head)
+            {
+                const LogMessage& message = ring->messages[head & (LOG_RING_SIZE - 1)];
+                fwrite(message.text, 1, message.length, logger.fp);
+                if(message.length > 0)
+                    line_ended = message.text[message.length - 1] == '\n';
+            }
+            if(!line_ended)
+                fputc('\n', logger.fp);
+
+            if(head != ring->head.load(std::memory_order_relaxed))
+            {
+                ring->head.store(head, std::memory_order_release);
+                wrote = true;
+            }
+        }
+        return wrote;
+    }
+
+    void log_writer_thread()
+    {
+        int64_t last_report = log_time_ms();
+        while(logger.running.load())
+        {
+            if(!log_drain())
+            {
+                fflush(logger.fp);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            if(log_time_ms() - last_report >= 1000)
+            {
+                log_report_suppressed();
+                last_report = log_time_ms();
+            }
+        }
+    }
+
+    void log_set_level(int level)
+    {
+        log_level = (level < LOG_LEVEL_NONE)? LOG_LEVEL_NONE: (level >= LOG_NUM_LEVELS)? LOG_NUM_LEVELS - 1: level;
+    }
+
+    void log_set_rate_limit(uint32_t messages_per_second)
+    {
+        log_rate = messages_per_second;
+    }
+
+    // Starts the writer thread. filepath is the log file, the log is written
+    // to stderr if it is nullptr.
+    bool log_open(const char* filepath)
+    {
+        logger.fp      = stderr;
+        logger.owns_fp = false;
+        if(filepath)
+        {
+            FILE* fp = fopen(filepath, "w");
+            if(!fp)
+            {
+                fprintf(stderr, "Error opening log file %s, logging to stderr.\n", filepath);
+            }
+            else
+            {
+                logger.fp      = fp;
+                logger.owns_fp = true;
+            }
+        }
+
+        if(const char* level = getenv("MINX_LOG_LEVEL"))
+        {
+            for(int i = 0; i < LOG_NUM_LEVELS; ++i)
+                if(strcmp(level, log_level_names[i]) == 0)
+                    log_set_level(i);
+            if(level[0] >= '0' && level[0] <= '9')
+                log_set_level(atoi(level));
+        }
+        if(const char* rate = getenv("MINX_LOG_RATE"))
+            log_set_rate_limit(strtoul(rate, nullptr, 0));
+
+        logger.running = true;
+        logger.writer  = std::thread(log_writer_thread);
+        return true;
+    }
+
+    // Stops the writer thread after writing out all pending messages and the
+    // remaining suppressed counts.
+    void log_close()
+    {
+        if(!logger.running.exchange(false)) return;
+        logger.writer.join();
+
+        log_drain(true);
+        log_report_suppressed();
+        if(logger.owns_fp)
+            fclose(logger.fp);
+        else
+            fflush(logger.fp);
+    }
+}
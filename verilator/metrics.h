@@ -0,0 +1,309 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <chrono>
+
+#include "block_trace.h"
+#include "watch.h"
+#include "coverage.h"
+#include "rtl_events.h"
+#include "timing_report.h"
+
+// Machine-readable metrics of a run: emulated cycles and frames, wall time and
+// simulation speed, eval calls, bytes of the traces being written, coverage,
+// error counts and the wall time spent in each phase of the harness' loop.
+//
+// The metrics are written to <prefix>.json and, in the Prometheus text
+// exposition format, to <prefix>.prom, at the end of the run and every
+// MINX_METRICS_INTERVAL seconds if that environment variable is set. The
+// prefix can be changed with MINX_METRICS. Each file is written to a
+// temporary file first and renamed, so a scraper never sees a partial one.
+//
+// The JSON file lists every metric with its labels:
+//
+//     {"timestamp": 1700000000, "metrics": [
+//         {"name": "minx_cycles_total", "type": "counter", "labels": {}, "value": 4000000},
+//         {"name": "minx_coverage_bytes", "type": "gauge", "labels": {"region": "bios", "access": "read"}, "value": 2314},
+//         ...
+//     ]}
+//
+// A harness starts a snapshot with metrics_begin, adds its metrics with
+// metrics_add and the metrics_add_* helpers, and writes it with
+// metrics_write, or does all of it with metrics_write_run. Phases are registered with metrics_add_phase and timed with
+// metrics_time_ns and metrics_phase_add.
+
+enum
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE
+};
+
+const int METRICS_MAX_ENTRIES = 128;
+const int METRICS_MAX_PHASES  = 8;
+
+struct Metric
+{
+    char name[48];
+    char labels[64]; // E.g. region="bios",access="read".
+    int type;
+    const char* help;
+    double value;
+};
+
+struct Metrics
+{
+    char filepath_prefix[256];
+    uint64_t interval_ns; // 0 to only write at the end.
+    uint64_t start_ns;
+    uint64_t last_write_ns;
+
+    const char* phase_names[METRICS_MAX_PHASES];
+    uint64_t phase_ns[METRICS_MAX_PHASES];
+    int num_phases;
+
+    Metric entries[METRICS_MAX_ENTRIES];
+    int num_entries;
+};
+
+inline uint64_t metrics_time_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Adds the time since start_ns to a phase.
+inline void metrics_phase_add(Metrics* metrics, int phase, uint64_t start_ns)
+{
+    metrics->phase_ns[phase] += metrics_time_ns() - start_ns;
+}
+
+namespace
+{
+    // Applies MINX_METRICS and MINX_METRICS_INTERVAL.
+    void metrics_init(Metrics* metrics, const char* default_prefix)
+    {
+        memset(metrics, 0, sizeof(Metrics));
+        const char* prefix = getenv("MINX_METRICS");
+        snprintf(metrics->filepath_prefix, sizeof(metrics->filepath_prefix), "%s", prefix? prefix: default_prefix);
+        if(const char* interval = getenv("MINX_METRICS_INTERVAL"))
+            metrics->interval_ns = (uint64_t)(atof(interval) * 1e9);
+        metrics->start_ns      = metrics_time_ns();
+        metrics->last_write_ns = metrics->start_ns;
+    }
+
+    // Returns the index of the phase.
+    int metrics_add_phase(Metrics* metrics, const char* name)
+    {
+        if(metrics->num_phases == METRICS_MAX_PHASES)
+        {
+            fprintf(stderr, "Error: Too many metrics phases, %s is not timed.\n", name);
+            return METRICS_MAX_PHASES - 1;
+        }
+        metrics->phase_names[metrics->num_phases] = name;
+        return metrics->num_phases++;
+    }
+
+    // Returns true if a periodic snapshot is due.
+    bool metrics_due(const Metrics* metrics)
+    {
+        return metrics->interval_ns && metrics_time_ns() - metrics->last_write_ns >= metrics->interval_ns;
+    }
+
+    // Metrics of a family must be added one after another, labels being
+    // empty or e.g. region="bios",access="read".
+    void metrics_add(Metrics* metrics, int type, const char* name, const char* labels, const char* help, double value)
+    {
+        if(metrics->num_entries == METRICS_MAX_ENTRIES)
+        {
+            fprintf(stderr, "Error: Too many metrics, %s is not written.\n", name);
+            return;
+        }
+        Metric& metric = metrics->entries[metrics->num_entries++];
+        snprintf(metric.name, sizeof(metric.name), "minx_%s", name);
+        snprintf(metric.labels, sizeof(metric.labels), "%s", labels);
+        metric.type  = type;
+        metric.help  = help;
+        metric.value = value;
+    }
+
+    // Starts a snapshot with the wall time and the phase timings.
+    void metrics_begin(Metrics* metrics)
+    {
+        metrics->num_entries = 0;
+        metrics_add(metrics, METRIC_GAUGE, "wall_time_seconds", "", "Wall time since the start of the run.",
+            (metrics_time_ns() - metrics->start_ns) * 1e-9);
+        for(int phase = 0; phase < metrics->num_phases; ++phase)
+        {
+            char labels[64];
+            snprintf(labels, sizeof(labels), "phase=\"%s\"", metrics->phase_names[phase]);
+            metrics_add(metrics, METRIC_COUNTER, "phase_seconds_total", labels, "Wall time spent in each phase of the harness.",
+                metrics->phase_ns[phase] * 1e-9);
+        }
+    }
+
+    // Adds the emulated cycles and frames, the simulation speed and eval calls.
+    void metrics_add_run(Metrics* metrics, uint64_t cycles, uint64_t frames, uint64_t num_evals)
+    {
+        double seconds = (metrics_time_ns() - metrics->start_ns) * 1e-9;
+        metrics_add(metrics, METRIC_COUNTER, "cycles_total", "", "Emulated CPU clock cycles.", cycles);
+        metrics_add(metrics, METRIC_COUNTER, "frames_total", "", "Emulated frames, ended by frame_complete.", frames);
+        metrics_add(metrics, METRIC_GAUGE, "cycles_per_second", "", "Emulated cycles per wall clock second.", seconds > 0.0? cycles / seconds: 0.0);
+        metrics_add(metrics, METRIC_COUNTER, "eval_calls_total", "", "Calls of the Verilator model's eval().", num_evals);
+    }
+
+    // Adds the bytes written and buffered by the writers that are open, any of
+    // which can be null.
+    void metrics_add_trace_bytes(Metrics* metrics, const TraceWriter* trace, const BlockTraceWriter* block_trace, const WatchList* watch)
+    {
+        uint64_t trace_bytes = 0;
+        if(trace) trace_bytes += (trace->num_records_written + trace->num_records) * sizeof(TraceRecord);
+        if(block_trace) trace_bytes += block_trace->num_bytes_written + block_trace->buffer_size;
+        if(watch) trace_bytes += (watch->num_records_written + watch->num_records) * sizeof(WatchRecord);
+        metrics_add(metrics, METRIC_GAUGE, "trace_bytes", "", "Bytes of the traces being written.", trace_bytes);
+    }
+
+    void metrics_add_coverage(Metrics* metrics, const Coverage* coverage)
+    {
+        char labels[COVERAGE_NUM_REGIONS][BUS_ACCESS_NUM_TYPES][64];
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+                snprintf(labels[region][access], sizeof(labels[region][access]), "region=\"%s\",access=\"%s\"",
+                    coverage_region_names[region], (access == BUS_ACCESS_READ)? "read": "write");
+
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+        {
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+            {
+                const CoverageMap& map = coverage->maps[region][access];
+                metrics_add(metrics, METRIC_GAUGE, "coverage_bytes", labels[region][access], "Bytes accessed at least once.",
+                    coverage_popcount(map.bits, coverage_num_words(map.size)));
+            }
+        }
+        for(int region = 0; region < COVERAGE_NUM_REGIONS; ++region)
+            for(int access = 0; access < BUS_ACCESS_NUM_TYPES; ++access)
+                metrics_add(metrics, METRIC_GAUGE, "coverage_size_bytes", labels[region][access], "Size of each coverage region.",
+                    coverage->maps[region][access].size);
+    }
+
+    // Adds the count of each RTL event and the instructions whose cycles did
+    // not match.
+    void metrics_add_errors(Metrics* metrics, const RtlEvents* events, const TimingReport* timing_report)
+    {
+        for(int i = 0; i < RTL_NUM_EVENTS; ++i)
+        {
+            char labels[64];
+            snprintf(labels, sizeof(labels), "event=\"%s\"", rtl_event_names[i]);
+            metrics_add(metrics, METRIC_COUNTER, "rtl_events_total", labels, "RTL events raised, by type.", events->counts[i]);
+        }
+        metrics_add(metrics, METRIC_COUNTER, "timing_discrepancies_total", "", "Instructions whose cycles matched none of the expected counts.",
+            timing_report->num_discrepancies);
+        metrics_add(metrics, METRIC_COUNTER, "instructions_total", "", "Retired instructions.", timing_report->num_instructions);
+    }
+
+    void metrics_write_labels_json(FILE* fp, const char* labels)
+    {
+        // key="value",... to "key": "value", ...
+        fprintf(fp, "{");
+        for(const char* c = labels; *c; ++c)
+        {
+            if(c == labels || c[-1] == ',') fprintf(fp, "\"");
+            if(*c == '=')
+                fprintf(fp, "\": ");
+            else if(*c == ',')
+                fprintf(fp, ", ");
+            else
+                fputc(*c, fp);
+        }
+        fprintf(fp, "}");
+    }
+
+    bool metrics_write_json(const Metrics* metrics, const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "w");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening metrics file %s.\n", filepath);
+            return false;
+        }
+
+        fprintf(fp, "{\"timestamp\": %lld, \"metrics\": [\n", (long long)time(nullptr));
+        for(int i = 0; i < metrics->num_entries; ++i)
+        {
+            const Metric& metric = metrics->entries[i];
+            fprintf(fp, "    {\"name\": \"%s\", \"type\": \"%s\", \"labels\": ", metric.name, (metric.type == METRIC_COUNTER)? "counter": "gauge");
+            metrics_write_labels_json(fp, metric.labels);
+            fprintf(fp, ", \"value\": %.15g}%s\n", metric.value, (i + 1 < metrics->num_entries)? ",": "");
+        }
+        fprintf(fp, "]}\n");
+
+        fclose(fp);
+        return true;
+    }
+
+    bool metrics_write_prometheus(const Metrics* metrics, const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "w");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening metrics file %s.\n", filepath);
+            return false;
+        }
+
+        for(int i = 0; i < metrics->num_entries; ++i)
+        {
+            const Metric& metric = metrics->entries[i];
+            if(i == 0 || strcmp(metric.name, metrics->entries[i - 1].name) != 0)
+            {
+                fprintf(fp, "# HELP %s %s\n", metric.name, metric.help);
+                fprintf(fp, "# TYPE %s %s\n", metric.name, (metric.type == METRIC_COUNTER)? "counter": "gauge");
+            }
+            if(metric.labels[0])
+                fprintf(fp, "%s{%s} %.15g\n", metric.name, metric.labels, metric.value);
+            else
+                fprintf(fp, "%s %.15g\n", metric.name, metric.value);
+        }
+
+        fclose(fp);
+        return true;
+    }
+
+    // Writes the snapshot to <prefix>.json and <prefix>.prom.
+    bool metrics_write(Metrics* metrics)
+    {
+        metrics->last_write_ns = metrics_time_ns();
+
+        bool ok = true;
+        const char* extensions[2] = {".json", ".prom"};
+        for(int i = 0; i < 2; ++i)
+        {
+            char filepath[300];
+            char temp_filepath[304];
+            snprintf(filepath, sizeof(filepath), "%s%s", metrics->filepath_prefix, extensions[i]);
+            snprintf(temp_filepath, sizeof(temp_filepath), "%s.tmp", filepath);
+            bool written = (i == 0)? metrics_write_json(metrics, temp_filepath): metrics_write_prometheus(metrics, temp_filepath);
+            if(written && rename(temp_filepath, filepath) != 0)
+            {
+                fprintf(stderr, "Error renaming metrics file %s to %s.\n", temp_filepath, filepath);
+                written = false;
+            }
+            ok = ok && written;
+        }
+        return ok;
+    }
+
+    // Writes a snapshot of everything both harnesses report.
+    bool metrics_write_run(Metrics* metrics, uint64_t cycles, uint64_t frames, uint64_t num_evals,
+        const TraceWriter* trace, const BlockTraceWriter* block_trace, const WatchList* watch,
+        const Coverage* coverage, const RtlEvents* events, const TimingReport* timing_report)
+    {
+        metrics_begin(metrics);
+        metrics_add_run(metrics, cycles, frames, num_evals);
+        metrics_add_trace_bytes(metrics, trace, block_trace, watch);
+        metrics_add_coverage(metrics, coverage);
+        metrics_add_errors(metrics, events, timing_report);
+        return metrics_write(metrics);
+    }
+}
@@ -7,25 +7,32 @@
 #include <cstdint>
 
 #include "instruction_cycles.h"
+#include "trace.h"
+#include "block_trace.h"
+#include "bus_access.h"
+#include "minx_signals.h"
+#include "watch.h"
+#include "coverage.h"
+#include "opcode_stats.h"
+#include "timing_report.h"
+#include "log.h"
+#include "rtl_events.h"
+#include "guest_profile.h"
+#include "ram_heatmap.h"
+#include "hw_registers.h"
+#include "irq_stats.h"
+#include "prc_stats.h"
+#include "bus_stats.h"
+#include "cpu_load.h"
+#include "metrics.h"
+#include "frame_composer.h"
+#include "video_record.h"
 
 #include <SDL2/SDL.h>
 #include <GL/glew.h>
 #include <SDL2/SDL_opengl.h>
 #include "gl_utils.h"
 
-#define VERBOSE 1
-
-#if VERBOSE == 0
-#define PRINTE(...) do{ } while ( false )
-#define PRINTD(...) do{ } while ( false )
-#elif VERBOSE == 1
-#define PRINTE(...) do{ fprintf( stderr, __VA_ARGS__ ); } while( false )
-#define PRINTD(...) do{ } while ( false )
-#else
-#define PRINTE(...) do{ fprintf( stderr, __VA_ARGS__ ); } while( false )
-#define PRINTD(...) do{ fprintf( stdout, __VA_ARGS__ ); } while( false )
-#endif
-
 
 int min(int a, int b)
 {
@@ -176,8 +183,18 @@ struct SimData
 {
     Vminx* minx;
     VerilatedVcdC* tfp;
+    TraceWriter* trace;
+    BlockTraceWriter* block_trace;
+    WatchList* watch;
+    GuestProfile* profile;
+    RamHeatmap* heatmap;
+    VideoRecorder* video;
+    // Registers latched when the currently executing instruction started.
+    TraceRecord trace_state;
+    BusAccess bus_access;
 
     uint64_t timestamp;
+    uint64_t num_evals;
     uint64_t osc1_clocks;
     uint64_t osc1_next_clock;
 
@@ -188,12 +205,25 @@ struct SimData
     size_t bios_file_size;
     size_t cartridge_file_size;
 
-    uint8_t* bios_touched;
-    uint8_t* cartridge_touched;
-    uint8_t* instructions_executed;
-
-    uint8_t fb_write_index;
-    uint8_t framebuffers[768*8];
+    Coverage* coverage;
+    OpcodeStats* opcode_stats;
+    TimingReport* timing_report;
+    HwRegisters* hw_registers;
+    IrqStats* irq_stats;
+    // PRC timing of the current and last frame.
+    PrcStats prc_stats;
+    BusStats bus_stats;
+    CpuLoad cpu_load;
+    RtlEvents rtl_events;
+    // Shadow call stack, checks calls and returns.
+    CallStack call_stack;
+    bool check_call_stack;
+
+    // The last frames, blended for display.
+    FrameBlender frame_blender;
+
+    // Signals that can be looked up by name, including the RAM emulated here.
+    std::vector<SignalInfo> signals;
 };
 
 struct AudioBuffer
@@ -214,8 +244,6 @@ void sim_init(SimData* sim, const char* cartridge_path)
     fread(sim->bios, 1, sim->bios_file_size, fp);
     fclose(fp);
 
-    sim->bios_touched = (uint8_t*) calloc(sim->bios_file_size, 1);
-
     sim->memory = (uint8_t*) calloc(1, 4*1024);
 
     // Load a cartridge.
@@ -228,11 +256,23 @@ void sim_init(SimData* sim, const char* cartridge_path)
     fread(sim->cartridge, 1, sim->cartridge_file_size, fp);
     fclose(fp);
 
-    sim->cartridge_touched = (uint8_t*) calloc(1, sim->cartridge_file_size);
-    sim->instructions_executed = (uint8_t*) calloc(1, 0x300);
-
-    sim->fb_write_index = 0;
-    memset(sim->framebuffers, 0x0, 8*768);
+    // Use COVERAGE_COUNTERS to also count the accesses to each address.
+    sim->coverage = coverage_init(COVERAGE_BITSET, sim->bios_file_size, sim->cartridge, sim->cartridge_file_size);
+    sim->opcode_stats = (OpcodeStats*) calloc(1, sizeof(OpcodeStats));
+    sim->timing_report = (TimingReport*) calloc(1, sizeof(TimingReport));
+    sim->irq_stats = (IrqStats*) calloc(1, sizeof(IrqStats));
+    prc_stats_init(&sim->prc_stats, sim->memory);
+    bus_stats_init(&sim->bus_stats);
+    cpu_load_init(&sim->cpu_load);
+    // Set MINX_HW_LOG to log the accesses to some hardware registers.
+    sim->hw_registers = hw_registers_init("sim_registers.log");
+    rtl_events_init(&sim->rtl_events, sim->memory);
+    call_stack_init(&sim->call_stack, instruction_cycles);
+    sim->check_call_stack = true;
+
+    // Blends the frames of the flicker period, the a key switches to the
+    // last 4 frames.
+    frame_blender_init(&sim->frame_blender, true, 4);
 
     sim->minx = new Vminx;
     sim->minx->clk = 0;
@@ -244,11 +284,23 @@ void sim_init(SimData* sim, const char* cartridge_path)
     sim->osc1_next_clock = sim->osc1_clocks;
 
     sim->timestamp = 0;
+    sim->num_evals = 0;
 
     Verilated::traceEverOn(true);
     sim->tfp = nullptr;
+    sim->trace = nullptr;
+    sim->block_trace = nullptr;
+    sim->watch = nullptr;
+    sim->profile = nullptr;
+    sim->heatmap = nullptr;
+    sim->video = nullptr;
+    memset(&sim->trace_state, 0, sizeof(TraceRecord));
+    memset(&sim->bus_access, 0, sizeof(BusAccess));
 
     sim->minx->clk_rt_ce = 1;
+
+    sim->signals = minx_signals(sim->minx->rootp);
+    sim->signals.push_back({"ram", sim->memory, 8, 1, 0x1000});
 }
 
 void sim_dump_stop(SimData* sim)
@@ -261,6 +313,124 @@ void sim_dump_stop(SimData* sim)
     sim->tfp = nullptr;
 }
 
+void sim_trace_start(SimData* sim, const char* filepath)
+{
+    printf("Starting instruction trace at timestamp: %llu.\n", sim->timestamp);
+    if(sim->trace)
+        trace_close(sim->trace);
+
+    sim->trace = trace_open(filepath);
+}
+
+void sim_trace_stop(SimData* sim)
+{
+    if(!sim->trace) return;
+    printf("Stopping instruction trace, %llu instructions written.\n", sim->trace->num_records_written + sim->trace->num_records);
+
+    trace_close(sim->trace);
+    sim->trace = nullptr;
+}
+
+void sim_block_trace_start(SimData* sim, const char* filepath)
+{
+    printf("Starting block trace at timestamp: %llu.\n", sim->timestamp);
+    if(sim->block_trace)
+        block_trace_close(sim->block_trace);
+
+    sim->block_trace = block_trace_open(filepath, sim->bios, sim->bios_file_size, sim->cartridge, sim->cartridge_file_size);
+}
+
+void sim_block_trace_stop(SimData* sim)
+{
+    if(!sim->block_trace) return;
+
+    block_trace_close(sim->block_trace);
+    sim->block_trace = nullptr;
+}
+
+void sim_watch_start(SimData* sim, const char* filepath, const char* watch_filepath)
+{
+    printf("Starting watch log at timestamp: %llu.\n", sim->timestamp);
+    if(sim->watch)
+        watch_close(sim->watch);
+
+    sim->watch = watch_open(filepath, watch_filepath, sim->signals.data(), sim->signals.size(), sim->timestamp);
+}
+
+void sim_watch_stop(SimData* sim)
+{
+    if(!sim->watch) return;
+    printf("Stopping watch log, %llu changes written.\n", sim->watch->num_records_written + sim->watch->num_records);
+
+    watch_close(sim->watch);
+    sim->watch = nullptr;
+}
+
+void sim_profile_start(SimData* sim)
+{
+    printf("Starting guest profile at timestamp: %llu.\n", sim->timestamp);
+    if(sim->profile)
+        guest_profile_free(sim->profile);
+
+    sim->profile = guest_profile_init(instruction_cycles, "data/bios.asm");
+}
+
+void sim_profile_stop(SimData* sim, const char* filepath)
+{
+    if(!sim->profile) return;
+    printf("Stopping guest profile, %llu cycles written to %s.\n", sim->profile->stack.cycles, filepath);
+
+    guest_profile_save_callgrind(sim->profile, filepath, "minx_sdl2_sim");
+    guest_profile_free(sim->profile);
+    sim->profile = nullptr;
+}
+
+void sim_heatmap_start(SimData* sim, const char* filepath)
+{
+    printf("Starting RAM heatmap at timestamp: %llu.\n", sim->timestamp);
+    if(sim->heatmap)
+        ram_heatmap_close(sim->heatmap);
+
+    sim->heatmap = ram_heatmap_open(filepath);
+}
+
+void sim_heatmap_stop(SimData* sim)
+{
+    if(!sim->heatmap) return;
+    printf("Stopping RAM heatmap, %u frames written.\n", sim->heatmap->num_frames);
+
+    ram_heatmap_close(sim->heatmap);
+    sim->heatmap = nullptr;
+}
+
+void sim_video_start(SimData* sim, const char* filepath)
+{
+    printf("Starting video recording at timestamp: %llu.\n", sim->timestamp);
+    if(sim->video)
+        video_record_close(sim->video);
+
+    sim->video = video_record_open(filepath);
+}
+
+void sim_video_stop(SimData* sim)
+{
+    if(!sim->video) return;
+    printf("Stopping video recording.\n");
+
+    video_record_close(sim->video);
+    sim->video = nullptr;
+}
+
+uint8_t sim_read_memory(const SimData* sim, uint32_t address)
+{
+    if(address < 0x1000)
+        return sim->bios[address & (sim->bios_file_size - 1)];
+    else if(address < 0x2000)
+        return sim->memory[address & 0xFFF];
+    else
+        return sim->cartridge[address & 0x1FFFFF];
+}
+
 void sim_dump_eeprom(SimData* sim, const char* filepath)
 {
     VlUnpacked<unsigned char, 8192> rom = sim->minx->rootp->minx__DOT__eeprom__DOT__rom;
@@ -326,8 +496,28 @@ void sim_load_eeprom(SimData* sim, const char* filepath)
     sim->minx->rootp->minx__DOT__system_control__DOT__reg_system_control[2] |= 2;
 }
 
-void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullptr)
+// Writes the metrics of the run so far, see metrics.h.
+void sim_write_metrics(SimData* sim, Metrics* metrics)
 {
+    metrics_write_run(metrics, sim->timestamp / 2, sim->cpu_load.num_frames, sim->num_evals,
+        sim->trace, sim->block_trace, sim->watch, sim->coverage, &sim->rtl_events, sim->timing_report
+    );
+}
+
+// Raises an RTL event at the current instruction, returns true if the
+// simulation should stop.
+bool sim_raise_event(SimData* sim, int type, uint32_t detail = 0)
+{
+    TraceRecord state = sim->trace_state;
+    state.timestamp   = sim->timestamp;
+    state.pc          = sim->minx->rootp->minx__DOT__cpu__DOT__top_address;
+    return rtl_event_raise(&sim->rtl_events, type, detail, state);
+}
+
+// Returns true if the simulation was stopped by an RTL event.
+bool simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullptr)
+{
+    bool stopped = false;
     uint8_t frame_complete_latch = sim->minx->frame_complete;
     for(int i = 0; i < n_steps && !Verilated::gotFinish(); ++i)
     {
@@ -337,6 +527,7 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
         {
             sim->minx->clk_rt = !sim->minx->clk_rt;
             sim->minx->eval();
+            ++sim->num_evals;
             if(sim->tfp) sim->tfp->dump(sim->timestamp);
             sim->osc1_next_clock += sim->osc1_clocks;
         }
@@ -349,27 +540,44 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
         {
             sim->minx->clk_rt = !sim->minx->clk_rt;
             sim->minx->eval();
+            ++sim->num_evals;
             if(sim->tfp) sim->tfp->dump(sim->timestamp);
             sim->osc1_next_clock += sim->osc1_clocks;
         }
         else if(sim->tfp) sim->tfp->dump(sim->timestamp);
         sim->timestamp++;
+        sim->num_evals += 2;
+
+        bus_access_decode(&sim->bus_access, sim->minx->bus_status == BUS_MEM_READ && sim->minx->pl == 0,
+            sim->minx->bus_status == BUS_MEM_WRITE && sim->minx->write, sim->minx->read || sim->minx->write,
+            sim->minx->bus_ack, sim->minx->address_out, sim->minx->data_out, sim->minx->rootp->minx__DOT__cpu_data_in);
+
+        if(sim->watch) watch_update(sim->watch, sim->timestamp);
+        if(sim->watch) watch_bus(sim->watch, sim->timestamp, sim->bus_access, trace_physical_address(sim->minx->rootp->minx__DOT__cpu__DOT__top_address, sim->trace_state.cb));
 
         if(sim->minx->address_out == 0xAB)
             sim_load_eeprom(sim, "eeprom000.bin");
 
 
+        int8_t sound_level = video_sound_level(sim->minx->sound_volume, sim->minx->sound_pulse);
         if(audio_buffer)
         {
-            uint8_t volume = sim->minx->sound_volume;
-            uint8_t sound_pulse = sim->minx->sound_pulse;
-            int8_t multiplier = (volume == 0)? 0: ((volume == 3)? 127: 63);
-            audio_buffer->data[i] = (2 * sound_pulse - 1) * multiplier;
+            audio_buffer->data[i] = sound_level;
             //if(audio_buffer->data[i] < 0) --audio_buffer->data[i];
         }
+        if(sim->video) video_record_audio(sim->video, sound_level, sim->timestamp / 2);
+
+        cpu_load_update(&sim->cpu_load, sim->minx->rootp->minx__DOT__cpu__DOT__state, sim->minx->bus_ack);
+        prc_stats_update(&sim->prc_stats, sim->minx->rootp->minx__DOT__prc__DOT__state, sim->minx->bus_request, sim->minx->bus_ack,
+            sim->minx->rootp->minx__DOT__irq_render_done, sim->bus_access);
 
         if(sim->minx->frame_complete && !frame_complete_latch)
         {
+            prc_stats_end_frame(&sim->prc_stats, sim->timestamp, sim->minx->rootp->minx__DOT__prc__DOT__reg_mode, sim->minx->rootp->minx__DOT__prc__DOT__reg_rate);
+            bus_stats_end_frame(&sim->bus_stats, sim->timestamp);
+            cpu_load_end_frame(&sim->cpu_load);
+
+            uint8_t frame[768];
             if(sim->minx->rootp->minx__DOT__lcd__DOT__display_enabled)
             {
                 for (int yC=0; yC<8; yC++)
@@ -381,19 +589,25 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
                             sim->minx->rootp->minx__DOT__lcd__DOT__invert_pixels_enabled?
                                 sim->minx->rootp->minx__DOT__lcd__DOT__lcd_data[yC * 132 + xC] ^ 0xFF:
                                 sim->minx->rootp->minx__DOT__lcd__DOT__lcd_data[yC * 132 + xC];
-                        sim->framebuffers[768 * sim->fb_write_index + yC * 96 + xC] = data;
+                        frame[yC * 96 + xC] = data;
                     }
                 }
             }
-            else memset(sim->framebuffers + 768 * sim->fb_write_index, 0, 96*8);
-            sim->fb_write_index = (sim->fb_write_index + 1) % 8;
+            else memset(frame, 0, 96*8);
+
+            uint8_t prc_mode = sim->minx->rootp->minx__DOT__prc__DOT__reg_mode;
+            uint8_t prc_rate = sim->minx->rootp->minx__DOT__prc__DOT__reg_rate;
+            int rate_divider = (prc_mode & 0x0E)? prc_rate_dividers[(prc_rate >> 1) & 7]: 1;
+            frame_blender_push(&sim->frame_blender, frame, rate_divider);
+            if(sim->heatmap) ram_heatmap_end_frame(sim->heatmap, sim->timestamp);
+            if(sim->video) video_record_frame(sim->video, sim->timestamp / 2, sim->minx->rootp->minx__DOT__lcd__DOT__contrast, frame, 96);
         }
         frame_complete_latch = sim->minx->frame_complete;
 
         if(sim->minx->rootp->minx__DOT__irq_copy_complete && irq_copy_complete_old == 0)
         {
             irq_copy_complete_old = 1;
-            PRINTD("Copy complete %d.\n", sim->timestamp / 2);
+            LOG_DEBUG("Copy complete %llu.\n", (unsigned long long)sim->timestamp / 2);
         }
         else if(!sim->minx->rootp->minx__DOT__irq_copy_complete) irq_copy_complete_old = 0;
 
@@ -408,7 +622,7 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
                 if(sim->minx->rootp->minx__DOT__cpu__DOT__microaddress == 0 &&
                    sim->minx->rootp->minx__DOT__cpu__DOT__extended_opcode != 0x1AE
                 ){
-                    PRINTE("** Instruction 0x%x not implemented at 0x%x, timestamp: %llu**\n", sim->minx->rootp->minx__DOT__cpu__DOT__extended_opcode, sim->minx->rootp->minx__DOT__cpu__DOT__top_address, sim->timestamp);
+                    stopped |= sim_raise_event(sim, RTL_EVENT_INSTRUCTION, sim->minx->rootp->minx__DOT__cpu__DOT__extended_opcode);
                 }
             }
 
@@ -431,57 +645,105 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
                 !sim->minx->bus_ack)
             {
                 if(irq_processing)
+                {
                     irq_processing = false;
+                    if(sim->profile)
+                        guest_profile_interrupt(sim->profile, sim->trace_state.sp, num_cycles_since_sync);
+                    if(sim->check_call_stack)
+                    {
+                        int mismatch = call_stack_interrupt(&sim->call_stack, sim->trace_state.sp, num_cycles_since_sync);
+                        if(mismatch)
+                            stopped |= sim_raise_event(sim, rtl_call_stack_events[mismatch], sim->call_stack.expected);
+                    }
+                }
                 else
                 {
                     uint8_t num_cycles        = num_cycles_since_sync;
                     uint16_t extended_opcode  = sim->minx->rootp->minx__DOT__cpu__DOT__extended_opcode;
-                    uint8_t num_cycles_actual = instruction_cycles[2*extended_opcode];
-                    uint8_t num_cycles_actual_branch = instruction_cycles[2*extended_opcode+1];
 
-
-                    if(num_cycles != num_cycles_actual)
-                        if(num_cycles != num_cycles_actual_branch || num_cycles_actual_branch == 0)
-                            PRINTE(" ** Discrepancy found in number of cycles of instruction 0x%x: %d, %d, timestamp: %llu** \n", extended_opcode, num_cycles, num_cycles_actual, sim->timestamp);
+                    timing_report_check(sim->timing_report, instruction_cycles, extended_opcode, num_cycles, trace_physical_address(sim->minx->rootp->minx__DOT__cpu__DOT__top_address, sim->trace_state.cb), sim->timestamp);
 
                     //if(sim->minx->address_out == 0x4C5C)
                     //    printf("^ address: 0x%x, A: 0x%x\n", 0x4C5C, sim->minx->rootp->minx__DOT__cpu__DOT__BA & 0xFF);
 
-                    //if(!sim->instructions_executed[extended_opcode])
+                    //if(!sim->opcode_stats->counts[extended_opcode])
                     //    printf("Instruction 0x%x executed for the first time, at 0x%x, timestamp: %llu.\n", extended_opcode, sim->minx->rootp->minx__DOT__cpu__DOT__top_address, sim->timestamp);
-                    sim->instructions_executed[extended_opcode] = 1;
+                    opcode_stats_add(sim->opcode_stats, extended_opcode, num_cycles);
+                    irq_stats_retire(sim->irq_stats, extended_opcode, sim->timestamp / 2);
+
+                    TraceRecord record     = sim->trace_state;
+                    record.timestamp       = sim->timestamp;
+                    record.pc              = sim->minx->rootp->minx__DOT__cpu__DOT__top_address;
+                    record.extended_opcode = extended_opcode;
+                    record.num_cycles      = num_cycles;
+
+                    if(sim->watch)
+                        watch_instruction(sim->watch, sim->timestamp, trace_physical_address(record.pc, record.cb));
+
+                    if(sim->profile)
+                        guest_profile_retire(sim->profile, record);
+
+                    if(sim->check_call_stack)
+                    {
+                        int mismatch = call_stack_retire(&sim->call_stack, record);
+                        if(mismatch)
+                            stopped |= sim_raise_event(sim, rtl_call_stack_events[mismatch], sim->call_stack.expected);
+                    }
+
+                    if(sim->trace || sim->block_trace)
+                    {
+                        uint32_t address = trace_physical_address(record.pc, record.cb);
+                        for(int j = 0; j < 4; ++j)
+                            record.opcode[j] = sim_read_memory(sim, address + j);
+
+                        if(sim->trace) trace_write(sim->trace, record);
+                        if(sim->block_trace) block_trace_write(sim->block_trace, record);
+                    }
                 }
+
+                // The next instruction starts here, latch its registers.
+                sim->trace_state.ba = sim->minx->rootp->minx__DOT__cpu__DOT__BA;
+                sim->trace_state.hl = sim->minx->rootp->minx__DOT__cpu__DOT__HL;
+                sim->trace_state.ix = sim->minx->rootp->minx__DOT__cpu__DOT__IX;
+                sim->trace_state.iy = sim->minx->rootp->minx__DOT__cpu__DOT__IY;
+                sim->trace_state.sp = sim->minx->rootp->minx__DOT__cpu__DOT__SP;
+                sim->trace_state.sc = sim->minx->rootp->minx__DOT__cpu__DOT__SC;
+                sim->trace_state.cb = sim->minx->rootp->minx__DOT__cpu__DOT__CB;
+                sim->trace_state.nb = sim->minx->rootp->minx__DOT__cpu__DOT__NB;
+                sim->trace_state.ep = sim->minx->rootp->minx__DOT__cpu__DOT__EP;
+                sim->trace_state.xp = sim->minx->rootp->minx__DOT__cpu__DOT__XP;
+                sim->trace_state.yp = sim->minx->rootp->minx__DOT__cpu__DOT__YP;
+                sim->trace_state.br = sim->minx->rootp->minx__DOT__cpu__DOT__BR;
             }
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_addressing_error == 1)
-                PRINTE(" ** Addressing not implemented error: 0x%llx, timestamp: %llu** \n", (sim->minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x3F00000) >> 20, sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_addressing_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_ADDRESSING, (sim->minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x3F00000) >> 20);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_jump_error == 1)
-                PRINTE(" ** Jump not implemented error, 0x%llx, timestamp: %llu** \n", (sim->minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x7C000) >> 14, sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_jump_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_JUMP, (sim->minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x7C000) >> 14);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_data_out_error == 1)
-                PRINTE(" ** Data-out not implemented error, timestamp: %llu** \n", sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_data_out_error == 1 && sim->minx->pl == 1)
+                stopped |= sim_raise_event(sim, RTL_EVENT_DATA_OUT);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_mov_src_error == 1)
-                PRINTE(" ** Mov src not implemented error, timestamp: %llu** \n", sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_mov_src_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_MOV_SRC);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_write_error == 1)
-                PRINTE(" ** Write not implemented error, timestamp: %llu** \n", sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_write_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_WRITE);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__alu_op_error == 1)
-                PRINTE(" ** Alu not implemented error, timestamp: %llu** \n", sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__alu_op_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_ALU_OP);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_alu_pack_ops_error == 1)
-                PRINTE(" ** Alu packed operations not implemented error, sim->timestamp: %llu, 0x%x** \n", sim->timestamp, sim->minx->rootp->minx__DOT__cpu__DOT__top_address);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_alu_pack_ops_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_ALU_PACK_OPS);
 
-            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_divzero_error == 1)
-                PRINTE(" ** Division by zero exception not implemented error, sim->timestamp: %llu**\n", sim->timestamp);
+            if(sim->minx->rootp->minx__DOT__cpu__DOT__not_implemented_divzero_error == 1 && sim->minx->pl == 0)
+                stopped |= sim_raise_event(sim, RTL_EVENT_DIVZERO);
 
             if(sim->minx->rootp->minx__DOT__cpu__DOT__SP > 0x2000 && sim->minx->pl == 0)
-            {
-                PRINTE(" ** Stack overflow, timestamp: %llu**\n", sim->timestamp);
-                break;
-            }
+                stopped |= sim_raise_event(sim, RTL_EVENT_STACK_OVERFLOW);
+
+            if(stopped) break;
         }
 
         //static bool once = false;
@@ -526,13 +788,20 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
             irq_processing = true;
         }
 
+        irq_stats_update(sim->irq_stats, sim->minx->rootp->minx__DOT__irqs, sim->minx->rootp->minx__DOT__irq__DOT__reg_irq_active,
+            sim->minx->iack, sim->minx->rootp->minx__DOT__irq__DOT__next_irq_latch, sim->timestamp / 2);
+
+        coverage_update(sim->coverage, sim->bus_access);
+        bus_stats_update(&sim->bus_stats, sim->bus_access);
+        hw_registers_update(sim->hw_registers, sim->bus_access, sim->timestamp, trace_physical_address(sim->minx->rootp->minx__DOT__cpu__DOT__top_address, sim->trace_state.cb));
+        if(sim->heatmap) ram_heatmap_update(sim->heatmap, sim->bus_access);
+
         if(sim->minx->bus_status == BUS_MEM_READ && sim->minx->pl == 0) // Check if PL=0 just to reduce spam.
         {
             // memory read
             if(sim->minx->address_out < 0x1000)
             {
                 // read from bios
-                sim->bios_touched[sim->minx->address_out & (sim->bios_file_size - 1)] = 1;
                 sim->minx->data_in = *(sim->bios + (sim->minx->address_out & (sim->bios_file_size - 1)));
             }
             else if(sim->minx->address_out < 0x2000)
@@ -544,7 +813,6 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
             else
             {
                 // read from cartridge
-                sim->cartridge_touched[(sim->minx->address_out & 0x1FFFFF) & (sim->cartridge_file_size - 1)] = 1;
                 sim->minx->data_in = *(uint8_t*)(sim->cartridge + (sim->minx->address_out & 0x1FFFFF));
             }
 
@@ -558,7 +826,7 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
             // memory write
             if(sim->minx->address_out < 0x1000)
             {
-                PRINTD("Program trying to write to bios at 0x%x, timestamp: %llu\n", sim->minx->address_out, sim->timestamp);
+                LOG_DEBUG("Program trying to write to bios at 0x%x, timestamp: %llu\n", sim->minx->address_out, (unsigned long long)sim->timestamp);
             }
             else if(sim->minx->address_out < 0x2000)
             {
@@ -568,7 +836,7 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
             }
             else
             {
-                PRINTD("Program trying to write to cartridge at 0x%x, timestamp: %llu\n", sim->minx->address_out, sim->timestamp);
+                LOG_DEBUG("Program trying to write to cartridge at 0x%x, timestamp: %llu\n", sim->minx->address_out, (unsigned long long)sim->timestamp);
             }
 
             data_sent = true;
@@ -583,6 +851,7 @@ void simulate_steps(SimData* sim, int n_steps, AudioBuffer* audio_buffer = nullp
                 ++num_cycles_since_sync;
         }
     }
+    return stopped;
 }
 // Contrast level on light and dark pixel
 const uint8_t contrast_level_map[64*2] = {
@@ -652,77 +921,22 @@ const uint8_t contrast_level_map[64*2] = {
     240, 255,   // 63 (0x3F)
 };
 
-uint8_t* get_lcd_image(const SimData* sim)
+// Writes the current LCD content into image, 96x64 bytes.
+void get_lcd_image(SimData* sim, uint8_t* image)
 {
     uint8_t contrast = sim->minx->rootp->minx__DOT__lcd__DOT__contrast;
-    uint8_t* image_data = new uint8_t[96*64];
-
-    for (int yC=0; yC<8; yC++)
-    {
-        for (int xC=0; xC<96; xC++)
-        {
-            uint8_t data = sim->minx->rootp->minx__DOT__lcd__DOT__lcd_data[yC * 132 + xC];
-            //uint8_t data = sim->memory[yC * 96 + xC];
-            for(int i = 0; i < 8; ++i)
-            {
-                int idx = 96 * (63 - 8 * yC - i) + xC;
-                image_data[idx] = ((~data >> i) & 1)? contrast_level_map[2*contrast]: contrast_level_map[2*contrast + 1];
-            }
-        }
-    }
+    static FrameComposer composer;
+    if(composer.num_frames == 0) frame_composer_init(&composer, 1);
 
-    return image_data;
+    const uint8_t* frame = sim->minx->rootp->minx__DOT__lcd__DOT__lcd_data.m_storage;
+    frame_composer_draw(&composer, &frame, 132, contrast_level_map[2*contrast], contrast_level_map[2*contrast + 1], image);
 }
 
-uint8_t* render_framebuffers(const SimData* sim)
+// Writes the blend of the last frames into image, 96x64 bytes.
+void render_framebuffers(SimData* sim, uint8_t* image)
 {
     uint8_t contrast = sim->minx->rootp->minx__DOT__lcd__DOT__contrast;
-
-    uint8_t* image_data = new uint8_t[96*64];
-
-    //static uint8_t levels_covered[16] = {};
-
-    for (int yC=0; yC<8; yC++)
-    {
-        for (int xC=0; xC<96; xC++)
-        {
-            uint8_t fb_idx = (sim->fb_write_index + 7) % 8;
-            uint8_t d0 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            fb_idx = (sim->fb_write_index + 6) % 8;
-            uint8_t d1 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            fb_idx = (sim->fb_write_index + 5) % 8;
-            uint8_t d2 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            fb_idx = (sim->fb_write_index + 4) % 8;
-            uint8_t d3 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            fb_idx = (sim->fb_write_index + 3) % 8;
-            uint8_t d4 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            fb_idx = (sim->fb_write_index + 2) % 8;
-            uint8_t d5 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            fb_idx = (sim->fb_write_index + 1) % 8;
-            uint8_t d6 = sim->framebuffers[768 * fb_idx + yC * 96 + xC];
-            for(int i = 0; i < 8; ++i)
-            {
-                int idx = 96 * (63 - 8 * yC - i) + xC;
-                float output = 0.0;
-                output += ((d0 >> i) & 1)? contrast_level_map[2*contrast+1]: contrast_level_map[2*contrast];
-                output += ((d1 >> i) & 1)? contrast_level_map[2*contrast+1]: contrast_level_map[2*contrast];
-                output += ((d2 >> i) & 1)? contrast_level_map[2*contrast+1]: contrast_level_map[2*contrast];
-                output += ((d3 >> i) & 1)? contrast_level_map[2*contrast+1]: contrast_level_map[2*contrast];
-                //output += ((d4 >> i) & 1)? contrast_level_map[2*contrast+1]: contrast_level_map[2*contrast];
-                //output += ((d5 >> i) & 1)? contrast_level_map[2*contrast+1]: contrast_level_map[2*contrast];
-                //output += 1.0 * (((~d6 >> i) & 1)? 255.0: 255.0 * (1.0 - (float)contrast / 0x20));
-                image_data[idx] = output / 4.0;
-            }
-        }
-    }
-
-    //printf("%d%d%d%d\n", frames01_same, frames12_same, frames23_same, frames34_same);
-
-    //for(int i = 0; i < 16; ++i)
-    //    printf("%d", levels_covered[i]);
-    //printf("\n");
-
-    return image_data;
+    frame_blender_draw(&sim->frame_blender, contrast_level_map[2*contrast], contrast_level_map[2*contrast + 1], image);
 }
 
 void audio_callback(void* userdata, uint8_t* stream, int len)
@@ -735,7 +949,6 @@ void audio_callback(void* userdata, uint8_t* stream, int len)
     audio_buffer->read_position = audio_buffer->read_position % audio_buffer->size;
 }
 
-// @todo: Create a call stack for keeping track call/return problems.
 // @todo: Interpolate frames like in MiSTer module and experiment.
 int main(int argc, char** argv)
 {
@@ -766,8 +979,19 @@ int main(int argc, char** argv)
     //const char* rom_filepath = "data/pokemon_puzzle_collection_j.min";
     //const char* rom_filepath = "data/pokemon_puzzle_collection_vol2_j.min";
     //const char* rom_filepath = "data/pokemon_pinball_mini_j.min";
+    // Set MINX_LOG_LEVEL=debug to log the hardware register accesses, the l
+    // key cycles through the log levels.
+    log_open(nullptr);
     sim_init(&sim, rom_filepath);
 
+    // Written to sim_metrics.json and sim_metrics.prom at exit, set
+    // MINX_METRICS_INTERVAL to also write them every that many seconds.
+    static Metrics metrics;
+    metrics_init(&metrics, "sim_metrics");
+    int metrics_phase_input    = metrics_add_phase(&metrics, "input");
+    int metrics_phase_simulate = metrics_add_phase(&metrics, "simulate");
+    int metrics_phase_render   = metrics_add_phase(&metrics, "render");
+
     // Create window and gl context, and game controller
     int window_width = 960/2;
     int window_height = 640/2;
@@ -856,6 +1080,8 @@ int main(int argc, char** argv)
     uint64_t current_clock = SDL_GetPerformanceCounter();
 
     bool sim_is_running = true;
+    uint32_t cpu_load_num_frames = 0;
+    uint8_t lcd_image[96*64];
     bool program_is_running = true;
     bool dump_sim = false;
     int eeprom_dump_id = 0;
@@ -863,6 +1089,7 @@ int main(int argc, char** argv)
     {
         //printf("%d, %d\n", sim.minx->rootp->minx__DOT__rtc__DOT__timer, sim.minx->rootp->minx__DOT__eeprom__DOT__rom.m_storage[0x1FF6]);
         // Process input
+        uint64_t phase_start_ns = metrics_time_ns();
         SDL_Event sdl_event;
         while(SDL_PollEvent(&sdl_event) != 0)
         {
@@ -887,6 +1114,89 @@ int main(int argc, char** argv)
                         sim_dump_stop(&sim);
                     }
                 }
+                else if(sdl_event.key.keysym.sym == SDLK_i)
+                {
+                    if(!sim.trace)
+                        sim_trace_start(&sim, "sim.trace");
+                    else
+                        sim_trace_stop(&sim);
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_k)
+                {
+                    if(!sim.block_trace)
+                        sim_block_trace_start(&sim, "sim.btrace");
+                    else
+                        sim_block_trace_stop(&sim);
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_w)
+                {
+                    if(!sim.watch)
+                        sim_watch_start(&sim, "sim.watch", "watch.txt");
+                    else
+                        sim_watch_stop(&sim);
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_g)
+                {
+                    if(!sim.profile)
+                        sim_profile_start(&sim);
+                    else
+                        sim_profile_stop(&sim, "callgrind.out.minx");
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_h)
+                {
+                    if(!sim.heatmap)
+                        sim_heatmap_start(&sim, "sim.heatmap");
+                    else
+                        sim_heatmap_stop(&sim);
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_v)
+                {
+                    if(!sim.video)
+                        sim_video_start(&sim, "sim.mvid");
+                    else
+                        sim_video_stop(&sim);
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_f)
+                {
+                    if(!sim.prc_stats.csv_fp)
+                    {
+                        printf("Starting PRC statistics at timestamp: %llu.\n", sim.timestamp);
+                        prc_stats_open_csv(&sim.prc_stats, "sim_prc.csv");
+                    }
+                    else
+                    {
+                        printf("Stopping PRC statistics.\n");
+                        prc_stats_close_csv(&sim.prc_stats);
+                    }
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_u)
+                {
+                    if(!sim.bus_stats.csv_fp)
+                    {
+                        printf("Starting bus statistics at timestamp: %llu.\n", sim.timestamp);
+                        bus_stats_open_csv(&sim.bus_stats, "sim_bus.csv");
+                    }
+                    else
+                    {
+                        printf("Stopping bus statistics.\n");
+                        bus_stats_close_csv(&sim.bus_stats);
+                    }
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_a)
+                {
+                    bool adaptive = !sim.frame_blender.adaptive;
+                    frame_blender_set_adaptive(&sim.frame_blender, adaptive, 4);
+                    printf("Frame blending: %s.\n", adaptive? "flicker period": "last 4 frames");
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_l)
+                {
+                    log_set_level((log_level + 1) % LOG_NUM_LEVELS);
+                    printf("Log level: %s\n", log_level_names[log_level]);
+                }
+                else if(sdl_event.key.keysym.sym == SDLK_o)
+                {
+                    timing_report_print(sim.timing_report, instruction_cycles);
+                }
                 else if(sdl_event.key.keysym.sym == SDLK_e)
                 {
                     char filename[256];
@@ -990,42 +1300,71 @@ int main(int argc, char** argv)
         }
 
 
+        metrics_phase_add(&metrics, metrics_phase_input, phase_start_ns);
+
         uint64_t new_clock = SDL_GetPerformanceCounter();
         double frame_sec = double(new_clock - current_clock) / cpu_frequency;
         current_clock = new_clock;
         //printf("%f\n", 4000000 * frame_sec);
 
-        if(sim_is_running)
-            simulate_steps(&sim, min(num_sim_steps, (int)4000000 * frame_sec), &sim_audio_buffer);
-        uint8_t* lcd_image = render_framebuffers(&sim);
-        //uint8_t* lcd_image = get_lcd_image(&sim);
+        phase_start_ns = metrics_time_ns();
+        if(sim_is_running && simulate_steps(&sim, min(num_sim_steps, (int)4000000 * frame_sec), &sim_audio_buffer))
+        {
+            sim_is_running = false;
+            printf("Simulation stopped by an RTL event, press p to continue.\n");
+        }
+        metrics_phase_add(&metrics, metrics_phase_simulate, phase_start_ns);
+        if(sim.cpu_load.num_frames != cpu_load_num_frames)
+        {
+            cpu_load_num_frames = sim.cpu_load.num_frames;
+            char title[64];
+            snprintf(title, sizeof(title), "Vectron - CPU %.0f%%", cpu_load_percent(&sim.cpu_load.last_frame));
+            SDL_SetWindowTitle(window, title);
+        }
+
+        phase_start_ns = metrics_time_ns();
+        render_framebuffers(&sim, lcd_image);
+        //get_lcd_image(&sim, lcd_image);
         gl_renderer_draw(96, 64, lcd_image);
-        delete[] lcd_image;
 
         SDL_GL_SwapWindow(window);
+        metrics_phase_add(&metrics, metrics_phase_render, phase_start_ns);
+
+        if(metrics_due(&metrics)) sim_write_metrics(&sim, &metrics);
     }
 
+    sim_write_metrics(&sim, &metrics);
     sim_dump_stop(&sim);
+    sim_trace_stop(&sim);
+    sim_block_trace_stop(&sim);
+    sim_watch_stop(&sim);
+    sim_profile_stop(&sim, "callgrind.out.minx");
+    sim_heatmap_stop(&sim);
+    sim_video_stop(&sim);
+    log_close();
 
     SDL_CloseAudioDevice(audio_device_id);
     SDL_GL_DeleteContext(gl_context);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
-    size_t total_touched = 0;
-    for(size_t i = 0; i < sim.bios_file_size; ++i)
-        total_touched += sim.bios_touched[i];
-    printf("%zu bytes out of total %zu read from bios.\n", total_touched, sim.bios_file_size);
-
-    total_touched = 0;
-    for(size_t i = 0; i < sim.cartridge_file_size; ++i)
-        total_touched += sim.cartridge_touched[i];
-    printf("%zu bytes out of total %zu read from cartridge.\n", total_touched, sim.cartridge_file_size);
-
-    total_touched = 0;
-    for(size_t i = 0; i < 0x300; ++i)
-        total_touched += sim.instructions_executed[i];
-    printf("%zu instructions out of total 608 executed.\n", total_touched);
+    coverage_print_summary(sim.coverage);
+    coverage_save(sim.coverage, "sim.coverage");
+
+    printf("%d instructions out of total 608 executed.\n", opcode_stats_num_executed(sim.opcode_stats));
+    opcode_stats_save_csv(sim.opcode_stats, "sim_opcodes.csv", instruction_cycles);
+    timing_report_print(sim.timing_report, instruction_cycles);
+    prc_stats_close_csv(&sim.prc_stats);
+    prc_stats_print_summary(&sim.prc_stats);
+    bus_stats_close_csv(&sim.bus_stats);
+    bus_stats_print_summary(&sim.bus_stats);
+    cpu_load_print_summary(&sim.cpu_load);
+    irq_stats_print_summary(sim.irq_stats);
+    irq_stats_save_csv(sim.irq_stats, "sim_irqs.csv");
+    hw_registers_print_summary(sim.hw_registers);
+    hw_registers_free(sim.hw_registers);
+    rtl_events_print_summary(&sim.rtl_events);
+    if(sim.check_call_stack) call_stack_print_summary(&sim.call_stack);
 
     return 0;
 }
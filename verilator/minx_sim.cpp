@@ -7,23 +7,31 @@
 #include <cstdint>
 
 #include "instruction_cycles.h"
+#include "trace.h"
+#include "block_trace.h"
+#include "bus_access.h"
+#include "minx_signals.h"
+#include "watch.h"
+#include "coverage.h"
+#include "opcode_stats.h"
+#include "timing_report.h"
+#include "log.h"
+#include "rtl_events.h"
+#include "guest_profile.h"
+#include "ram_heatmap.h"
+#include "hw_registers.h"
+#include "irq_stats.h"
+#include "prc_stats.h"
+#include "bus_stats.h"
+#include "cpu_load.h"
+#include "input_latency.h"
+#include "metrics.h"
+#include "frame_dump.h"
+#include "video_record.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-#define VERBOSE 1
-
-#if VERBOSE == 0
-#define PRINTE(...) do{ } while ( false )
-#define PRINTD(...) do{ } while ( false )
-#elif VERBOSE == 1
-#define PRINTE(...) do{ fprintf( stderr, __VA_ARGS__ ); } while( false )
-#define PRINTD(...) do{ } while ( false )
-#else
-#define PRINTE(...) do{ fprintf( stderr, __VA_ARGS__ ); } while( false )
-#define PRINTD(...) do{ fprintf( stdout, __VA_ARGS__ ); } while( false )
-#endif
-
 
 enum
 {
@@ -49,20 +57,20 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x01:
         case 0x02:
         {
-            PRINTD("Writing hardware register SYS_CTRL%d=", address+1);
+            LOG_DEBUG("Writing hardware register SYS_CTRL%d=", address+1);
         }
         break;
 
         case 0x08:
         {
-            PRINTD("Writing hardware register SEC_CTRL=");
+            LOG_DEBUG("Writing hardware register SEC_CTRL=");
             sec_ctrl = data & 3;
         }
         break;
 
         case 0x10:
         {
-            PRINTD("Writing hardware register SYS_BATT=");
+            LOG_DEBUG("Writing hardware register SYS_BATT=");
         }
         break;
 
@@ -73,7 +81,7 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x1C:
         case 0x1D:
         {
-            PRINTD("Writing hardware register TMR%d_%s=", (address - 0x16) / 2, (address % 2)? "OSC": "SCALE");
+            LOG_DEBUG("Writing hardware register TMR%d_%s=", (address - 0x16) / 2, (address % 2)? "OSC": "SCALE");
         }
         break;
 
@@ -81,7 +89,7 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x21:
         case 0x22:
         {
-            PRINTD("Writing hardware register IRQ_PRI%d=", address - 0x1F);
+            LOG_DEBUG("Writing hardware register IRQ_PRI%d=", address - 0x1F);
         }
         break;
 
@@ -90,7 +98,7 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x25:
         case 0x26:
         {
-            PRINTD("Writing hardware register IRQ_ENA%d=", address - 0x22);
+            LOG_DEBUG("Writing hardware register IRQ_ENA%d=", address - 0x22);
         }
         break;
 
@@ -99,7 +107,7 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x29:
         case 0x2A:
         {
-            PRINTD("Writing hardware register IRQ_ACT%d=", address - 0x26);
+            LOG_DEBUG("Writing hardware register IRQ_ACT%d=", address - 0x26);
             data = registers[address] & ~data;
         }
         break;
@@ -111,7 +119,7 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x48:
         case 0x49:
         {
-            PRINTD("Writing hardware register TMR%d_CTRL_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_DEBUG("Writing hardware register TMR%d_CTRL_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
         }
         break;
 
@@ -122,7 +130,7 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x4A:
         case 0x4B:
         {
-            PRINTD("Writing hardware register TMR%d_PRE_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_DEBUG("Writing hardware register TMR%d_PRE_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
         }
         break;
 
@@ -131,56 +139,56 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x3C:
         case 0x3D:
         {
-            PRINTD("Writing hardware register TMR%d_PVT_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_DEBUG("Writing hardware register TMR%d_PVT_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
         }
         break;
 
         case 0x40:
         {
-            PRINTD("Writing hardware register TMR256_CTRL=");
+            LOG_DEBUG("Writing hardware register TMR256_CTRL=");
         }
         break;
 
         case 0x41:
         {
-            PRINTD("Writing hardware register TMR256_CNT=");
+            LOG_DEBUG("Writing hardware register TMR256_CNT=");
         }
         break;
 
         case 0x60:
         {
-            PRINTD("Writing hardware register IO_DIR=");
+            LOG_DEBUG("Writing hardware register IO_DIR=");
         }
         break;
 
         case 0x61:
         {
-            PRINTD("Writing hardware register IO_DATA=");
+            LOG_DEBUG("Writing hardware register IO_DATA=");
         }
         break;
 
         case 0x70:
         {
-            PRINTD("Writing hardware register AUD_CTRL=");
+            LOG_DEBUG("Writing hardware register AUD_CTRL=");
         }
         break;
 
         case 0x71:
         {
-            PRINTD("Writing hardware register AUD_VOL=");
+            LOG_DEBUG("Writing hardware register AUD_VOL=");
         }
         break;
 
         case 0x80:
         {
-            PRINTD("Writing hardware register PRC_MODE=");
+            LOG_DEBUG("Writing hardware register PRC_MODE=");
             prc_mode = data & 0x3F;
         }
         break;
 
         case 0x81:
         {
-            PRINTD("Writing hardware register PRC_RATE=");
+            LOG_DEBUG("Writing hardware register PRC_RATE=");
             if((prc_rate & 0xE) != (data & 0xE)) prc_rate = data & 0xF;
             else prc_rate = (prc_rate & 0xF0) | (data & 0x0F);
         }
@@ -188,52 +196,52 @@ void write_hardware_register(uint32_t address, uint8_t data)
 
         case 0x82:
         {
-            PRINTD("Writing hardware register PRC_MAP_LO=");
+            LOG_DEBUG("Writing hardware register PRC_MAP_LO=");
             prc_map = (prc_map & 0xFFFFF00) | (data & 0xFF);
         }
         break;
 
         case 0x83:
         {
-            PRINTD("Writing hardware register PRC_MAP_MID=");
+            LOG_DEBUG("Writing hardware register PRC_MAP_MID=");
             prc_map = (prc_map & 0xFFF00FF) | ((data & 0xFF) << 8);
         }
         break;
 
         case 0x84:
         {
-            PRINTD("Writing hardware register PRC_MAP_HI=");
+            LOG_DEBUG("Writing hardware register PRC_MAP_HI=");
             prc_map = (prc_map & 0xF00FFFF) | ((data & 0xFF) << 16);
         }
         break;
 
         case 0x85:
         {
-            PRINTD("Writing hardware register PRC_SCROLL_Y=");
+            LOG_DEBUG("Writing hardware register PRC_SCROLL_Y=");
         }
         break;
 
         case 0x86:
         {
-            PRINTD("Writing hardware register PRC_SCROLL_X=");
+            LOG_DEBUG("Writing hardware register PRC_SCROLL_X=");
         }
         break;
 
         case 0x87:
         {
-            PRINTD("Writing hardware register PRC_SPR_LO=");
+            LOG_DEBUG("Writing hardware register PRC_SPR_LO=");
         }
         break;
 
         case 0x88:
         {
-            PRINTD("Writing hardware register PRC_SPR_MID=");
+            LOG_DEBUG("Writing hardware register PRC_SPR_MID=");
         }
         break;
 
         case 0x89:
         {
-            PRINTD("Writing hardware register PRC_SPR_HI=");
+            LOG_DEBUG("Writing hardware register PRC_SPR_HI=");
         }
         break;
 
@@ -242,14 +250,14 @@ void write_hardware_register(uint32_t address, uint8_t data)
             switch(data) {
                 case 0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07:
                 case 0x08: case 0x09: case 0x0A: case 0x0B: case 0x0C: case 0x0D: case 0x0E: case 0x0F:
-                    PRINTD("LCD_CTRL: Set column low.\n");
+                    LOG_DEBUG("LCD_CTRL: Set column low.\n");
                     break;
                 case 0x10: case 0x11: case 0x12: case 0x13: case 0x14: case 0x15: case 0x16: case 0x17:
                 case 0x18: case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E: case 0x1F:
-                    PRINTD("LCD_CTRL: Set column high.\n");
+                    LOG_DEBUG("LCD_CTRL: Set column high.\n");
                     break;
                 case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0x28: case 0x29: case 0x2A: case 0x2B: case 0x2C: case 0x2D: case 0x2E: case 0x2F:
                     // Modify LCD voltage? (2F Default)
@@ -262,12 +270,12 @@ void write_hardware_register(uint32_t address, uint8_t data)
                     // 0x2E = Blue screen (overpower?)
                     // 0x2F = Normal
                     // User shouldn't mess with this ones as may damage the LCD
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x37:
                 case 0x38: case 0x39: case 0x3A: case 0x3B: case 0x3C: case 0x3D: case 0x3E: case 0x3F:
                     // Do nothing?
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47:
                 case 0x48: case 0x49: case 0x4A: case 0x4B: case 0x4C: case 0x4D: case 0x4E: case 0x4F:
@@ -278,127 +286,127 @@ void write_hardware_register(uint32_t address, uint8_t data)
                 case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77:
                 case 0x78: case 0x79: case 0x7A: case 0x7B: case 0x7C: case 0x7D: case 0x7E: case 0x7F:
                     // Set starting LCD scanline (cause warp around)
-                    PRINTD("LCD_CTRL: Display start line\n");
+                    LOG_DEBUG("LCD_CTRL: Display start line\n");
                     break;
                 case 0x80:
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0x81:
-                    PRINTD("LCD_CTRL: Set contrast\n");
+                    LOG_DEBUG("LCD_CTRL: Set contrast\n");
                     break;
                 case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: case 0x87:
                 case 0x88: case 0x89: case 0x8A: case 0x8B: case 0x8C: case 0x8D: case 0x8E: case 0x8F:
                 case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97:
                 case 0x98: case 0x99: case 0x9A: case 0x9B: case 0x9C: case 0x9D: case 0x9E: case 0x9F:
                     // Do nothing?
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0xA0:
                     // Segment Driver Direction Select: Normal
-                    PRINTD("LCD_CTRL: Segment driver direction normal\n");
+                    LOG_DEBUG("LCD_CTRL: Segment driver direction normal\n");
                     break;
                 case 0xA1:
                     // Segment Driver Direction Select: Reverse
-                    PRINTD("LCD_CTRL: Segment driver direction reverse\n");
+                    LOG_DEBUG("LCD_CTRL: Segment driver direction reverse\n");
                     break;
                 case 0xA2:
                     // Max Contrast: Disable
-                    PRINTD("LCD_CTRL: Normal voltage bias\n");
+                    LOG_DEBUG("LCD_CTRL: Normal voltage bias\n");
                     break;
                 case 0xA3:
                     // Max Contrast: Enable
-                    PRINTD("LCD_CTRL: Darker voltage bias\n");
+                    LOG_DEBUG("LCD_CTRL: Darker voltage bias\n");
                     break;
                 case 0xA4:
                     // Set All Pixels: Disable
-                    PRINTD("LCD_CTRL: Set all pixels disable\n");
+                    LOG_DEBUG("LCD_CTRL: Set all pixels disable\n");
                     break;
                 case 0xA5:
                     // Set All Pixels: Enable
-                    PRINTD("LCD_CTRL: Set all pixels enable\n");
+                    LOG_DEBUG("LCD_CTRL: Set all pixels enable\n");
                     break;
                 case 0xA6:
                     // Invert All Pixels: Disable
-                    PRINTD("LCD_CTRL: Invert all pixels disable\n");
+                    LOG_DEBUG("LCD_CTRL: Invert all pixels disable\n");
                     break;
                 case 0xA7:
                     // Invert All Pixels: Enable
-                    PRINTD("LCD_CTRL: Invert all pixels enable\n");
+                    LOG_DEBUG("LCD_CTRL: Invert all pixels enable\n");
                     break;
                 case 0xA8: case 0xA9: case 0xAA: case 0xAB:
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0xAC: case 0xAD:
                     // User shouldn't mess with this ones as may damage the LCD
-                    PRINTD("LCD_CTRL: Damage\n");
+                    LOG_DEBUG("LCD_CTRL: Damage\n");
                     break;
                 case 0xAE:
                     // Display Off
-                    PRINTD("LCD_CTRL: Display off\n");
+                    LOG_DEBUG("LCD_CTRL: Display off\n");
                     break;
                 case 0xAF:
                     // Display On
-                    PRINTD("LCD_CTRL: Display on\n");
+                    LOG_DEBUG("LCD_CTRL: Display on\n");
                     break;
                 case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4: case 0xB5: case 0xB6: case 0xB7:
                 case 0xB8:
                     // Set page (0-8, each page is 8px high)
-                    PRINTD("LCD_CTRL: Set page\n");
+                    LOG_DEBUG("LCD_CTRL: Set page\n");
                     break;
                 case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0xC0: case 0xC1: case 0xC2: case 0xC3: case 0xC4: case 0xC5: case 0xC6: case 0xC7:
                     // Display rows from top to bottom as 0 to 63
-                    PRINTD("LCD_CTRL: Scan direction normal\n");
+                    LOG_DEBUG("LCD_CTRL: Scan direction normal\n");
                     break;
                 case 0xC8: case 0xC9: case 0xCA: case 0xCB: case 0xCC: case 0xCD: case 0xCE: case 0xCF:
                     // Display rows from top to bottom as 63 to 0
-                    PRINTD("LCD_CTRL: Scan direction mirrored\n");
+                    LOG_DEBUG("LCD_CTRL: Scan direction mirrored\n");
                     break;
                 case 0xD0: case 0xD1: case 0xD2: case 0xD3: case 0xD4: case 0xD5: case 0xD6: case 0xD7:
                 case 0xD8: case 0xD9: case 0xDA: case 0xDB: case 0xDC: case 0xDD: case 0xDE: case 0xDF:
                     // Do nothing?
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0xE0:
                     // Start "Read Modify Write"
                     break;
                 case 0xE2:
                     // Reset
-                    PRINTD("LCD_CTRL: Reset display\n");
+                    LOG_DEBUG("LCD_CTRL: Reset display\n");
                     break;
                 case 0xE3:
                     // No operation
-                    PRINTD("LCD_CTRL: ???\n");
+                    LOG_DEBUG("LCD_CTRL: ???\n");
                     break;
                 case 0xEE:
                     // End "Read Modify Write"
-                    PRINTD("LCD_CTRL: Read modify write\n");
+                    LOG_DEBUG("LCD_CTRL: Read modify write\n");
                     break;
                 case 0xE1: case 0xE4: case 0xE5: case 0xE6: case 0xE7:
                 case 0xE8: case 0xE9: case 0xEA: case 0xEB: case 0xEC: case 0xED: case 0xEF:
                     // User shouldn't mess with this ones as may damage the LCD
-                    PRINTD("LCD_CTRL: Damage\n");
+                    LOG_DEBUG("LCD_CTRL: Damage\n");
                     break;
                 case 0xF0: case 0xF1: case 0xF2: case 0xF3: case 0xF4: case 0xF5: case 0xF6: case 0xF7:
                     // 0xF1 and 0xF5 freeze LCD and cause malfunction (need to power off the device to restore)
                     // User shouldn't mess with this ones as may damage the LCD
-                    PRINTD("LCD_CTRL: Damage\n");
+                    LOG_DEBUG("LCD_CTRL: Damage\n");
                     break;
                 case 0xF8: case 0xF9: case 0xFA: case 0xFB: case 0xFC: case 0xFD: case 0xFE: case 0xFF:
                     // Contrast voltage control, FC = Default
                     // User shouldn't mess with this ones as may damage the LCD
-                    PRINTD("LCD_CTRL: Damage\n");
+                    LOG_DEBUG("LCD_CTRL: Damage\n");
                     break;
             }
-            PRINTD("Writing hardware register LCD_CTRL=");
+            LOG_DEBUG("Writing hardware register LCD_CTRL=");
         }
         break;
 
         case 0xFF:
         {
-            PRINTD("Writing hardware register LCD_DATA=");
+            LOG_DEBUG("Writing hardware register LCD_DATA=");
         }
         break;
 
@@ -412,18 +420,18 @@ void write_hardware_register(uint32_t address, uint8_t data)
         case 0x55:
         case 0x62:
         {
-            PRINTD("Writing hardware register Unknown=");
+            LOG_DEBUG("Writing hardware register Unknown=");
         }
         break;
 
         default:
         {
-            PRINTD("Writing to hardware register 0x%x\n", address);
+            LOG_DEBUG("Writing to hardware register 0x%x\n", address);
             return;
         }
     }
     registers[address] = data;
-    PRINTD("0x%x\n", data);
+    LOG_DEBUG("0x%x\n", data);
 }
 
 uint8_t read_hardware_register(uint32_t address)
@@ -435,53 +443,53 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x1:
         case 0x2:
         {
-            PRINTD("Reading hardware register SYS_CTRL%d=", address+1);
+            LOG_DEBUG("Reading hardware register SYS_CTRL%d=", address+1);
         }
         break;
 
         case 0x8:
         {
-            PRINTD("Reading hardware register SEC_CTRL=");
+            LOG_DEBUG("Reading hardware register SEC_CTRL=");
             data = sec_ctrl;
         }
         break;
 
         case 0x9:
         {
-            PRINTD("Reading hardware register SEC_CNT_LO=");
+            LOG_DEBUG("Reading hardware register SEC_CNT_LO=");
             data = sec_cnt & 0xFF;
         }
         break;
 
         case 0xA:
         {
-            PRINTD("Reading hardware register SEC_CNT_MID=");
+            LOG_DEBUG("Reading hardware register SEC_CNT_MID=");
             data = (sec_cnt >> 8) & 0xFF;
         }
         break;
 
         case 0xB:
         {
-            PRINTD("Reading hardware register SEC_CNT_MID=");
+            LOG_DEBUG("Reading hardware register SEC_CNT_MID=");
             data = (sec_cnt >> 16) & 0xFF;
         }
         break;
 
         case 0x10:
         {
-            PRINTD("Reading hardware register SYS_BATT=");
+            LOG_DEBUG("Reading hardware register SYS_BATT=");
         }
         break;
 
         case 0x52:
         {
-            PRINTD("Reading hardware register KEY_PAD=");
+            LOG_DEBUG("Reading hardware register KEY_PAD=");
         }
         break;
 
         case 0x53:
         {
-            PRINTD("Reading hardware register CART_BUS=");
+            LOG_DEBUG("Reading hardware register CART_BUS=");
         }
         break;
 
@@ -492,7 +500,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x1C:
         case 0x1D:
         {
-            PRINTD("Writing hardware register TMR%d_%s=", (address - 0x16) / 2, (address % 2)? "OSC": "SCALE");
+            LOG_DEBUG("Writing hardware register TMR%d_%s=", (address - 0x16) / 2, (address % 2)? "OSC": "SCALE");
         }
         break;
 
@@ -500,7 +508,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x21:
         case 0x22:
         {
-            PRINTD("Reading hardware register IRQ_PRI%d=", address - 0x1F);
+            LOG_DEBUG("Reading hardware register IRQ_PRI%d=", address - 0x1F);
         }
         break;
 
@@ -509,7 +517,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x25:
         case 0x26:
         {
-            PRINTD("Reading hardware register IRQ_ENA%d=", address - 0x22);
+            LOG_DEBUG("Reading hardware register IRQ_ENA%d=", address - 0x22);
         }
         break;
 
@@ -518,7 +526,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x29:
         case 0x2A:
         {
-            PRINTD("Reading hardware register IRQ_ACT%d=", address - 0x26);
+            LOG_DEBUG("Reading hardware register IRQ_ACT%d=", address - 0x26);
         }
         break;
 
@@ -529,7 +537,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x48:
         case 0x49:
         {
-            PRINTD("Reading hardware register TMR%d_CTRL_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_DEBUG("Reading hardware register TMR%d_CTRL_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
         }
         break;
 
@@ -540,7 +548,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x4A:
         case 0x4B:
         {
-            PRINTD("Reading hardware register TMR%d_PRE_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_DEBUG("Reading hardware register TMR%d_PRE_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
         }
         break;
 
@@ -549,7 +557,7 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x3C:
         case 0x3D:
         {
-            PRINTD("Reading hardware register TMR%d_PVT_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_DEBUG("Reading hardware register TMR%d_PVT_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
         }
         break;
 
@@ -560,106 +568,106 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x4E:
         case 0x4F:
         {
-            PRINTD("Reading hardware register TMR%d_CNT_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
-            PRINTE("** Reading hardware register 0x%x which is a timer register and is not implemented! **\n", address);
+            LOG_DEBUG("Reading hardware register TMR%d_CNT_%s=", (address > 0x40)? 3: (address - 0x28) / 8, address % 2? "H": "L");
+            LOG_ERROR("** Reading hardware register 0x%x which is a timer register and is not implemented! **\n", address);
         }
         break;
 
         case 0x40:
         {
-            PRINTD("Reading hardware register TMR256_CTRL=");
+            LOG_DEBUG("Reading hardware register TMR256_CTRL=");
         }
         break;
 
         case 0x41:
         {
-            PRINTD("Reading hardware register TMR256_CNT=");
+            LOG_DEBUG("Reading hardware register TMR256_CNT=");
         }
         break;
 
         case 0x60:
         {
-            PRINTD("Reading hardware register IO_DIR=");
+            LOG_DEBUG("Reading hardware register IO_DIR=");
         }
         break;
 
         case 0x61:
         {
-            PRINTD("Reading hardware register IO_DATA=");
+            LOG_DEBUG("Reading hardware register IO_DATA=");
         }
         break;
 
         case 0x70:
         {
-            PRINTD("Reading hardware register AUD_CTRL=");
+            LOG_DEBUG("Reading hardware register AUD_CTRL=");
         }
         break;
 
         case 0x71:
         {
-            PRINTD("Reading hardware register AUD_VOL=");
+            LOG_DEBUG("Reading hardware register AUD_VOL=");
         }
         break;
 
         case 0x80:
         {
-            PRINTD("Reading hardware register PRC_MODE=");
+            LOG_DEBUG("Reading hardware register PRC_MODE=");
             data = prc_mode;
         }
         break;
 
         case 0x81:
         {
-            PRINTD("Reading hardware register PRC_RATE=");
+            LOG_DEBUG("Reading hardware register PRC_RATE=");
             data = prc_rate;
         }
         break;
 
         case 0x82:
         {
-            PRINTD("Reading hardware register PRC_MAP_LO=");
+            LOG_DEBUG("Reading hardware register PRC_MAP_LO=");
         }
         break;
 
         case 0x83:
         {
-            PRINTD("Reading hardware register PRC_MAP_MID=");
+            LOG_DEBUG("Reading hardware register PRC_MAP_MID=");
         }
         break;
 
         case 0x84:
         {
-            PRINTD("Reading hardware register PRC_MAP_HI=");
+            LOG_DEBUG("Reading hardware register PRC_MAP_HI=");
         }
         break;
 
         case 0x85:
         {
-            PRINTD("Reading hardware register PRC_SCROLL_Y=");
+            LOG_DEBUG("Reading hardware register PRC_SCROLL_Y=");
         }
         break;
 
         case 0x86:
         {
-            PRINTD("Reading hardware register PRC_SCROLL_X=");
+            LOG_DEBUG("Reading hardware register PRC_SCROLL_X=");
         }
         break;
 
         case 0x87:
         {
-            PRINTD("Reading hardware register PRC_SPR_LO=");
+            LOG_DEBUG("Reading hardware register PRC_SPR_LO=");
         }
         break;
 
         case 0x88:
         {
-            PRINTD("Reading hardware register PRC_SPR_MID=");
+            LOG_DEBUG("Reading hardware register PRC_SPR_MID=");
         }
         break;
 
         case 0x89:
         {
-            PRINTD("Reading hardware register PRC_SPR_HI=");
+            LOG_DEBUG("Reading hardware register PRC_SPR_HI=");
         }
         break;
 
@@ -673,29 +681,43 @@ uint8_t read_hardware_register(uint32_t address)
         case 0x55:
         case 0x62:
         {
-            PRINTD("Reading hardware register Unknown=");
+            LOG_DEBUG("Reading hardware register Unknown=");
         }
         break;
 
         default:
         {
-            PRINTD("Reading hardware register 0x%x=", address);
+            LOG_DEBUG("Reading hardware register 0x%x=", address);
         }
         break;
     }
-    PRINTD("0x%x\n", data);
+    LOG_DEBUG("0x%x\n", data);
     return data;
 }
 
+uint8_t read_memory(const uint8_t* bios, size_t bios_file_size, const uint8_t* memory, const uint8_t* cartridge, uint32_t address)
+{
+    if(address < 0x1000)
+        return bios[address & (bios_file_size - 1)];
+    else if(address < 0x2000)
+        return memory[address & 0xFFF];
+    else
+        return cartridge[address & 0x1FFFFF];
+}
+
 int main(int argc, char** argv, char** env)
 {
+    // Set MINX_LOG_LEVEL=debug to log the hardware register accesses, and
+    // MINX_LOG_RATE to change the per-site rate limit. Pass a file path to
+    // log_open to write the log there instead of stderr.
+    log_open(nullptr);
+
     FILE* fp = fopen("data/bios.min", "rb");
     fseek(fp, 0, SEEK_END);
     size_t bios_file_size = ftell(fp);
     fseek(fp, 0, SEEK_SET);  /* same as rewind(f); */
 
     uint8_t* bios = (uint8_t*) malloc(bios_file_size);
-    uint8_t* bios_touched = (uint8_t*) calloc(bios_file_size, 1);
     fread(bios, 1, bios_file_size, fp);
     fclose(fp);
 
@@ -721,19 +743,55 @@ int main(int argc, char** argv, char** env)
     fseek(fp, 0, SEEK_SET);  /* same as rewind(f); */
     fread(cartridge, 1, cartridge_file_size, fp);
     fclose(fp);
-    uint8_t* cartridge_touched = (uint8_t*) calloc(1, cartridge_file_size);
-
-    uint8_t* instructions_executed = (uint8_t*) calloc(1, 0x300);
+    // Use COVERAGE_COUNTERS to also count the accesses to each address.
+    Coverage* coverage = coverage_init(COVERAGE_BITSET, bios_file_size, cartridge, cartridge_file_size);
+
+    OpcodeStats* opcode_stats = (OpcodeStats*) calloc(1, sizeof(OpcodeStats));
+    TimingReport* timing_report = (TimingReport*) calloc(1, sizeof(TimingReport));
+    IrqStats* irq_stats = (IrqStats*) calloc(1, sizeof(IrqStats));
+
+    // Per-frame PRC timing and CPU stalls, written to sim_prc.csv.
+    bool record_prc_stats = false;
+    PrcStats prc_stats;
+    prc_stats_init(&prc_stats, memory);
+    if(record_prc_stats) prc_stats_open_csv(&prc_stats, "sim_prc.csv");
+
+    // Per-frame bus utilization by master and region, written to sim_bus.csv.
+    bool record_bus_stats = false;
+    BusStats bus_stats;
+    bus_stats_init(&bus_stats);
+    if(record_bus_stats) bus_stats_open_csv(&bus_stats, "sim_bus.csv");
+
+    // Share of each frame the CPU executed rather than halted or stalled.
+    CpuLoad cpu_load;
+    cpu_load_init(&cpu_load);
+
+    // Presses A (keys_active bit 0) at random phases once the LCD has not
+    // changed for 10 frames, and measures the frames and cycles until it
+    // changes, written to sim_input_latency.csv.
+    bool measure_input_latency = false;
+    InputLatency input_latency;
+    input_latency_init(&input_latency, 0x01, 10, 60);
+    if(measure_input_latency) input_latency_open_csv(&input_latency, "sim_input_latency.csv");
+    // Set MINX_HW_LOG to log the accesses to some hardware registers.
+    HwRegisters* hw_registers = hw_registers_init("sim_registers.log");
+
+    // Set e.g. MINX_RTL_EVENTS=all=stop to end the run at the first error
+    // flagged by the RTL.
+    RtlEvents rtl_events;
+    rtl_events_init(&rtl_events, memory);
 
     Verilated::commandArgs(argc, argv);
 
     Vminx* minx = new Vminx;
     minx->clk = 0;
     minx->reset = 1;
+    minx->clk_ce_4mhz = 1;
+    minx->clk_rt_ce = 1;
 
     bool dump = true;
-    int dump_step = 2426906;
-    int dump_range =  400000;
+    uint64_t dump_step = 2426906;
+    uint64_t dump_range =  400000;
     VerilatedVcdC* tfp;
     if(dump)
     {
@@ -743,6 +801,49 @@ int main(int argc, char** argv, char** env)
         tfp->open("sim.vcd");
     }
 
+    // Log of retired instructions, print with tools/trace_print. The block
+    // trace is much smaller, expand it with tools/trace_unpack.
+    bool trace_instructions = false;
+    bool trace_blocks = false;
+    TraceWriter* trace = trace_instructions? trace_open("sim.trace"): nullptr;
+    BlockTraceWriter* block_trace = trace_blocks? block_trace_open("sim.btrace", bios, bios_file_size, cartridge, cartridge_file_size): nullptr;
+    TraceRecord trace_state = {};
+    BusAccess bus_access = {};
+
+    // Log of the signals and bus writes listed in the watch file, print with
+    // tools/watch_print.
+    const char* watch_filepath = nullptr;
+    std::vector<SignalInfo> signals = minx_signals(minx->rootp);
+    signals.push_back({"ram", memory, 8, 1, 0x1000});
+    WatchList* watch = watch_filepath? watch_open("sim.watch", watch_filepath, signals.data(), signals.size(), 0): nullptr;
+
+    // Cycle profile of the guest code, open callgrind.out.minx with
+    // KCachegrind.
+    bool profile_guest = false;
+    GuestProfile* profile = profile_guest? guest_profile_init(instruction_cycles, "data/bios.asm"): nullptr;
+
+    // Per-frame RAM access counts of the CPU and PRC, convert to PNG images
+    // with tools/ram_heatmap.
+    bool record_heatmap = false;
+    RamHeatmap* heatmap = record_heatmap? ram_heatmap_open("sim.heatmap"): nullptr;
+
+    // The LCD at every frame and the sound, with identical frames stored as
+    // repeats, convert to Y4M and WAV or mux them with tools/video_export.
+    bool record_video = false;
+    VideoRecorder* video = record_video? video_record_open("sim.mvid"): nullptr;
+
+    // Frames written to temp/frame_<frame>.png by 4 worker threads, use
+    // FRAME_DUMP_RAW for the 1bpp LCD content. The simulation waits while
+    // the queue of 64 frames is full, set drop_frames to drop them instead.
+    bool drop_frames = false;
+    FrameDumper* frame_dumper = frame_dump_open("temp", FRAME_DUMP_PNG, 4, 64, drop_frames);
+
+    // Shadow call stack, flags calls and returns that do not match up as RTL
+    // events.
+    bool check_call_stack = true;
+    CallStack call_stack;
+    call_stack_init(&call_stack, instruction_cycles);
+
     registers[0x52] = 0xFF;
     registers[0x10] = 0x18;
 
@@ -758,13 +859,41 @@ int main(int argc, char** argv, char** env)
     uint64_t osc1_clocks = 4000000.0 / 32768.0 + 0.5;
     uint64_t osc1_next_clock = osc1_clocks;
 
-    int timestamp = 0;
+    uint64_t timestamp = 0;
+    uint64_t num_evals = 0;
+
+    // Written to sim_metrics.json and sim_metrics.prom at exit, set
+    // MINX_METRICS_INTERVAL to also write them every that many seconds. The
+    // simulate phase is the time of the loop not spent writing frames.
+    static Metrics metrics;
+    metrics_init(&metrics, "sim_metrics");
+    int metrics_phase_simulate   = metrics_add_phase(&metrics, "simulate");
+    int metrics_phase_frame_dump = metrics_add_phase(&metrics, "frame_dump");
+    uint64_t loop_start_ns = 0;
+    auto write_metrics = [&]()
+    {
+        metrics.phase_ns[metrics_phase_simulate] = metrics_time_ns() - loop_start_ns - metrics.phase_ns[metrics_phase_frame_dump];
+        metrics_write_run(&metrics, timestamp / 2, cpu_load.num_frames, num_evals, trace, block_trace, watch, coverage, &rtl_events, timing_report);
+    };
+
+    // Raises an RTL event at the current instruction, returns true if the
+    // simulation should stop.
+    auto raise_event = [&](int type, uint32_t detail = 0)
+    {
+        TraceRecord state = trace_state;
+        state.timestamp   = timestamp;
+        state.pc          = minx->rootp->minx__DOT__cpu__DOT__top_address;
+        return rtl_event_raise(&rtl_events, type, detail, state);
+    };
+
     int prc_state = 0;
     bool data_sent = false;
     bool irq_processing = false;
     int irq_render_done_old = 0;
+    int frame_complete_old = 0;
     int irq_copy_complete_old = 0;
     int num_cycles_since_sync = 0;
+    loop_start_ns = metrics_time_ns();
     while (timestamp < 50000000 && !Verilated::gotFinish())
     {
         //322
@@ -772,8 +901,9 @@ int main(int argc, char** argv, char** env)
         minx->eval();
         if(timestamp == osc1_next_clock)
         {
-            minx->rt_clk = !minx->rt_clk;
+            minx->clk_rt = !minx->clk_rt;
             minx->eval();
+            ++num_evals;
             if(dump && timestamp > dump_step - dump_range && timestamp < dump_step + dump_range) tfp->dump(timestamp);
             osc1_next_clock += osc1_clocks;
         }
@@ -784,39 +914,50 @@ int main(int argc, char** argv, char** env)
         minx->eval();
         if(timestamp == osc1_next_clock)
         {
-            minx->rt_clk = !minx->rt_clk;
+            minx->clk_rt = !minx->clk_rt;
             minx->eval();
+            ++num_evals;
             if(dump && timestamp > dump_step - dump_range && timestamp < dump_step + dump_range) tfp->dump(timestamp);
             osc1_next_clock += osc1_clocks;
         }
         else if(dump && timestamp > dump_step - dump_range && timestamp < dump_step + dump_range) tfp->dump(timestamp);
         timestamp++;
+        num_evals += 2;
 
-        if(minx->rootp->minx__DOT__irq_render_done && irq_render_done_old == 0)
-        {
-            irq_render_done_old = 1;
-            PRINTD("Render done %d.\n", timestamp / 2);
+        bus_access_decode(&bus_access, minx->bus_status == BUS_MEM_READ && minx->pl == 0,
+            minx->bus_status == BUS_MEM_WRITE && minx->write, minx->read || minx->write,
+            minx->rootp->minx__DOT__bus_ack, minx->address_out, minx->data_out, minx->rootp->minx__DOT__cpu_data_in);
 
-            uint8_t contrast = minx->rootp->minx__DOT__lcd__DOT__contrast;
-            if(contrast > 0x20) contrast = 0x20;
+        if(watch) watch_update(watch, timestamp);
+        if(watch) watch_bus(watch, timestamp, bus_access, trace_physical_address(minx->rootp->minx__DOT__cpu__DOT__top_address, trace_state.cb));
 
-            uint8_t image_data[96*64];
+        cpu_load_update(&cpu_load, minx->rootp->minx__DOT__cpu__DOT__state, minx->rootp->minx__DOT__bus_ack);
+        prc_stats_update(&prc_stats, minx->rootp->minx__DOT__prc__DOT__state, minx->bus_request, minx->rootp->minx__DOT__bus_ack,
+            minx->rootp->minx__DOT__irq_render_done, bus_access);
+        if(video) video_record_audio(video, video_sound_level(minx->sound_volume, minx->sound_pulse), timestamp / 2);
+        bool frame_completed = minx->frame_complete && frame_complete_old == 0;
+        if(measure_input_latency)
+            input_latency_update(&input_latency, timestamp / 2, frame_completed, minx->rootp->minx__DOT__lcd__DOT__lcd_data.m_storage, &minx->keys_active);
+        if(frame_completed)
+        {
+            prc_stats_end_frame(&prc_stats, timestamp, minx->rootp->minx__DOT__prc__DOT__reg_mode, minx->rootp->minx__DOT__prc__DOT__reg_rate);
+            bus_stats_end_frame(&bus_stats, timestamp);
+            if(heatmap) ram_heatmap_end_frame(heatmap, timestamp);
+            cpu_load_end_frame(&cpu_load);
+            if(video) video_record_frame(video, timestamp / 2, minx->rootp->minx__DOT__lcd__DOT__contrast, minx->rootp->minx__DOT__lcd__DOT__lcd_data.m_storage, 132);
+            if(metrics_due(&metrics)) write_metrics();
+        }
+        frame_complete_old = minx->frame_complete;
 
-            for (int yC=0; yC<8; yC++)
-            {
-                for (int xC=0; xC<96; xC++)
-                {
-                    uint8_t data = minx->rootp->minx__DOT__lcd__DOT__lcd_data[yC * 132 + xC];
-                    for(int i = 0; i < 8; ++i)
-                        image_data[96 * (8 * yC + i) + xC] = ((~data >> i) & 1)? 255.0: 255.0 * (1.0 - (float)contrast / 0x20);
-                }
-            }
+        if(minx->rootp->minx__DOT__irq_render_done && irq_render_done_old == 0)
+        {
+            irq_render_done_old = 1;
+            LOG_DEBUG("Render done %llu.\n", (unsigned long long)timestamp / 2);
+            uint64_t frame_dump_start_ns = metrics_time_ns();
 
-            char path[128];
-            snprintf(path, 128, "temp/frame_%03d.png", frame);
-            printf("%d, %d\n", frame, timestamp);
-            int has_error = !stbi_write_png(path, 96, 64, 1, image_data, 96);
-            if(has_error) printf("Error saving image %s\n", path);
+            printf("%d, %llu\n", frame, (unsigned long long)timestamp);
+            frame_dump_submit(frame_dumper, frame, minx->rootp->minx__DOT__lcd__DOT__contrast, minx->rootp->minx__DOT__lcd__DOT__lcd_data.m_storage);
+            metrics_phase_add(&metrics, metrics_phase_frame_dump, frame_dump_start_ns);
 
             //for(int bid = 0; bid < 0x2000; ++bid)
             //{
@@ -831,7 +972,7 @@ int main(int argc, char** argv, char** env)
         if(minx->rootp->minx__DOT__irq_copy_complete && irq_copy_complete_old == 0)
         {
             irq_copy_complete_old = 1;
-            PRINTD("Copy complete %d.\n", timestamp / 2);
+            LOG_DEBUG("Copy complete %llu.\n", (unsigned long long)timestamp / 2);
         }
         else if(!minx->rootp->minx__DOT__irq_copy_complete) irq_copy_complete_old = 0;
 
@@ -854,7 +995,7 @@ int main(int argc, char** argv, char** env)
             ){
                 //if(minx->rootp->minx__DOT__cpu__DOT__extended_opcode == 0x1AE)
                 //{
-                //    PRINTE("** Halting at 0x%x, timestamp: %d**\n", minx->rootp->minx__DOT__cpu__DOT__top_address, timestamp);
+                //    LOG_ERROR("** Halting at 0x%x, timestamp: %d**\n", minx->rootp->minx__DOT__cpu__DOT__top_address, timestamp);
                 //    //for(int j = 0; j < 0x1000 / 0x1B; ++j)
                 //    //{
                 //    //    for(int k = 0; k < 0x1B; ++k)
@@ -866,7 +1007,8 @@ int main(int argc, char** argv, char** env)
                 //    //printf("\n");
                 //    break;
                 //}
-                PRINTE("** Instruction 0x%x not implemented at 0x%x, timestamp: %d**\n", minx->rootp->minx__DOT__cpu__DOT__extended_opcode, minx->rootp->minx__DOT__cpu__DOT__top_address, timestamp);
+                if(raise_event(RTL_EVENT_INSTRUCTION, minx->rootp->minx__DOT__cpu__DOT__extended_opcode))
+                    break;
             }
         }
         //if(minx->sync == 1 && minx->pl == 0)
@@ -882,54 +1024,104 @@ int main(int argc, char** argv, char** env)
                 !minx->rootp->minx__DOT__bus_ack)
             {
                 if(irq_processing)
+                {
                     irq_processing = false;
+                    if(profile)
+                        guest_profile_interrupt(profile, trace_state.sp, num_cycles_since_sync);
+                    if(check_call_stack)
+                    {
+                        int mismatch = call_stack_interrupt(&call_stack, trace_state.sp, num_cycles_since_sync);
+                        if(mismatch && raise_event(rtl_call_stack_events[mismatch], call_stack.expected))
+                            break;
+                    }
+                }
                 else
                 {
                     uint8_t num_cycles        = num_cycles_since_sync;
                     uint16_t extended_opcode  = minx->rootp->minx__DOT__cpu__DOT__extended_opcode;
-                    uint8_t num_cycles_actual = instruction_cycles[2*extended_opcode];
-                    uint8_t num_cycles_actual_branch = instruction_cycles[2*extended_opcode+1];
 
-                    //if(!instructions_executed[extended_opcode])
+                    //if(!opcode_stats->counts[extended_opcode])
                     //    printf("%d, 0x%x\n", timestamp, extended_opcode);
 
-                    if(num_cycles != num_cycles_actual)
-                        if(num_cycles != num_cycles_actual_branch || num_cycles_actual_branch == 0)
-                            PRINTE(" ** Discrepancy found in number of cycles of instruction 0x%x: %d, %d, timestamp: %d** \n", extended_opcode, num_cycles, num_cycles_actual, timestamp);
+                    timing_report_check(timing_report, instruction_cycles, extended_opcode, num_cycles, trace_physical_address(minx->rootp->minx__DOT__cpu__DOT__top_address, trace_state.cb), timestamp);
+
+                    opcode_stats_add(opcode_stats, extended_opcode, num_cycles);
+                    irq_stats_retire(irq_stats, extended_opcode, timestamp / 2);
+
+                    TraceRecord record     = trace_state;
+                    record.timestamp       = timestamp;
+                    record.pc              = minx->rootp->minx__DOT__cpu__DOT__top_address;
+                    record.extended_opcode = extended_opcode;
+                    record.num_cycles      = num_cycles;
 
-                    instructions_executed[extended_opcode] = 1;
+                    if(watch)
+                        watch_instruction(watch, timestamp, trace_physical_address(record.pc, record.cb));
+
+                    if(profile)
+                        guest_profile_retire(profile, record);
+
+                    if(check_call_stack)
+                    {
+                        int mismatch = call_stack_retire(&call_stack, record);
+                        if(mismatch && raise_event(rtl_call_stack_events[mismatch], call_stack.expected))
+                            break;
+                    }
+
+                    if(trace || block_trace)
+                    {
+                        uint32_t address = trace_physical_address(record.pc, record.cb);
+                        for(int j = 0; j < 4; ++j)
+                            record.opcode[j] = read_memory(bios, bios_file_size, memory, cartridge, address + j);
+
+                        if(trace) trace_write(trace, record);
+                        if(block_trace) block_trace_write(block_trace, record);
+                    }
                 }
+
+                // The next instruction starts here, latch its registers.
+                trace_state.ba = minx->rootp->minx__DOT__cpu__DOT__BA;
+                trace_state.hl = minx->rootp->minx__DOT__cpu__DOT__HL;
+                trace_state.ix = minx->rootp->minx__DOT__cpu__DOT__IX;
+                trace_state.iy = minx->rootp->minx__DOT__cpu__DOT__IY;
+                trace_state.sp = minx->rootp->minx__DOT__cpu__DOT__SP;
+                trace_state.sc = minx->rootp->minx__DOT__cpu__DOT__SC;
+                trace_state.cb = minx->rootp->minx__DOT__cpu__DOT__CB;
+                trace_state.nb = minx->rootp->minx__DOT__cpu__DOT__NB;
+                trace_state.ep = minx->rootp->minx__DOT__cpu__DOT__EP;
+                trace_state.xp = minx->rootp->minx__DOT__cpu__DOT__XP;
+                trace_state.yp = minx->rootp->minx__DOT__cpu__DOT__YP;
+                trace_state.br = minx->rootp->minx__DOT__cpu__DOT__BR;
             }
 
+            bool stop = false;
             if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_addressing_error == 1 && minx->pl == 0)
-                PRINTE(" ** Addressing not implemented error: 0x%llx, timestamp: %d** \n", (minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x3F00000) >> 20, timestamp);
+                stop |= raise_event(RTL_EVENT_ADDRESSING, (minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x3F00000) >> 20);
 
             if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_jump_error == 1 && minx->pl == 0)
-                PRINTE(" ** Jump not implemented error, 0x%llx, timestamp: %d** \n", (minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x7C000) >> 14, timestamp);
+                stop |= raise_event(RTL_EVENT_JUMP, (minx->rootp->minx__DOT__cpu__DOT__micro_op & 0x7C000) >> 14);
 
             if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_data_out_error == 1 && minx->pl == 1)
-                PRINTE(" ** Data-out not implemented error, timestamp: %d** \n", timestamp);
+                stop |= raise_event(RTL_EVENT_DATA_OUT);
 
             if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_mov_src_error == 1 && minx->pl == 0)
-                PRINTE(" ** Mov src not implemented error, timestamp: %d** \n", timestamp);
+                stop |= raise_event(RTL_EVENT_MOV_SRC);
 
             if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_write_error == 1 && minx->pl == 0)
-                PRINTE(" ** Write not implemented error, timestamp: %d** \n", timestamp);
+                stop |= raise_event(RTL_EVENT_WRITE);
 
             if(minx->rootp->minx__DOT__cpu__DOT__alu_op_error == 1 && minx->pl == 0)
-                PRINTE(" ** Alu not implemented error, timestamp: %d** \n", timestamp);
+                stop |= raise_event(RTL_EVENT_ALU_OP);
 
-            if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_alu_dec_pack_ops_error == 1 && minx->pl == 0)
-                PRINTE(" ** Alu decimal and packed operations not implemented error, timestamp: %d** \n", timestamp);
+            if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_alu_pack_ops_error == 1 && minx->pl == 0)
+                stop |= raise_event(RTL_EVENT_ALU_PACK_OPS);
 
             if(minx->rootp->minx__DOT__cpu__DOT__not_implemented_divzero_error == 1 && minx->pl == 0)
-                PRINTE(" ** Division by zero exception not implemented error, timestamp: %d**\n", timestamp);
+                stop |= raise_event(RTL_EVENT_DIVZERO);
 
             if(minx->rootp->minx__DOT__cpu__DOT__SP > 0x2000 && minx->pl == 0)
-            {
-                PRINTE(" ** Stack overflow, timestamp: %d**\n", timestamp);
-                break;
-            }
+                stop |= raise_event(RTL_EVENT_STACK_OVERFLOW);
+
+            if(stop) break;
         }
 
         if(timestamp >= 8)
@@ -941,6 +1133,13 @@ int main(int argc, char** argv, char** env)
             //printf("IACK with IRQ=0x%x, timestamp: %d\n", minx->rootp->minx__DOT__irq__DOT__next_irq, timestamp);
         }
 
+        irq_stats_update(irq_stats, minx->rootp->minx__DOT__irqs, minx->rootp->minx__DOT__irq__DOT__reg_irq_active,
+            minx->iack, minx->rootp->minx__DOT__irq__DOT__next_irq_latch, timestamp / 2);
+
+        coverage_update(coverage, bus_access);
+        bus_stats_update(&bus_stats, bus_access);
+        if(heatmap) ram_heatmap_update(heatmap, bus_access);
+
         if(minx->bus_status == BUS_MEM_READ && minx->pl == 0) // Check if PL=0 just to reduce spam.
         {
             // memory read
@@ -953,7 +1152,6 @@ int main(int argc, char** argv, char** env)
                 //    printf("___ 0x%x\n", minx->rootp->address_out);
                 //}
                 // read from bios
-                bios_touched[minx->address_out & (bios_file_size - 1)] = 1;
                 minx->data_in = *(bios + (minx->address_out & (bios_file_size - 1)));
             }
             else if(minx->address_out < 0x2000)
@@ -973,11 +1171,8 @@ int main(int argc, char** argv, char** env)
             else
             {
                 // read from cartridge
-                //if(!cartridge_touched[(minx->address_out & 0x1FFFFF) & (cartridge_file_size - 1)])
-                //    printf("%d\n", timestamp);
-                cartridge_touched[(minx->address_out & 0x1FFFFF) & (cartridge_file_size - 1)] = 1;
                 //if((minx->rootp->minx__DOT__cpu__DOT__PC & 0x8000) && (minx->rootp->minx__DOT__cpu__DOT__CB > 0))
-                //    PRINTE("** CB not implemented 0x%x, 0x%x **\n", minx->address_out, minx->rootp->minx__DOT__cpu__DOT__CB);
+                //    LOG_ERROR("** CB not implemented 0x%x, 0x%x **\n", minx->address_out, minx->rootp->minx__DOT__cpu__DOT__CB);
                 minx->data_in = *(uint8_t*)(cartridge + (minx->address_out & 0x1FFFFF));
             }
 
@@ -988,7 +1183,7 @@ int main(int argc, char** argv, char** env)
             // memory write
             if(minx->address_out < 0x1000)
             {
-                PRINTD("Program trying to write to bios at 0x%x, timestamp: %d\n", minx->address_out, timestamp);
+                LOG_DEBUG("Program trying to write to bios at 0x%x, timestamp: %llu\n", minx->address_out, (unsigned long long)timestamp);
             }
             else if(minx->address_out < 0x2000)
             {
@@ -1007,12 +1202,14 @@ int main(int argc, char** argv, char** env)
             }
             else
             {
-                PRINTD("Program trying to write to cartridge at 0x%x, timestamp: %d\n", minx->address_out, timestamp);
+                LOG_DEBUG("Program trying to write to cartridge at 0x%x, timestamp: %llu\n", minx->address_out, (unsigned long long)timestamp);
             }
 
             data_sent = true;
         }
 
+        hw_registers_update(hw_registers, bus_access, timestamp, trace_physical_address(minx->rootp->minx__DOT__cpu__DOT__top_address, trace_state.cb));
+
         if(minx->sync && minx->pl == 1)
             num_cycles_since_sync = 0;
         if(minx->pl == 1 && !minx->rootp->minx__DOT__bus_ack)
@@ -1020,23 +1217,41 @@ int main(int argc, char** argv, char** env)
         //minx->eval();
     }
 
+    write_metrics();
+    frame_dump_close(frame_dumper);
     if(dump) tfp->close();
+    if(trace) trace_close(trace);
+    if(block_trace) block_trace_close(block_trace);
+    if(watch) watch_close(watch);
+    if(heatmap) ram_heatmap_close(heatmap);
+    video_record_close(video);
+    if(profile)
+    {
+        guest_profile_save_callgrind(profile, "callgrind.out.minx", "minx_sim");
+        guest_profile_free(profile);
+    }
     delete minx;
-
-    size_t total_touched = 0;
-    for(size_t i = 0; i < bios_file_size; ++i)
-        total_touched += bios_touched[i];
-    printf("%zu bytes out of total %zu read from bios.\n", total_touched, bios_file_size);
-
-    total_touched = 0;
-    for(size_t i = 0; i < cartridge_file_size; ++i)
-        total_touched += cartridge_touched[i];
-    printf("%zu bytes out of total %zu read from cartridge.\n", total_touched, cartridge_file_size);
-
-    total_touched = 0;
-    for(size_t i = 0; i < 0x300; ++i)
-        total_touched += instructions_executed[i];
-    printf("%zu instructions out of total 608 executed.\n", total_touched);
+    log_close();
+
+    coverage_print_summary(coverage);
+    coverage_save(coverage, "sim.coverage");
+
+    printf("%d instructions out of total 608 executed.\n", opcode_stats_num_executed(opcode_stats));
+    opcode_stats_save_csv(opcode_stats, "sim_opcodes.csv", instruction_cycles);
+    timing_report_print(timing_report, instruction_cycles);
+    prc_stats_close_csv(&prc_stats);
+    prc_stats_print_summary(&prc_stats);
+    bus_stats_close_csv(&bus_stats);
+    bus_stats_print_summary(&bus_stats);
+    cpu_load_print_summary(&cpu_load);
+    input_latency_close_csv(&input_latency);
+    input_latency_print_summary(&input_latency);
+    irq_stats_print_summary(irq_stats);
+    irq_stats_save_csv(irq_stats, "sim_irqs.csv");
+    hw_registers_print_summary(hw_registers);
+    hw_registers_free(hw_registers);
+    rtl_events_print_summary(&rtl_events);
+    if(check_call_stack) call_stack_print_summary(&call_stack);
 
     return 0;
 }
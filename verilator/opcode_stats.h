@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "instruction_table.h"
+
+// Execution counts and measured cycle distributions of each extended opcode,
+// written as CSV with the mnemonics of docs/instructions.csv:
+//
+//     opcode,mnemonic,count,percent,cycles,branch_cycles,mean_cycles,taken_ratio,distribution
+//
+// cycles and branch_cycles are the expected counts from instruction_cycles,
+// the larger one being the count of a taken branch. taken_ratio is the share
+// of executions that took exactly the taken count of cycles, and is empty for
+// opcodes with a single count. distribution lists <cycles>:<count> pairs of
+// the measured cycles separated by spaces. Rows are sorted by count.
+
+const int OPCODE_STATS_NUM_OPCODES = 0x300;
+// Measured cycle counts above this are counted in the last bucket.
+const int OPCODE_STATS_MAX_CYCLES = 31;
+
+struct OpcodeStats
+{
+    uint64_t counts[OPCODE_STATS_NUM_OPCODES];
+    uint64_t cycles[OPCODE_STATS_NUM_OPCODES][OPCODE_STATS_MAX_CYCLES + 1];
+};
+
+// Histogram of measured cycle counts, also used by timing_report.h.
+inline void opcode_stats_add_cycles(uint64_t histogram[OPCODE_STATS_MAX_CYCLES + 1], uint8_t num_cycles)
+{
+    ++histogram[std::min<int>(num_cycles, OPCODE_STATS_MAX_CYCLES)];
+}
+
+inline void opcode_stats_add(OpcodeStats* stats, uint16_t extended_opcode, uint8_t num_cycles)
+{
+    ++stats->counts[extended_opcode];
+    opcode_stats_add_cycles(stats->cycles[extended_opcode], num_cycles);
+}
+
+inline int opcode_stats_num_executed(const OpcodeStats* stats)
+{
+    int num_executed = 0;
+    for(int i = 0; i < OPCODE_STATS_NUM_OPCODES; ++i)
+        num_executed += (stats->counts[i] > 0);
+    return num_executed;
+}
+
+namespace
+{
+    // Formats an extended opcode the way docs/instructions.csv does.
+    void opcode_stats_format_opcode(char* out, int extended_opcode)
+    {
+        if(extended_opcode >= 0x200)
+            sprintf(out, "CF %02X", extended_opcode - 0x200);
+        else if(extended_opcode >= 0x100)
+            sprintf(out, "CE %02X", extended_opcode - 0x100);
+        else
+            sprintf(out, "%02X", extended_opcode);
+    }
+
+    // Prints the nonzero buckets of a cycle histogram as <cycles>:<count>
+    // pairs separated by spaces.
+    void opcode_stats_print_cycles(FILE* fp, const uint64_t histogram[OPCODE_STATS_MAX_CYCLES + 1])
+    {
+        const char* separator = "";
+        for(int c = 0; c <= OPCODE_STATS_MAX_CYCLES; ++c)
+        {
+            if(histogram[c] == 0) continue;
+            fprintf(fp, "%s%d:%llu", separator, c, (unsigned long long)histogram[c]);
+            separator = " ";
+        }
+    }
+
+    // cycles_table is instruction_cycles, two expected counts per opcode.
+    bool opcode_stats_save_csv(const OpcodeStats* stats, const char* filepath, const uint8_t* cycles_table)
+    {
+        FILE* fp = fopen(filepath, "w");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening opcode statistics file %s.\n", filepath);
+            return false;
+        }
+
+        int order[OPCODE_STATS_NUM_OPCODES];
+        uint64_t total = 0;
+        for(int i = 0; i < OPCODE_STATS_NUM_OPCODES; ++i)
+        {
+            order[i] = i;
+            total += stats->counts[i];
+        }
+        std::stable_sort(order, order + OPCODE_STATS_NUM_OPCODES, [stats](int a, int b)
+        {
+            return stats->counts[a] > stats->counts[b];
+        });
+
+        fprintf(fp, "opcode,mnemonic,count,percent,cycles,branch_cycles,mean_cycles,taken_ratio,distribution\n");
+        for(int i = 0; i < OPCODE_STATS_NUM_OPCODES; ++i)
+        {
+            int op = order[i];
+            uint64_t count = stats->counts[op];
+            if(count == 0) break;
+
+            const uint64_t* cycles = stats->cycles[op];
+            uint64_t total_cycles = 0;
+            for(int c = 0; c <= OPCODE_STATS_MAX_CYCLES; ++c)
+                total_cycles += c * cycles[c];
+
+            char opcode[8];
+            opcode_stats_format_opcode(opcode, op);
+            const char* mnemonic = instruction_table[op].mnemonic;
+            fprintf(fp, "%s,\"%s\",%llu,%.4f,%d,%d,%.3f,",
+                opcode, mnemonic? mnemonic: "?", (unsigned long long)count, 100.0 * count / total,
+                cycles_table[2*op], cycles_table[2*op+1], (double)total_cycles / count
+            );
+
+            uint8_t taken     = std::max(cycles_table[2*op], cycles_table[2*op+1]);
+            uint8_t not_taken = std::min(cycles_table[2*op], cycles_table[2*op+1]);
+            if(not_taken > 0 && cycles[taken] + cycles[not_taken] > 0)
+                fprintf(fp, "%.4f", (double)cycles[taken] / (cycles[taken] + cycles[not_taken]));
+            fprintf(fp, ",");
+
+            opcode_stats_print_cycles(fp, cycles);
+            fprintf(fp, "\n");
+        }
+
+        fclose(fp);
+        return true;
+    }
+}
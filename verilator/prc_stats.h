@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "bus_access.h"
+
+// Per-frame timing of the PRC render pipeline of prc.sv and of the CPU time
+// it takes: the cycles spent in each PRC_STATE_*, the cycles the PRC requested
+// and owned the bus (bus_request, bus_ack), the latter being cycles the CPU is
+// stalled, the number of sprites drawn and of tile map entries fetched, and
+// the PRC_MODE and PRC_RATE in effect. A frame ends at frame_complete, also
+// for frames the rate divider skips.
+//
+// The counters of the current frame are in PrcStats::frame and those of the
+// last complete frame in PrcStats::last_frame. If a CSV file is open, a row is
+// appended for every frame:
+//
+//     frame,timestamp,cycles,rendered,mode,rate_divider,idle_cycles,map_draw_cycles,
+//     sprite_draw_cycles,frame_copy_cycles,bus_request_cycles,cpu_stall_cycles,
+//     cpu_stall_percent,sprites_drawn,map_tiles_fetched
+//
+// A sprite is counted as drawn when the PRC reads its attributes with the
+// enabled bit set, a tile map entry when the PRC reads it from 0x1360-0x14DF.
+
+enum
+{
+    PRC_STATE_IDLE,
+    PRC_STATE_MAP_DRAW,
+    PRC_STATE_SPR_DRAW,
+    PRC_STATE_FRAME_COPY,
+    PRC_NUM_STATES
+};
+
+// Frame rate divider of PRC_RATE bits 1-3, rate_match of prc.sv plus one.
+const uint8_t prc_rate_dividers[8] = {3, 6, 9, 12, 2, 4, 6, 8};
+
+struct PrcFrameStats
+{
+    uint32_t frame;
+    uint64_t timestamp; // At the end of the frame.
+    uint64_t cycles;
+    bool rendered;      // irq_render_done fired.
+    uint8_t mode;
+    uint8_t rate;
+
+    uint64_t state_cycles[PRC_NUM_STATES];
+    uint64_t bus_request_cycles;
+    uint64_t cpu_stall_cycles;
+    uint32_t sprites_drawn;
+    uint32_t map_tiles_fetched;
+};
+
+struct PrcStats
+{
+    PrcFrameStats frame;
+    PrcFrameStats last_frame;
+    uint32_t num_frames_rendered;
+    uint64_t total_cycles;
+    uint64_t total_cpu_stall_cycles;
+    const uint8_t* memory; // The 4 KB RAM, to tell enabled sprites.
+    FILE* csv_fp;
+};
+
+// Call every clock cycle with its bus access, before prc_stats_end_frame.
+inline void prc_stats_update(PrcStats* stats, uint8_t state, bool bus_request, bool bus_ack, bool render_done, const BusAccess& bus_access)
+{
+    PrcFrameStats& frame = stats->frame;
+    ++frame.cycles;
+    frame.rendered = frame.rendered || render_done;
+    ++frame.state_cycles[state & (PRC_NUM_STATES - 1)];
+    frame.bus_request_cycles += bus_request;
+    frame.cpu_stall_cycles   += bus_ack;
+
+    if(!bus_access.is_new || bus_access.master != BUS_ACCESS_PRC || bus_access.type != BUS_ACCESS_READ)
+        return;
+
+    uint32_t address = bus_access.address;
+    if(address >= 0x1360 && address < 0x14E0)
+        ++frame.map_tiles_fetched;
+    else if(address >= 0x1300 && address < 0x1360 && (address & 3) == 3 && (stats->memory[address & 0xFFF] & 0x08))
+        ++frame.sprites_drawn;
+}
+
+namespace
+{
+    void prc_stats_init(PrcStats* stats, const uint8_t* memory)
+    {
+        memset(stats, 0, sizeof(PrcStats));
+        stats->memory = memory;
+    }
+
+    bool prc_stats_open_csv(PrcStats* stats, const char* filepath)
+    {
+        if(stats->csv_fp) fclose(stats->csv_fp);
+        stats->csv_fp = fopen(filepath, "w");
+        if(!stats->csv_fp)
+        {
+            fprintf(stderr, "Error opening PRC statistics file %s.\n", filepath);
+            return false;
+        }
+        fprintf(stats->csv_fp,
+            "frame,timestamp,cycles,rendered,mode,rate_divider,idle_cycles,map_draw_cycles,"
+            "sprite_draw_cycles,frame_copy_cycles,bus_request_cycles,cpu_stall_cycles,"
+            "cpu_stall_percent,sprites_drawn,map_tiles_fetched\n"
+        );
+        return true;
+    }
+
+    void prc_stats_close_csv(PrcStats* stats)
+    {
+        if(!stats->csv_fp) return;
+        fclose(stats->csv_fp);
+        stats->csv_fp = nullptr;
+    }
+
+    // Call at frame_complete with PRC_MODE and PRC_RATE.
+    void prc_stats_end_frame(PrcStats* stats, uint64_t timestamp, uint8_t mode, uint8_t rate)
+    {
+        PrcFrameStats& frame = stats->frame;
+        frame.timestamp = timestamp;
+        frame.mode      = mode;
+        frame.rate      = rate;
+
+        if(stats->csv_fp)
+        {
+            fprintf(stats->csv_fp, "%u,%llu,%llu,%d,0x%02X,%d,%llu,%llu,%llu,%llu,%llu,%llu,%.2f,%u,%u\n",
+                frame.frame, (unsigned long long)frame.timestamp, (unsigned long long)frame.cycles, frame.rendered,
+                frame.mode, prc_rate_dividers[(frame.rate >> 1) & 7],
+                (unsigned long long)frame.state_cycles[PRC_STATE_IDLE], (unsigned long long)frame.state_cycles[PRC_STATE_MAP_DRAW],
+                (unsigned long long)frame.state_cycles[PRC_STATE_SPR_DRAW], (unsigned long long)frame.state_cycles[PRC_STATE_FRAME_COPY],
+                (unsigned long long)frame.bus_request_cycles, (unsigned long long)frame.cpu_stall_cycles,
+                frame.cycles? 100.0 * frame.cpu_stall_cycles / frame.cycles: 0.0,
+                frame.sprites_drawn, frame.map_tiles_fetched
+            );
+        }
+
+        stats->num_frames_rendered    += frame.rendered;
+        stats->total_cycles           += frame.cycles;
+        stats->total_cpu_stall_cycles += frame.cpu_stall_cycles;
+        stats->last_frame = frame;
+        uint32_t next_frame = frame.frame + 1;
+        memset(&frame, 0, sizeof(PrcFrameStats));
+        frame.frame = next_frame;
+    }
+
+    void prc_stats_print_summary(const PrcStats* stats)
+    {
+        printf("%u PRC frames, %u rendered, CPU stalled by the PRC for %.2f%% of the cycles.\n",
+            stats->frame.frame, stats->num_frames_rendered,
+            stats->total_cycles? 100.0 * stats->total_cpu_stall_cycles / stats->total_cycles: 0.0
+        );
+    }
+}
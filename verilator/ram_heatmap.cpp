@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "ram_heatmap.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// Prints a RAM heatmap stream (see ram_heatmap.h) as the number of accesses
+// to each RAM region per frame, tab separated, or writes it as PNG images.
+//
+// Usage: ram_heatmap [-png <prefix>] [-sum] [-frames <first>:<last>] <heatmap>
+//     -png     writes <prefix>_<frame>.png for every frame instead.
+//     -sum     adds up the selected frames into a single <prefix>.png, or a
+//              single line.
+//     -frames  only reads the given range of frames, inclusive.
+//
+// An image has a panel for each of the CPU reads, CPU writes, PRC reads and
+// PRC writes, left to right. A panel has a 4x4 cell for each byte with 64
+// bytes per row, so the framebuffer is the top 12 rows. Colors go from black
+// through red and yellow to white on a log scale of the count, white being
+// the highest count in the image.
+
+namespace
+{
+    const int CELL_SIZE   = 4;
+    const int PANEL_SIZE  = 64 * CELL_SIZE;
+    const int PANEL_GAP   = 8;
+    const int IMAGE_WIDTH = RAM_HEATMAP_NUM_PLANES * PANEL_SIZE + (RAM_HEATMAP_NUM_PLANES - 1) * PANEL_GAP;
+
+    void heat_color(float t, uint8_t* rgb)
+    {
+        float r = std::min(1.0f, 3.0f * t);
+        float g = std::min(1.0f, std::max(0.0f, 3.0f * t - 1.0f));
+        float b = std::max(0.0f, 3.0f * t - 2.0f);
+        rgb[0] = (uint8_t)(255.0f * r);
+        rgb[1] = (uint8_t)(255.0f * g);
+        rgb[2] = (uint8_t)(255.0f * b);
+    }
+
+    bool save_png(const char* filepath, const std::vector<uint64_t>& counts)
+    {
+        uint64_t max_count = 0;
+        for(uint64_t count: counts)
+            max_count = std::max(max_count, count);
+        float scale = (max_count > 0)? 1.0f / logf(1.0f + max_count): 0.0f;
+
+        std::vector<uint8_t> image(IMAGE_WIDTH * PANEL_SIZE * 3, 0x40);
+        for(int plane = 0; plane < RAM_HEATMAP_NUM_PLANES; ++plane)
+        {
+            for(uint32_t offset = 0; offset < RAM_HEATMAP_SIZE; ++offset)
+            {
+                uint8_t rgb[3];
+                heat_color(logf(1.0f + counts[plane * RAM_HEATMAP_SIZE + offset]) * scale, rgb);
+
+                int x0 = plane * (PANEL_SIZE + PANEL_GAP) + (offset & 63) * CELL_SIZE;
+                int y0 = (offset >> 6) * CELL_SIZE;
+                for(int y = y0; y < y0 + CELL_SIZE; ++y)
+                    for(int x = x0; x < x0 + CELL_SIZE; ++x)
+                        memcpy(&image[3 * (y * IMAGE_WIDTH + x)], rgb, 3);
+            }
+        }
+
+        if(!stbi_write_png(filepath, IMAGE_WIDTH, PANEL_SIZE, 3, image.data(), IMAGE_WIDTH * 3))
+        {
+            fprintf(stderr, "Error saving image %s.\n", filepath);
+            return false;
+        }
+        return true;
+    }
+
+    void print_header()
+    {
+        printf("frame\ttimestamp");
+        for(int region = 0; region < RAM_HEATMAP_NUM_REGIONS; ++region)
+            for(int plane = 0; plane < RAM_HEATMAP_NUM_PLANES; ++plane)
+                printf("\t%s %s", ram_heatmap_regions[region].name, ram_heatmap_plane_names[plane]);
+        printf("\n");
+    }
+
+    void print_frame(const char* frame, uint64_t timestamp, const std::vector<uint64_t>& counts)
+    {
+        printf("%s\t%llu", frame, (unsigned long long)timestamp);
+        for(int region = 0; region < RAM_HEATMAP_NUM_REGIONS; ++region)
+        {
+            const RamHeatmapRegion& r = ram_heatmap_regions[region];
+            for(int plane = 0; plane < RAM_HEATMAP_NUM_PLANES; ++plane)
+            {
+                uint64_t total = 0;
+                for(uint32_t address = r.start; address < r.end; ++address)
+                    total += counts[plane * RAM_HEATMAP_SIZE + (address & 0xFFF)];
+                printf("\t%llu", (unsigned long long)total);
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* png_prefix = nullptr;
+    const char* filepath = nullptr;
+    bool sum = false;
+    uint32_t first_frame = 0;
+    uint32_t last_frame = UINT32_MAX;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-png") == 0 && i + 1 < argc)
+            png_prefix = argv[++i];
+        else if(strcmp(argv[i], "-sum") == 0)
+            sum = true;
+        else if(strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+        {
+            if(sscanf(argv[++i], "%u:%u", &first_frame, &last_frame) != 2)
+            {
+                fprintf(stderr, "Error: Expected -frames <first>:<last>, got %s.\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+            filepath = argv[i];
+    }
+
+    if(!filepath)
+    {
+        fprintf(stderr, "Usage: %s [-png <prefix>] [-sum] [-frames <first>:<last>] <heatmap>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* fp = fopen(filepath, "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "Error opening %s.\n", filepath);
+        return 1;
+    }
+
+    RamHeatmapHeader header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != RAM_HEATMAP_MAGIC ||
+       header.version != RAM_HEATMAP_VERSION || header.ram_size != RAM_HEATMAP_SIZE)
+    {
+        fprintf(stderr, "%s is not a RAM heatmap.\n", filepath);
+        return 1;
+    }
+
+    if(!png_prefix) print_header();
+
+    std::vector<uint64_t> counts(RAM_HEATMAP_NUM_PLANES * RAM_HEATMAP_SIZE, 0);
+    std::vector<RamHeatmapEntry> entries;
+    uint32_t num_frames = 0;
+    uint64_t last_timestamp = 0;
+    RamHeatmapFrame frame;
+    while(fread(&frame, sizeof(frame), 1, fp) == 1 && frame.frame <= last_frame)
+    {
+        entries.resize(frame.num_entries);
+        if(fread(entries.data(), sizeof(RamHeatmapEntry), frame.num_entries, fp) != frame.num_entries)
+        {
+            fprintf(stderr, "Error: Truncated frame %u.\n", frame.frame);
+            break;
+        }
+        if(frame.frame < first_frame) continue;
+
+        if(!sum) std::fill(counts.begin(), counts.end(), 0);
+        for(const RamHeatmapEntry& entry: entries)
+            counts[(entry.offset >> 12) * RAM_HEATMAP_SIZE + (entry.offset & 0xFFF)] += entry.count;
+        ++num_frames;
+        last_timestamp = frame.timestamp;
+        if(sum) continue;
+
+        if(png_prefix)
+        {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s_%06u.png", png_prefix, frame.frame);
+            if(!save_png(path, counts)) return 1;
+        }
+        else
+        {
+            char index[16];
+            snprintf(index, sizeof(index), "%u", frame.frame);
+            print_frame(index, frame.timestamp, counts);
+        }
+    }
+    fclose(fp);
+
+    if(sum && num_frames > 0)
+    {
+        if(png_prefix)
+        {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s.png", png_prefix);
+            if(!save_png(path, counts)) return 1;
+        }
+        else
+            print_frame("sum", last_timestamp, counts);
+    }
+    if(png_prefix) printf("%u frames written.\n", num_frames);
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "bus_access.h"
+
+// Per-frame access counts of every byte of the 4 KB RAM (0x1000-0x1FFF),
+// separately for reads and writes of the CPU and of the PRC, which is the bus
+// master while bus_ack is set. An access is one increment of its counter;
+// counters are written out and cleared at the end of each frame. Convert a
+// heatmap stream to PNG images or a per-region summary with tools/ram_heatmap.
+//
+// The stream starts with a RamHeatmapHeader, followed for every frame by a
+// RamHeatmapFrame and its num_entries RamHeatmapEntries, one for each byte
+// and plane with a nonzero count. Counts saturate at 65535 per frame.
+
+#define RAM_HEATMAP_MAGIC   0x4D484D50 // 'PMHM'
+#define RAM_HEATMAP_VERSION 1
+
+// A plane is master * BUS_ACCESS_NUM_TYPES + access.
+const int RAM_HEATMAP_NUM_PLANES = BUS_ACCESS_NUM_MASTERS * BUS_ACCESS_NUM_TYPES;
+const uint32_t RAM_HEATMAP_SIZE = 0x1000;
+
+const char* const ram_heatmap_plane_names[RAM_HEATMAP_NUM_PLANES] = {
+    "cpu read", "cpu write", "prc read", "prc write"
+};
+
+// RAM areas used by the PRC, the rest is free for the game.
+struct RamHeatmapRegion
+{
+    const char* name;
+    uint16_t start;
+    uint16_t end; // Exclusive.
+};
+
+const int RAM_HEATMAP_NUM_REGIONS = 4;
+const RamHeatmapRegion ram_heatmap_regions[RAM_HEATMAP_NUM_REGIONS] = {
+    {"framebuffer", 0x1000, 0x1300},
+    {"sprites",     0x1300, 0x1360},
+    {"map",         0x1360, 0x14E0},
+    {"other",       0x14E0, 0x2000},
+};
+
+struct RamHeatmapHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ram_address;
+    uint32_t ram_size;
+};
+
+struct RamHeatmapFrame
+{
+    uint64_t timestamp; // At the end of the frame.
+    uint32_t frame;
+    uint32_t num_entries;
+};
+
+struct RamHeatmapEntry
+{
+    uint16_t offset; // Offset into the RAM in the low 12 bits, plane in the top 4.
+    uint16_t count;
+};
+
+namespace
+{
+    struct RamHeatmap
+    {
+        FILE* fp;
+        uint32_t counts[RAM_HEATMAP_NUM_PLANES][RAM_HEATMAP_SIZE];
+        RamHeatmapEntry entries[RAM_HEATMAP_NUM_PLANES * RAM_HEATMAP_SIZE];
+        uint32_t num_frames;
+    };
+
+    RamHeatmap* ram_heatmap_open(const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening heatmap file %s.\n", filepath);
+            return nullptr;
+        }
+
+        RamHeatmapHeader header = {RAM_HEATMAP_MAGIC, RAM_HEATMAP_VERSION, 0x1000, RAM_HEATMAP_SIZE};
+        fwrite(&header, sizeof(header), 1, fp);
+
+        RamHeatmap* heatmap = new RamHeatmap;
+        memset(heatmap->counts, 0, sizeof(heatmap->counts));
+        heatmap->fp         = fp;
+        heatmap->num_frames = 0;
+        return heatmap;
+    }
+
+    // Records the bus access of the current simulation step.
+    inline void ram_heatmap_update(RamHeatmap* heatmap, const BusAccess& bus_access)
+    {
+        if(!bus_access.is_new || bus_access.region != BUS_ACCESS_RAM) return;
+        int plane = bus_access.master * BUS_ACCESS_NUM_TYPES + bus_access.type;
+        ++heatmap->counts[plane][bus_access.address & 0xFFF];
+    }
+
+    // Writes out the counts of the frame that just ended and clears them.
+    void ram_heatmap_end_frame(RamHeatmap* heatmap, uint64_t timestamp)
+    {
+        uint32_t num_entries = 0;
+        for(int plane = 0; plane < RAM_HEATMAP_NUM_PLANES; ++plane)
+        {
+            const uint32_t* counts = heatmap->counts[plane];
+            for(uint32_t offset = 0; offset < RAM_HEATMAP_SIZE; ++offset)
+            {
+                if(counts[offset] == 0) continue;
+                RamHeatmapEntry& entry = heatmap->entries[num_entries++];
+                entry.offset = (uint16_t)((plane << 12) | offset);
+                entry.count  = (counts[offset] > 0xFFFF)? 0xFFFF: (uint16_t)counts[offset];
+            }
+        }
+
+        RamHeatmapFrame frame = {timestamp, heatmap->num_frames++, num_entries};
+        fwrite(&frame, sizeof(frame), 1, heatmap->fp);
+        fwrite(heatmap->entries, sizeof(RamHeatmapEntry), num_entries, heatmap->fp);
+        memset(heatmap->counts, 0, sizeof(heatmap->counts));
+    }
+
+    // The counts of an unfinished frame are dropped.
+    void ram_heatmap_close(RamHeatmap* heatmap)
+    {
+        fclose(heatmap->fp);
+        delete heatmap;
+    }
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "trace.h"
+#include "log.h"
+#include "call_stack.h"
+
+// Error conditions flagged by the RTL, e.g. the CPU's not_implemented_*_error
+// signals, or found by the harness' checks of it such as the shadow call stack
+// of call_stack.h, raised as typed events. Each event type has an action, each
+// one including the ones before it:
+//
+//     ignore    the event is not even counted.
+//     count     the event is counted, the first occurrence is logged as an
+//               error and later ones at the debug level.
+//     snapshot  the CPU registers and RAM are also written to
+//               sim_<event>.snapshot at the first occurrence.
+//     stop      the simulation is also stopped, on every occurrence.
+//
+// The actions can be set with a list such as "all=stop,divzero=count" in the
+// MINX_RTL_EVENTS environment variable or rtl_events_configure(). A callback
+// is called on every event that is not ignored, and can stop the simulation
+// as well.
+
+enum
+{
+    RTL_EVENT_INSTRUCTION,
+    RTL_EVENT_ADDRESSING,
+    RTL_EVENT_JUMP,
+    RTL_EVENT_DATA_OUT,
+    RTL_EVENT_MOV_SRC,
+    RTL_EVENT_WRITE,
+    RTL_EVENT_ALU_OP,
+    RTL_EVENT_ALU_PACK_OPS,
+    RTL_EVENT_DIVZERO,
+    RTL_EVENT_STACK_OVERFLOW,
+    RTL_EVENT_RETURN_ADDRESS,
+    RTL_EVENT_STACK_IMBALANCE,
+    RTL_EVENT_UNMATCHED_RETURN,
+    RTL_NUM_EVENTS
+};
+
+enum
+{
+    RTL_ACTION_IGNORE,
+    RTL_ACTION_COUNT,
+    RTL_ACTION_SNAPSHOT,
+    RTL_ACTION_STOP,
+    RTL_NUM_ACTIONS
+};
+
+const char* const rtl_event_names[RTL_NUM_EVENTS] = {
+    "instruction", "addressing", "jump", "data_out", "mov_src",
+    "write", "alu_op", "alu_pack_ops", "divzero", "stack_overflow",
+    "return_address", "stack_imbalance", "unmatched_return"
+};
+
+const char* const rtl_event_descriptions[RTL_NUM_EVENTS] = {
+    "Instruction not implemented",
+    "Addressing not implemented",
+    "Jump not implemented",
+    "Data-out not implemented",
+    "Mov src not implemented",
+    "Write not implemented",
+    "Alu not implemented",
+    "Alu decimal and packed operations not implemented",
+    "Division by zero exception not implemented",
+    "Stack overflow",
+    "Return to an unexpected address",
+    "Stack imbalance",
+    "Return without a matching call or interrupt"
+};
+
+// Event of each failed check of call_stack_retire.
+const int rtl_call_stack_events[CALL_STACK_NUM_RESULTS] = {
+    RTL_NUM_EVENTS,
+    RTL_EVENT_RETURN_ADDRESS,
+    RTL_EVENT_STACK_IMBALANCE,
+    RTL_EVENT_UNMATCHED_RETURN,
+    RTL_EVENT_STACK_IMBALANCE
+};
+
+const char* const rtl_action_names[RTL_NUM_ACTIONS] = {"ignore", "count", "snapshot", "stop"};
+
+struct RtlEvent
+{
+    int type;
+    uint64_t timestamp;
+    uint32_t address; // Physical address of the instruction.
+    uint32_t detail;  // E.g. the opcode, addressing mode or expected value.
+};
+
+// Returns true to stop the simulation.
+typedef bool (*RtlEventCallback)(const RtlEvent* event, void* user_data);
+
+struct RtlEvents
+{
+    uint8_t actions[RTL_NUM_EVENTS];
+    uint64_t counts[RTL_NUM_EVENTS];
+    RtlEvent first[RTL_NUM_EVENTS];
+
+    RtlEventCallback callback;
+    void* user_data;
+
+    const uint8_t* memory; // The 4 KB RAM, for snapshots.
+    bool stopped;
+};
+
+namespace
+{
+    // Parses a list of <event>=<action> separated by commas, <event> being
+    // an event name or "all".
+    bool rtl_events_configure(RtlEvents* events, const char* actions)
+    {
+        bool ok = true;
+        while(*actions)
+        {
+            const char* end = strchr(actions, ',');
+            if(!end) end = actions + strlen(actions);
+
+            char entry[64] = {};
+            strncpy(entry, actions, std::min<size_t>(end - actions, sizeof(entry) - 1));
+            actions = *end? end + 1: end;
+
+            char* action_name = strchr(entry, '=');
+            int action = RTL_NUM_ACTIONS;
+            if(action_name)
+            {
+                *action_name++ = '\0';
+                for(int i = 0; i < RTL_NUM_ACTIONS; ++i)
+                    if(strcmp(action_name, rtl_action_names[i]) == 0)
+                        action = i;
+            }
+            if(action == RTL_NUM_ACTIONS)
+            {
+                fprintf(stderr, "Error: Expected <event>=ignore|count|snapshot|stop, got %s.\n", entry);
+                ok = false;
+                continue;
+            }
+
+            bool found = false;
+            for(int i = 0; i < RTL_NUM_EVENTS; ++i)
+            {
+                if(strcmp(entry, "all") == 0 || strcmp(entry, rtl_event_names[i]) == 0)
+                {
+                    events->actions[i] = action;
+                    found = true;
+                }
+            }
+            if(!found)
+            {
+                fprintf(stderr, "Error: Unknown RTL event %s.\n", entry);
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    // By default all events are counted and a stack overflow stops the
+    // simulation, then MINX_RTL_EVENTS is applied.
+    void rtl_events_init(RtlEvents* events, const uint8_t* memory)
+    {
+        memset(events, 0, sizeof(RtlEvents));
+        for(int i = 0; i < RTL_NUM_EVENTS; ++i)
+            events->actions[i] = RTL_ACTION_COUNT;
+        events->actions[RTL_EVENT_STACK_OVERFLOW] = RTL_ACTION_STOP;
+        events->memory = memory;
+
+        if(const char* actions = getenv("MINX_RTL_EVENTS"))
+            rtl_events_configure(events, actions);
+    }
+
+    void rtl_events_set_callback(RtlEvents* events, RtlEventCallback callback, void* user_data)
+    {
+        events->callback  = callback;
+        events->user_data = user_data;
+    }
+
+    // state holds the registers at the start of the current instruction.
+    void rtl_events_save_snapshot(const RtlEvents* events, const RtlEvent* event, const TraceRecord& state)
+    {
+        char filepath[64];
+        snprintf(filepath, sizeof(filepath), "sim_%s.snapshot", rtl_event_names[event->type]);
+        FILE* fp = fopen(filepath, "w");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening snapshot file %s.\n", filepath);
+            return;
+        }
+
+        fprintf(fp, "%s (0x%x) at 0x%06x, timestamp: %llu\n\n",
+            rtl_event_descriptions[event->type], event->detail, event->address, (unsigned long long)event->timestamp
+        );
+        fprintf(fp, "PC=%04X BA=%04X HL=%04X IX=%04X IY=%04X SP=%04X\n", state.pc, state.ba, state.hl, state.ix, state.iy, state.sp);
+        fprintf(fp, "SC=%02X CB=%02X NB=%02X EP=%02X XP=%02X YP=%02X BR=%02X\n\n", state.sc, state.cb, state.nb, state.ep, state.xp, state.yp, state.br);
+
+        for(int i = 0; i < 0x1000; i += 16)
+        {
+            fprintf(fp, "%04X:", 0x1000 + i);
+            for(int j = 0; j < 16; ++j)
+                fprintf(fp, " %02X", events->memory[i + j]);
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+        LOG_ERROR("Snapshot written to %s.\n", filepath);
+    }
+
+    // Raises an event of the given type, returns true if the simulation
+    // should stop.
+    bool rtl_event_raise(RtlEvents* events, int type, uint32_t detail, const TraceRecord& state)
+    {
+        int action = events->actions[type];
+        if(action == RTL_ACTION_IGNORE) return false;
+
+        RtlEvent event = {type, state.timestamp, trace_physical_address(state.pc, state.cb), detail};
+        bool stop = (action == RTL_ACTION_STOP);
+        if(events->counts[type]++ == 0)
+        {
+            events->first[type] = event;
+            LOG_ERROR(" ** %s (0x%x) at 0x%06x, timestamp: %llu** \n",
+                rtl_event_descriptions[type], detail, event.address, (unsigned long long)event.timestamp
+            );
+            if(action >= RTL_ACTION_SNAPSHOT)
+                rtl_events_save_snapshot(events, &event, state);
+        }
+        else
+        {
+            LOG_DEBUG(" ** %s (0x%x) at 0x%06x, timestamp: %llu** \n",
+                rtl_event_descriptions[type], detail, event.address, (unsigned long long)event.timestamp
+            );
+        }
+
+        if(events->callback && events->callback(&event, events->user_data))
+            stop = true;
+        events->stopped = events->stopped || stop;
+        return stop;
+    }
+
+    void rtl_events_print_summary(const RtlEvents* events)
+    {
+        for(int i = 0; i < RTL_NUM_EVENTS; ++i)
+        {
+            if(events->counts[i] == 0) continue;
+            const RtlEvent& first = events->first[i];
+            printf("%s: %llu times, first at 0x%06x (0x%x), timestamp: %llu.\n",
+                rtl_event_descriptions[i], (unsigned long long)events->counts[i],
+                first.address, first.detail, (unsigned long long)first.timestamp
+            );
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// Access to simulation signals by hierarchical name. Names follow the VCD
+// hierarchy without the TOP scope, e.g. "minx.cpu.BA" for the Verilated member
+// minx__DOT__cpu__DOT__BA, and elements of unpacked arrays are selected with
+// an index, e.g. "minx.lcd.lcd_data[10]". Names are meant to be resolved once,
+// after which the returned pointer is read directly.
+//
+// The table of all signals of a model, e.g. minx_signals() in minx_signals.h,
+// is generated by scripts/make_signal_registry.py when building.
+
+struct SignalInfo
+{
+    const char* name;
+    void* data;
+    uint32_t width; // Bits per element.
+    uint32_t size;  // Bytes per element.
+    uint32_t count; // Number of elements of an unpacked array, 1 otherwise.
+};
+
+// A single resolved signal or array element.
+struct SignalRef
+{
+    const char* name;
+    void* data;
+    uint32_t width;
+    uint32_t size;
+};
+
+inline bool signal_resolve(const SignalInfo* signals, size_t num_signals, const char* name, SignalRef* ref)
+{
+    const char* bracket = strchr(name, '[');
+    size_t name_length = bracket? (size_t)(bracket - name): strlen(name);
+    uint32_t element = bracket? strtoul(bracket + 1, nullptr, 0): 0;
+
+    for(size_t i = 0; i < num_signals; ++i)
+    {
+        const SignalInfo& signal = signals[i];
+        if(strncmp(signal.name, name, name_length) != 0 || signal.name[name_length] != '\0')
+            continue;
+
+        if(!bracket && signal.count > 1)
+        {
+            fprintf(stderr, "Signal %s is an array, select an element with %s[index].\n", name, name);
+            return false;
+        }
+        if(element >= signal.count)
+        {
+            fprintf(stderr, "Signal %s is an array of %u elements, %s is out of range.\n", signal.name, signal.count, name);
+            return false;
+        }
+
+        ref->name  = signal.name;
+        ref->data  = (uint8_t*)signal.data + element * signal.size;
+        ref->width = signal.width;
+        ref->size  = signal.size;
+        return true;
+    }
+
+    fprintf(stderr, "Unknown signal %s.\n", name);
+    return false;
+}
+
+// Reads signals of up to 64 bits.
+inline uint64_t signal_read(const SignalRef& ref)
+{
+    switch(ref.size)
+    {
+        case 1: return *(const uint8_t*)ref.data;
+        case 2: return *(const uint16_t*)ref.data;
+        case 4: return *(const uint32_t*)ref.data;
+        default: return *(const uint64_t*)ref.data;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "instruction_table.h"
+#include "opcode_stats.h"
+#include "log.h"
+
+// Instructions whose measured cycle count matches neither of the expected
+// counts in instruction_cycles, aggregated per extended opcode. Only the first
+// discrepancy of each opcode is printed as it happens; the rest are counted
+// and listed by timing_report_print. The observed cycles are a histogram of
+// opcode_stats.h.
+
+const int TIMING_REPORT_NUM_OPCODES = 0x300;
+
+struct TimingDiscrepancy
+{
+    uint64_t count;
+    uint64_t first_timestamp;
+    uint32_t first_address;
+    uint64_t observed[OPCODE_STATS_MAX_CYCLES + 1];
+};
+
+struct TimingReport
+{
+    uint64_t num_instructions;
+    uint64_t num_discrepancies;
+    TimingDiscrepancy opcodes[TIMING_REPORT_NUM_OPCODES];
+};
+
+// Checks the measured cycles of a retired instruction against the expected
+// ones, cycles_table being instruction_cycles and address the physical address
+// of the instruction. Returns false on a mismatch.
+inline bool timing_report_check(TimingReport* report, const uint8_t* cycles_table, uint16_t extended_opcode, uint8_t num_cycles, uint32_t address, uint64_t timestamp)
+{
+    ++report->num_instructions;
+
+    uint8_t expected        = cycles_table[2*extended_opcode];
+    uint8_t expected_branch = cycles_table[2*extended_opcode+1];
+    if(num_cycles == expected || (num_cycles == expected_branch && expected_branch != 0))
+        return true;
+
+    ++report->num_discrepancies;
+    TimingDiscrepancy& discrepancy = report->opcodes[extended_opcode];
+    if(discrepancy.count++ == 0)
+    {
+        discrepancy.first_timestamp = timestamp;
+        discrepancy.first_address   = address;
+        LOG_ERROR(" ** Discrepancy found in number of cycles of instruction 0x%x at 0x%06x: %d, %d, timestamp: %llu** \n",
+            extended_opcode, address, num_cycles, expected, (unsigned long long)timestamp
+        );
+    }
+    opcode_stats_add_cycles(discrepancy.observed, num_cycles);
+    return false;
+}
+
+namespace
+{
+    void timing_report_print(const TimingReport* report, const uint8_t* cycles_table, FILE* fp = stdout)
+    {
+        fprintf(fp, "%llu cycle discrepancies in %llu instructions.\n",
+            (unsigned long long)report->num_discrepancies, (unsigned long long)report->num_instructions
+        );
+        if(report->num_discrepancies == 0) return;
+
+        int order[TIMING_REPORT_NUM_OPCODES];
+        int num_opcodes = 0;
+        for(int i = 0; i < TIMING_REPORT_NUM_OPCODES; ++i)
+            if(report->opcodes[i].count > 0) order[num_opcodes++] = i;
+        std::stable_sort(order, order + num_opcodes, [report](int a, int b)
+        {
+            return report->opcodes[a].count > report->opcodes[b].count;
+        });
+
+        fprintf(fp, "opcode\tmnemonic\tcount\texpected\tobserved\tfirst address\tfirst timestamp\n");
+        for(int i = 0; i < num_opcodes; ++i)
+        {
+            int op = order[i];
+            const TimingDiscrepancy& discrepancy = report->opcodes[op];
+            const char* mnemonic = instruction_table[op].mnemonic;
+
+            fprintf(fp, "0x%03X\t%s\t%llu\t%d", op, mnemonic? mnemonic: "?", (unsigned long long)discrepancy.count, cycles_table[2*op]);
+            if(cycles_table[2*op+1])
+                fprintf(fp, "/%d", cycles_table[2*op+1]);
+
+            fprintf(fp, "\t");
+            opcode_stats_print_cycles(fp, discrepancy.observed);
+
+            fprintf(fp, "\t0x%06X\t%llu\n", discrepancy.first_address, (unsigned long long)discrepancy.first_timestamp);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+
+// Binary log of retired instructions, written by the simulators and read back
+// by trace_print. The file starts with a TraceHeader followed by fixed-size
+// TraceRecords, both in host (little-endian) byte order.
+
+#define TRACE_MAGIC   0x52544D50 // 'PMTR'
+#define TRACE_VERSION 2
+
+// Set when the registers other than CB were not recorded, e.g. for traces
+// expanded from a block trace.
+#define TRACE_FLAG_NO_REGISTERS 0x1
+
+struct TraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t flags;
+};
+
+// Registers are sampled when the instruction starts executing.
+struct TraceRecord
+{
+    uint64_t timestamp;
+    uint16_t pc;
+    uint16_t ba;
+    uint16_t hl;
+    uint16_t ix;
+    uint16_t iy;
+    uint16_t sp;
+    uint16_t extended_opcode;
+    uint8_t sc;
+    uint8_t cb;
+    uint8_t nb;
+    uint8_t ep;
+    uint8_t xp;
+    uint8_t yp;
+    uint8_t br;
+    uint8_t num_cycles;
+    uint8_t opcode[4];
+    uint8_t reserved[6];
+};
+
+static_assert(sizeof(TraceRecord) == 40, "TraceRecord layout changed");
+
+// Returns the 24-bit physical address of a logical code address.
+inline uint32_t trace_physical_address(uint16_t pc, uint8_t cb)
+{
+    return (pc & 0x8000)? ((uint32_t)cb << 15) | (pc & 0x7FFF): pc;
+}
+
+namespace
+{
+    const size_t TRACE_BUFFER_RECORDS = 4096;
+
+    struct TraceWriter
+    {
+        FILE* fp;
+        uint64_t num_records_written;
+        size_t num_records;
+        TraceRecord records[TRACE_BUFFER_RECORDS];
+    };
+
+    void trace_flush(TraceWriter* trace)
+    {
+        if(trace->num_records == 0) return;
+        fwrite(trace->records, sizeof(TraceRecord), trace->num_records, trace->fp);
+        trace->num_records_written += trace->num_records;
+        trace->num_records = 0;
+    }
+
+    TraceWriter* trace_open(const char* filepath, uint32_t flags = 0)
+    {
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening trace file %s.\n", filepath);
+            return nullptr;
+        }
+
+        TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), flags};
+        fwrite(&header, sizeof(header), 1, fp);
+
+        TraceWriter* trace = new TraceWriter;
+        trace->fp = fp;
+        trace->num_records_written = 0;
+        trace->num_records = 0;
+        return trace;
+    }
+
+    void trace_close(TraceWriter* trace)
+    {
+        trace_flush(trace);
+        fclose(trace->fp);
+        delete trace;
+    }
+
+    // Opens a trace for reading and positions it at the first record.
+    FILE* trace_open_read(const char* filepath, uint32_t* flags = nullptr)
+    {
+        FILE* fp = fopen(filepath, "rb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening %s.\n", filepath);
+            return nullptr;
+        }
+
+        TraceHeader header;
+        if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != TRACE_MAGIC)
+        {
+            fprintf(stderr, "%s is not a trace file.\n", filepath);
+            fclose(fp);
+            return nullptr;
+        }
+
+        if(header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord))
+        {
+            fprintf(stderr, "Unsupported trace version %u in %s.\n", header.version, filepath);
+            fclose(fp);
+            return nullptr;
+        }
+
+        if(flags) *flags = header.flags;
+        return fp;
+    }
+
+    inline void trace_write(TraceWriter* trace, const TraceRecord& record)
+    {
+        if(trace->num_records == TRACE_BUFFER_RECORDS)
+            trace_flush(trace);
+
+        trace->records[trace->num_records++] = record;
+    }
+}
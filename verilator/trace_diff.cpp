@@ -0,0 +1,414 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "trace.h"
+
+// Finds the first instruction where two execution traces differ. Each input
+// is either a binary trace written by the simulators or a reference trace in
+// the text format below, so both RTL-vs-emulator and RTL-vs-RTL comparisons
+// work. Both traces are streamed in blocks and compared instruction by
+// instruction.
+//
+// Reference text format, one retired instruction per line, tab-separated:
+//
+//     <address>[: <disassembly>]\t<CB> <NB>[\t<BA> <HL> <IX> <IY> <SP> <SC> <EP> <XP> <YP> <BR>[\t...]]
+//
+// address is the 24-bit physical address in hex with a 0x prefix, CB and NB
+// are decimal, the registers hex without prefix. Registers hold the state
+// before the instruction executes. The register column is optional; if either
+// trace lacks it only addresses and CB, NB are compared. Traces expanded from
+// block traces carry neither, in which case only addresses are compared.
+// Anything after the register column is ignored. data/bios.flow and the
+// output of trace_print -v are both valid reference traces.
+//
+// Usage: trace_diff [-a N] [-b N] [-c N] <trace a> <trace b>
+//     -a N, -b N  skip the first N instructions of trace a or b.
+//     -c N        number of preceding instructions shown on divergence.
+
+struct TraceState
+{
+    uint64_t index;
+    uint64_t timestamp;
+    uint32_t address;
+    uint16_t ba;
+    uint16_t hl;
+    uint16_t ix;
+    uint16_t iy;
+    uint16_t sp;
+    uint8_t sc;
+    uint8_t cb;
+    uint8_t nb;
+    uint8_t ep;
+    uint8_t xp;
+    uint8_t yp;
+    uint8_t br;
+    bool has_banks;
+    bool has_registers;
+    bool has_timestamp;
+};
+
+struct TraceReader
+{
+    const char* filepath;
+    FILE* fp;
+    bool is_binary;
+    uint32_t flags;
+    uint64_t index;
+    uint64_t line_number;
+    char* buffer; // stdio buffer of fp.
+};
+
+const size_t TRACE_READER_BUFFER_SIZE = 1 << 20;
+
+static bool trace_reader_open(TraceReader* reader, const char* filepath)
+{
+    reader->filepath    = filepath;
+    reader->flags       = 0;
+    reader->index       = 0;
+    reader->line_number = 0;
+    reader->buffer      = nullptr;
+
+    uint32_t magic = 0;
+    FILE* fp = fopen(filepath, "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "Error opening %s.\n", filepath);
+        return false;
+    }
+    size_t num_read = fread(&magic, sizeof(magic), 1, fp);
+    fclose(fp);
+
+    reader->is_binary = (num_read == 1 && magic == TRACE_MAGIC);
+    reader->fp = reader->is_binary? trace_open_read(filepath, &reader->flags): fopen(filepath, "r");
+    if(!reader->fp) return false;
+
+    reader->buffer = new char[TRACE_READER_BUFFER_SIZE];
+    setvbuf(reader->fp, reader->buffer, _IOFBF, TRACE_READER_BUFFER_SIZE);
+    return true;
+}
+
+static void trace_reader_close(TraceReader* reader)
+{
+    fclose(reader->fp);
+    delete[] reader->buffer;
+}
+
+static bool parse_line(const char* line, TraceState* state)
+{
+    char* end;
+    state->address = strtoul(line, &end, 16);
+    if(end == line) return false;
+
+    const char* column = strchr(end, '\t');
+    if(!column) return false;
+
+    state->cb = strtoul(column + 1, &end, 10);
+    state->nb = strtoul(end, &end, 10);
+
+    state->has_banks     = true;
+    state->has_registers = false;
+    column = strchr(end, '\t');
+    if(column && column[1] != '\0' && column[1] != '\n')
+    {
+        const char* p = column + 1;
+        uint32_t values[10];
+        for(int i = 0; i < 10; ++i)
+        {
+            values[i] = strtoul(p, &end, 16);
+            if(end == p) return false;
+            p = end;
+        }
+
+        state->ba = values[0];
+        state->hl = values[1];
+        state->ix = values[2];
+        state->iy = values[3];
+        state->sp = values[4];
+        state->sc = values[5];
+        state->ep = values[6];
+        state->xp = values[7];
+        state->yp = values[8];
+        state->br = values[9];
+        state->has_registers = true;
+    }
+
+    state->has_timestamp = false;
+    return true;
+}
+
+// Reads up to max_states instructions, returns the number read.
+static size_t trace_reader_read(TraceReader* reader, TraceState* states, size_t max_states)
+{
+    size_t num_states = 0;
+    if(reader->is_binary)
+    {
+        static TraceRecord records[TRACE_BUFFER_RECORDS];
+        while(num_states < max_states)
+        {
+            size_t num_wanted = max_states - num_states;
+            if(num_wanted > TRACE_BUFFER_RECORDS) num_wanted = TRACE_BUFFER_RECORDS;
+            size_t num_records = fread(records, sizeof(TraceRecord), num_wanted, reader->fp);
+            for(size_t i = 0; i < num_records; ++i)
+            {
+                const TraceRecord& record = records[i];
+                TraceState* state    = &states[num_states++];
+                state->index         = reader->index++;
+                state->timestamp     = record.timestamp;
+                state->address       = trace_physical_address(record.pc, record.cb);
+                state->ba            = record.ba;
+                state->hl            = record.hl;
+                state->ix            = record.ix;
+                state->iy            = record.iy;
+                state->sp            = record.sp;
+                state->sc            = record.sc;
+                state->cb            = record.cb;
+                state->nb            = record.nb;
+                state->ep            = record.ep;
+                state->xp            = record.xp;
+                state->yp            = record.yp;
+                state->br            = record.br;
+                state->has_banks     = !(reader->flags & TRACE_FLAG_NO_REGISTERS);
+                state->has_registers = !(reader->flags & TRACE_FLAG_NO_REGISTERS);
+                state->has_timestamp = true;
+            }
+            if(num_records < num_wanted) break;
+        }
+    }
+    else
+    {
+        char line[512];
+        while(num_states < max_states && fgets(line, sizeof(line), reader->fp))
+        {
+            ++reader->line_number;
+            if(line[0] == '\n' || line[0] == '#') continue;
+
+            TraceState* state = &states[num_states];
+            if(!parse_line(line, state))
+            {
+                fprintf(stderr, "%s:%llu: Malformed line.\n", reader->filepath, (unsigned long long)reader->line_number);
+                continue;
+            }
+            state->index     = reader->index++;
+            state->timestamp = reader->line_number;
+            ++num_states;
+        }
+    }
+
+    return num_states;
+}
+
+// Fields compared, depending on what both traces recorded.
+enum
+{
+    COMPARE_ADDRESS,
+    COMPARE_BANKS,
+    COMPARE_REGISTERS
+};
+
+static inline bool states_equal(const TraceState& a, const TraceState& b, int compare)
+{
+    if(a.address != b.address)
+        return false;
+
+    if(compare == COMPARE_ADDRESS)
+        return true;
+
+    if(a.cb != b.cb || a.nb != b.nb)
+        return false;
+
+    if(compare == COMPARE_BANKS)
+        return true;
+
+    return
+        a.ba == b.ba && a.hl == b.hl && a.ix == b.ix && a.iy == b.iy && a.sp == b.sp &&
+        a.sc == b.sc && a.ep == b.ep && a.xp == b.xp && a.yp == b.yp && a.br == b.br;
+}
+
+static void print_state(const char* label, const TraceState& s, const TraceState* other, int compare)
+{
+    printf("%s #%-10llu 0x%06X CB=%02X NB=%02X", label, (unsigned long long)s.index, s.address, s.cb, s.nb);
+    if(s.has_registers)
+    {
+        printf(" BA=%04X HL=%04X IX=%04X IY=%04X SP=%04X SC=%02X EP=%02X XP=%02X YP=%02X BR=%02X",
+            s.ba, s.hl, s.ix, s.iy, s.sp, s.sc, s.ep, s.xp, s.yp, s.br
+        );
+    }
+    if(s.has_timestamp)
+        printf(" timestamp=%llu", (unsigned long long)s.timestamp);
+    else
+        printf(" line=%llu", (unsigned long long)s.timestamp);
+    printf("\n");
+
+    if(!other) return;
+
+    printf("%*s", 16, "");
+    #define DIFF_FIELD(name, field)\
+        if(s.field != other->field) printf(" %s", name)
+    DIFF_FIELD("address", address);
+    if(compare >= COMPARE_BANKS)
+    {
+        DIFF_FIELD("CB", cb);
+        DIFF_FIELD("NB", nb);
+    }
+    if(compare == COMPARE_REGISTERS)
+    {
+        DIFF_FIELD("BA", ba);
+        DIFF_FIELD("HL", hl);
+        DIFF_FIELD("IX", ix);
+        DIFF_FIELD("IY", iy);
+        DIFF_FIELD("SP", sp);
+        DIFF_FIELD("SC", sc);
+        DIFF_FIELD("EP", ep);
+        DIFF_FIELD("XP", xp);
+        DIFF_FIELD("YP", yp);
+        DIFF_FIELD("BR", br);
+    }
+    #undef DIFF_FIELD
+    printf(" differ.\n");
+}
+
+static uint64_t skip_states(TraceReader* reader, TraceState* buffer, size_t buffer_size, uint64_t num_skip)
+{
+    uint64_t num_skipped = 0;
+    while(num_skipped < num_skip)
+    {
+        uint64_t num_wanted = num_skip - num_skipped;
+        if(num_wanted > buffer_size) num_wanted = buffer_size;
+        size_t num_read = trace_reader_read(reader, buffer, num_wanted);
+        num_skipped += num_read;
+        if(num_read < num_wanted) break;
+    }
+    return num_skipped;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filepaths[2] = {nullptr, nullptr};
+    uint64_t num_skip[2] = {0, 0};
+    int num_context = 8;
+    int num_filepaths = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            num_skip[0] = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            num_skip[1] = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            num_context = atoi(argv[++i]);
+        else if(num_filepaths < 2)
+            filepaths[num_filepaths++] = argv[i];
+    }
+
+    if(num_filepaths != 2)
+    {
+        fprintf(stderr, "Usage: %s [-a N] [-b N] [-c N] <trace a> <trace b>\n", argv[0]);
+        return 2;
+    }
+
+    TraceReader readers[2];
+    for(int i = 0; i < 2; ++i)
+        if(!trace_reader_open(&readers[i], filepaths[i]))
+            return 2;
+
+    // Current and previous block of each trace; the previous block provides
+    // the context lines when a divergence is found at the start of a block.
+    const size_t BLOCK_SIZE = 4096;
+    TraceState* blocks[2][2];
+    for(int i = 0; i < 2; ++i)
+        for(int j = 0; j < 2; ++j)
+            blocks[i][j] = new TraceState[BLOCK_SIZE];
+    size_t num_previous = 0;
+
+    for(int i = 0; i < 2; ++i)
+        skip_states(&readers[i], blocks[i][0], BLOCK_SIZE, num_skip[i]);
+
+    int compare = COMPARE_REGISTERS;
+    bool first_block = true;
+    uint64_t num_compared = 0;
+    int result = 0;
+    while(true)
+    {
+        TraceState* a = blocks[0][0];
+        TraceState* b = blocks[1][0];
+        size_t num_a = trace_reader_read(&readers[0], a, BLOCK_SIZE);
+        size_t num_b = trace_reader_read(&readers[1], b, BLOCK_SIZE);
+        size_t num_states = (num_a < num_b)? num_a: num_b;
+
+        if(first_block && num_states > 0)
+        {
+            if(!a[0].has_banks || !b[0].has_banks)
+            {
+                compare = COMPARE_ADDRESS;
+                printf("Registers missing from at least one trace, comparing addresses only.\n");
+            }
+            else if(!a[0].has_registers || !b[0].has_registers)
+            {
+                compare = COMPARE_BANKS;
+                printf("Registers missing from at least one trace, comparing addresses and CB, NB only.\n");
+            }
+            first_block = false;
+        }
+
+        size_t i = 0;
+        while(i < num_states && states_equal(a[i], b[i], compare)) ++i;
+
+        if(i < num_states)
+        {
+            printf("Traces diverge after %llu matching instructions.\n", (unsigned long long)(num_compared + i));
+
+            int num_shown = 0;
+            for(int k = num_context; k > 0; --k)
+            {
+                long j = (long)i - k;
+                const TraceState* context = nullptr;
+                if(j >= 0) context = &a[j];
+                else if((long)num_previous + j >= 0) context = &blocks[0][1][num_previous + j];
+                if(!context) continue;
+                print_state("  ", *context, nullptr, compare);
+                ++num_shown;
+            }
+            if(num_shown) printf("\n");
+
+            print_state("a:", a[i], &b[i], compare);
+            print_state("b:", b[i], nullptr, compare);
+            result = 1;
+            break;
+        }
+
+        num_compared += num_states;
+        if(num_a != num_b)
+        {
+            printf("Trace %s ends after %llu matching instructions.\n",
+                (num_a < num_b)? readers[0].filepath: readers[1].filepath,
+                (unsigned long long)num_compared
+            );
+            result = 1;
+            break;
+        }
+
+        if(num_states == 0)
+        {
+            printf("Traces match, %llu instructions compared.\n", (unsigned long long)num_compared);
+            break;
+        }
+
+        for(int k = 0; k < 2; ++k)
+        {
+            TraceState* temp = blocks[k][0];
+            blocks[k][0] = blocks[k][1];
+            blocks[k][1] = temp;
+        }
+        num_previous = num_states;
+    }
+
+    for(int i = 0; i < 2; ++i)
+    {
+        trace_reader_close(&readers[i]);
+        for(int j = 0; j < 2; ++j)
+            delete[] blocks[i][j];
+    }
+
+    return result;
+}
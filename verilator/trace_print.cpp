@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "trace.h"
+#include "instruction_table.h"
+
+// Prints a binary instruction trace written by the simulator in the format of
+// data/bios.flow, i.e. one line per retired instruction with the physical
+// address, the disassembled instruction and the CB, NB registers:
+//
+//     0x0000B1: CALLW 0178h ; +197	0 0
+//
+// Relative jumps and calls show their logical target address, the offset in
+// the opcode following as a comment.
+//
+// With -v, two more tab-separated columns are appended. The first holds the
+// registers BA HL IX IY SP SC EP XP YP BR in hex, as read by trace_diff, the
+// second the timestamp, the measured number of cycles and the opcode bytes.
+// Traces expanded by trace_unpack carry no registers besides an inferred CB,
+// their register columns are all 0.
+
+// Writes value as hex the way the assembler does, e.g. 0C0h.
+static char* write_hex(char* out, uint32_t value, int num_digits)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    if(((value >> (4 * (num_digits - 1))) & 0xF) > 9)
+        *out++ = '0';
+    for(int i = num_digits - 1; i >= 0; --i)
+        *out++ = digits[(value >> (4 * i)) & 0xF];
+    *out++ = 'h';
+    return out;
+}
+
+// Disassembles the instruction at logical address pc in opcode into out, which
+// should be at least 64 bytes. Returns the number of bytes of the instruction,
+// or 0 if the opcode is unknown.
+int disassemble(char* out, const uint8_t* opcode, uint16_t pc)
+{
+    int index = instruction_index(opcode);
+
+    const InstructionInfo& info = instruction_table[index];
+    if(!info.mnemonic)
+    {
+        memcpy(out, "DB ", 3);
+        out = write_hex(out + 3, opcode[0], 2);
+        *out = '\0';
+        return 0;
+    }
+
+    // Signed operands outside of brackets are relative jump and call offsets,
+    // from the last byte of the instruction as in jump_dest of s1c88.sv.
+    int offset = 0;
+    bool is_relative = false;
+    bool in_brackets = false;
+    int operand = (index >= 0x100)? 2: 1;
+    for(const char* c = info.mnemonic; *c; ++c)
+    {
+        if(*c == '[') in_brackets = true;
+        if(*c == ']') in_brackets = false;
+        if(!in_brackets && strncmp(c, "#ss", 3) == 0)
+        {
+            offset = (c[3] == 's')? (int16_t)(opcode[operand] | (opcode[operand + 1] << 8)): (int8_t)opcode[operand];
+            out = write_hex(out, (uint16_t)(pc + info.num_bytes - 1 + offset), 4);
+            operand += (c[3] == 's')? 2: 1;
+            c += (c[3] == 's')? 4: 2;
+            is_relative = true;
+            continue;
+        }
+
+        *out++ = *c;
+        if(*c != '#') continue;
+
+        if(strncmp(c + 1, "nnnn", 4) == 0)
+        {
+            out = write_hex(out, opcode[operand] | (opcode[operand + 1] << 8), 4);
+            operand += 2;
+            c += 4;
+        }
+        else if(strncmp(c + 1, "ssss", 4) == 0)
+        {
+            out += sprintf(out, "%d", (int16_t)(opcode[operand] | (opcode[operand + 1] << 8)));
+            operand += 2;
+            c += 4;
+        }
+        else if(strncmp(c + 1, "nn", 2) == 0)
+        {
+            out = write_hex(out, opcode[operand], 2);
+            operand += 1;
+            c += 2;
+        }
+        else if(strncmp(c + 1, "ss", 2) == 0)
+        {
+            out += sprintf(out, "%d", (int8_t)opcode[operand]);
+            operand += 1;
+            c += 2;
+        }
+    }
+    if(is_relative) out += sprintf(out, " ; %+d", offset);
+    *out = '\0';
+
+    return info.num_bytes;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filepath = nullptr;
+    bool verbose = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else
+            filepath = argv[i];
+    }
+
+    if(!filepath)
+    {
+        fprintf(stderr, "Usage: %s [-v] <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t flags = 0;
+    FILE* fp = trace_open_read(filepath, &flags);
+    if(!fp) return 1;
+    if(flags & TRACE_FLAG_NO_REGISTERS)
+        fprintf(stderr, "Warning: %s has no registers, CB is inferred and NB and the registers are printed as 0.\n", filepath);
+
+    static char output_buffer[1 << 20];
+    setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+
+    static TraceRecord records[TRACE_BUFFER_RECORDS];
+    size_t num_records;
+    while((num_records = fread(records, sizeof(TraceRecord), TRACE_BUFFER_RECORDS, fp)) > 0)
+    {
+        for(size_t i = 0; i < num_records; ++i)
+        {
+            const TraceRecord& record = records[i];
+
+            char text[64];
+            disassemble(text, record.opcode, record.pc);
+
+            printf("0x%06X: %s\t%d %d",
+                trace_physical_address(record.pc, record.cb),
+                text, record.cb, record.nb
+            );
+
+            if(verbose)
+            {
+                printf("\t%04X %04X %04X %04X %04X %02X %02X %02X %02X %02X\t%llu %d %02X %02X %02X %02X",
+                    record.ba, record.hl, record.ix, record.iy, record.sp,
+                    record.sc, record.ep, record.xp, record.yp, record.br,
+                    (unsigned long long)record.timestamp, record.num_cycles,
+                    record.opcode[0], record.opcode[1], record.opcode[2], record.opcode[3]
+                );
+            }
+
+            putchar('\n');
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+#include "trace.h"
+#include "block_trace.h"
+
+// Expands a block trace (see block_trace.h) back into a per-instruction trace
+// that trace_print and trace_diff can read. The bios and cartridge the trace
+// was recorded with provide the opcode bytes.
+//
+// The output is not a drop-in replacement for a trace recorded with the
+// instruction trace. Addresses, opcodes, timestamps and cycles are exact, but
+// a block trace does not record registers: NB and BA through BR are written
+// as 0, and CB is inferred from the physical address, so it is only correct
+// for code at 0x8000 and above and 0 below. The output is marked with
+// TRACE_FLAG_NO_REGISTERS, on which trace_diff compares addresses only and
+// trace_print warns.
+//
+// Usage: trace_unpack <block trace> <bios> <cartridge> <output trace>
+
+struct BlockDefinition
+{
+    uint32_t address;
+    uint32_t timing_offset;
+    uint8_t num_instructions;
+};
+
+struct BlockTiming
+{
+    uint64_t first_delta;
+    uint8_t cycles[BLOCK_TRACE_MAX_INSTRUCTIONS];
+    uint64_t deltas[BLOCK_TRACE_MAX_INSTRUCTIONS];
+};
+
+static bool read_varint(FILE* fp, uint64_t* value)
+{
+    *value = 0;
+    for(int shift = 0; shift < 64; shift += 7)
+    {
+        int c = getc(fp);
+        if(c == EOF) return false;
+        *value |= (uint64_t)(c & 0x7F) << shift;
+        if(!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool read_timing(FILE* fp, int n, BlockTiming* timing)
+{
+    if(!read_varint(fp, &timing->first_delta)) return false;
+    for(int i = 0; i < n; ++i)
+    {
+        int c = getc(fp);
+        if(c == EOF) return false;
+        timing->cycles[i] = c;
+    }
+    timing->deltas[0] = timing->first_delta;
+    for(int i = 1; i < n; ++i)
+        if(!read_varint(fp, &timing->deltas[i])) return false;
+    return true;
+}
+
+static uint8_t* read_file(const char* filepath, size_t min_size, size_t* file_size)
+{
+    FILE* fp = fopen(filepath, "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "Error opening %s.\n", filepath);
+        return nullptr;
+    }
+    fseek(fp, 0, SEEK_END);
+    *file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t* data = (uint8_t*) calloc(1, (*file_size > min_size)? *file_size: min_size);
+    fread(data, 1, *file_size, fp);
+    fclose(fp);
+    return data;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 5)
+    {
+        fprintf(stderr, "Usage: %s <block trace> <bios> <cartridge> <output trace>\n", argv[0]);
+        return 1;
+    }
+
+    size_t bios_file_size, cartridge_file_size;
+    uint8_t* bios      = read_file(argv[2], 0x1000, &bios_file_size);
+    uint8_t* cartridge = read_file(argv[3], 0x200000, &cartridge_file_size);
+    if(!bios || !cartridge) return 1;
+
+    FILE* fp = fopen(argv[1], "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "Error opening %s.\n", argv[1]);
+        return 1;
+    }
+
+    BlockTraceHeader header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != BLOCK_TRACE_MAGIC || header.version != BLOCK_TRACE_VERSION)
+    {
+        fprintf(stderr, "%s is not a block trace.\n", argv[1]);
+        return 1;
+    }
+
+    if(header.bios_hash != block_trace_hash(bios, bios_file_size))
+        fprintf(stderr, "Warning: bios %s differs from the one the trace was recorded with.\n", argv[2]);
+    if(header.cartridge_hash != block_trace_hash(cartridge, cartridge_file_size))
+        fprintf(stderr, "Warning: cartridge %s differs from the one the trace was recorded with.\n", argv[3]);
+
+    static char input_buffer[1 << 20];
+    setvbuf(fp, input_buffer, _IOFBF, sizeof(input_buffer));
+
+    TraceWriter* output = trace_open(argv[4], TRACE_FLAG_NO_REGISTERS);
+    if(!output) return 1;
+
+    std::vector<BlockDefinition> blocks;
+    std::vector<BlockTiming> timings;
+    BlockTiming timing;
+    uint8_t literal_opcodes[BLOCK_TRACE_MAX_INSTRUCTIONS][4];
+    uint64_t timestamp = 0;
+
+    uint64_t tag;
+    while(read_varint(fp, &tag))
+    {
+        uint32_t address;
+        int n;
+        bool is_literal = (tag == 1);
+        if(tag <= 1)
+        {
+            uint64_t value;
+            if(!read_varint(fp, &value)) break;
+            address = value;
+            if(!read_varint(fp, &value) || value == 0 || value > BLOCK_TRACE_MAX_INSTRUCTIONS) break;
+            n = value;
+            if(!read_timing(fp, n, &timing)) break;
+
+            if(is_literal)
+            {
+                if(fread(literal_opcodes, 4, n, fp) != (size_t)n) break;
+            }
+            else
+            {
+                blocks.push_back({address, (uint32_t)timings.size(), (uint8_t)n});
+                timings.push_back(timing);
+            }
+        }
+        else
+        {
+            uint64_t id = (tag - 2) >> 1;
+            bool differs = (tag - 2) & 1;
+            if(id >= blocks.size())
+            {
+                fprintf(stderr, "Reference to undefined block %llu.\n", (unsigned long long)id);
+                break;
+            }
+
+            const BlockDefinition& block = blocks[id];
+            address = block.address;
+            n = block.num_instructions;
+            if(differs)
+            {
+                if(!read_timing(fp, n, &timing)) break;
+            }
+            else
+            {
+                uint64_t first_delta;
+                if(!read_varint(fp, &first_delta)) break;
+                timing = timings[block.timing_offset];
+                timing.first_delta = first_delta;
+                timing.deltas[0]   = first_delta;
+            }
+        }
+
+        for(int i = 0; i < n; ++i)
+        {
+            TraceRecord record = {};
+            timestamp += timing.deltas[i];
+
+            if(is_literal)
+                memcpy(record.opcode, literal_opcodes[i], 4);
+            else
+            {
+                for(int j = 0; j < 4; ++j)
+                {
+                    uint32_t byte_address = address + j;
+                    record.opcode[j] = (byte_address < 0x1000)?
+                        bios[byte_address & (bios_file_size - 1)]:
+                        cartridge[byte_address & 0x1FFFFF];
+                }
+            }
+
+            record.timestamp       = timestamp;
+            record.pc              = (address & 0x8000)? (0x8000 | (address & 0x7FFF)): address;
+            record.cb              = (address >> 15) & 0xFF;
+            record.extended_opcode = instruction_index(record.opcode);
+            record.num_cycles      = timing.cycles[i];
+            trace_write(output, record);
+
+            address += instruction_table[record.extended_opcode].num_bytes;
+        }
+    }
+
+    if(!feof(fp))
+        fprintf(stderr, "Error: Malformed block trace at offset %ld.\n", ftell(fp));
+
+    printf("%llu instructions in %zu blocks expanded.\n",
+        (unsigned long long)(output->num_records_written + output->num_records), blocks.size()
+    );
+
+    trace_close(output);
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,639 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <sys/stat.h>
+
+// Random access to large VCD dumps. The body of the dump is split into chunks
+// of roughly chunk_size bytes, each starting at a #time line. For every signal
+// the index lists the chunks in which it changes together with its value at
+// the end of each of those chunks and the time of its last change in them.
+// The value of a signal at time T is then found by reading at most one chunk,
+// the one containing T and only if the signal changes in it, and the changes
+// in a time window by reading only the chunks in the window that contain
+// changes of the signal.
+//
+// The index is kept in a sidecar file next to the dump (sim.vcd.idx for
+// sim.vcd) and is rebuilt when the dump's size or modification time changes.
+
+#define VCD_INDEX_MAGIC   0x49564D50 // 'PMVI'
+#define VCD_INDEX_VERSION 2
+
+const uint64_t VCD_INDEX_DEFAULT_CHUNK_SIZE = 1 << 20;
+
+struct VcdIndexHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t vcd_size;
+    uint64_t vcd_mtime;
+    uint64_t chunk_size;
+    uint32_t num_chunks;
+    uint32_t num_ids;
+    uint32_t num_signals;
+    uint32_t num_values;
+};
+
+struct VcdChunk
+{
+    uint64_t time;
+    uint64_t offset;
+};
+
+// A chunk in which a signal changes, the signal's value at its end and the
+// time it last changed in it.
+struct VcdPosting
+{
+    uint32_t chunk;
+    uint32_t value;
+    uint64_t time;
+};
+
+// Signals sharing an identifier code in the dump share their changes.
+struct VcdId
+{
+    std::string code;
+    uint32_t width;
+    std::vector<VcdPosting> postings;
+};
+
+struct VcdSignal
+{
+    std::string name;
+    uint32_t id;
+};
+
+struct VcdChange
+{
+    uint64_t time;
+    std::string value;
+};
+
+namespace
+{
+    struct VcdReader
+    {
+        FILE* fp;
+        uint64_t base;
+        size_t pos;
+        size_t size;
+        bool eof;
+        char buffer[1 << 20];
+    };
+
+    struct VcdIndex
+    {
+        std::string vcd_path;
+        std::string timescale;
+        uint64_t end_offset;
+        std::vector<VcdChunk> chunks;
+        std::vector<VcdId> ids;
+        std::vector<VcdSignal> signals;
+        std::vector<std::string> values;
+        VcdReader* reader;
+    };
+
+    enum
+    {
+        VCD_END,
+        VCD_TIME,
+        VCD_CHANGE
+    };
+
+    VcdReader* vcd_reader_open(const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "rb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening %s.\n", filepath);
+            return nullptr;
+        }
+
+        VcdReader* reader = new VcdReader;
+        reader->fp   = fp;
+        reader->base = 0;
+        reader->pos  = 0;
+        reader->size = 0;
+        reader->eof  = false;
+        return reader;
+    }
+
+    void vcd_reader_close(VcdReader* reader)
+    {
+        fclose(reader->fp);
+        delete reader;
+    }
+
+    void vcd_reader_seek(VcdReader* reader, uint64_t offset)
+    {
+        fseeko(reader->fp, offset, SEEK_SET);
+        reader->base = offset;
+        reader->pos  = 0;
+        reader->size = 0;
+        reader->eof  = false;
+    }
+
+    // Returns the next whitespace-separated token. The token is only valid
+    // until the next call.
+    bool vcd_read_token(VcdReader* reader, const char** token, size_t* length, uint64_t* offset)
+    {
+        for(;;)
+        {
+            while(reader->pos < reader->size && (unsigned char)reader->buffer[reader->pos] <= ' ')
+                ++reader->pos;
+
+            size_t end = reader->pos;
+            while(end < reader->size && (unsigned char)reader->buffer[end] > ' ')
+                ++end;
+
+            if(end < reader->size || (reader->eof && end > reader->pos))
+            {
+                *token  = reader->buffer + reader->pos;
+                *length = end - reader->pos;
+                *offset = reader->base + reader->pos;
+                reader->pos = end;
+                return true;
+            }
+            if(reader->eof) return false;
+
+            // The token may continue past the end of the buffer, move it to
+            // the front and read more.
+            size_t remaining = reader->size - reader->pos;
+            if(remaining == sizeof(reader->buffer)) return false;
+
+            memmove(reader->buffer, reader->buffer + reader->pos, remaining);
+            reader->base += reader->pos;
+            reader->pos   = 0;
+            reader->size  = remaining;
+
+            size_t num_read = fread(reader->buffer + remaining, 1, sizeof(reader->buffer) - remaining, reader->fp);
+            reader->size += num_read;
+            if(num_read == 0) reader->eof = true;
+        }
+    }
+
+    // Skips tokens up to and including the next $end.
+    void vcd_skip_to_end(VcdReader* reader)
+    {
+        const char* token;
+        size_t length;
+        uint64_t offset;
+        while(vcd_read_token(reader, &token, &length, &offset))
+            if(length == 4 && memcmp(token, "$end", 4) == 0) return;
+    }
+
+    // Reads the next time stamp or value change from the body of the dump.
+    int vcd_read_change(VcdReader* reader, uint64_t* time, std::string* code, std::string* value, uint64_t* offset)
+    {
+        const char* token;
+        size_t length;
+        while(vcd_read_token(reader, &token, &length, offset))
+        {
+            switch(token[0])
+            {
+                case '#':
+                    *time = strtoull(std::string(token + 1, length - 1).c_str(), nullptr, 10);
+                    return VCD_TIME;
+
+                case '$':
+                    // $dumpvars, $dumpon etc. only group changes, but comments
+                    // can contain anything.
+                    if(length == 8 && memcmp(token, "$comment", 8) == 0)
+                        vcd_skip_to_end(reader);
+                    break;
+
+                case 'b': case 'B': case 'r': case 'R':
+                {
+                    value->assign(token + 1, length - 1);
+                    uint64_t code_offset;
+                    if(!vcd_read_token(reader, &token, &length, &code_offset)) return VCD_END;
+                    code->assign(token, length);
+                    return VCD_CHANGE;
+                }
+
+                default:
+                    value->assign(token, 1);
+                    code->assign(token + 1, length - 1);
+                    return VCD_CHANGE;
+            }
+        }
+        return VCD_END;
+    }
+
+    std::string vcd_index_path(const char* vcd_path)
+    {
+        return std::string(vcd_path) + ".idx";
+    }
+
+    // Parses the declarations, returns false if $enddefinitions is missing.
+    bool vcd_read_header(VcdReader* reader, VcdIndex* index, std::unordered_map<std::string, uint32_t>* id_map)
+    {
+        std::vector<std::string> scopes;
+        const char* token;
+        size_t length;
+        uint64_t offset;
+        while(vcd_read_token(reader, &token, &length, &offset))
+        {
+            std::string keyword(token, length);
+            if(keyword == "$enddefinitions")
+            {
+                vcd_skip_to_end(reader);
+                return true;
+            }
+            else if(keyword == "$scope")
+            {
+                // $scope <type> <name> $end
+                std::vector<std::string> args;
+                while(vcd_read_token(reader, &token, &length, &offset) && !(length == 4 && memcmp(token, "$end", 4) == 0))
+                    args.push_back(std::string(token, length));
+                scopes.push_back(args.size() >= 2? args[1]: "");
+            }
+            else if(keyword == "$upscope")
+            {
+                if(!scopes.empty()) scopes.pop_back();
+                vcd_skip_to_end(reader);
+            }
+            else if(keyword == "$timescale")
+            {
+                index->timescale.clear();
+                while(vcd_read_token(reader, &token, &length, &offset) && !(length == 4 && memcmp(token, "$end", 4) == 0))
+                    index->timescale.append(token, length);
+            }
+            else if(keyword == "$var")
+            {
+                // $var <type> <width> <code> <name> [<range>] $end
+                std::vector<std::string> args;
+                while(vcd_read_token(reader, &token, &length, &offset) && !(length == 4 && memcmp(token, "$end", 4) == 0))
+                    args.push_back(std::string(token, length));
+                if(args.size() < 4) continue;
+
+                std::string name;
+                for(const std::string& scope: scopes)
+                    name += scope + ".";
+                name += args[3];
+                // Keep bit selects of array elements, drop the bus range.
+                if(args.size() >= 5 && args[4].find(':') == std::string::npos)
+                    name += args[4];
+
+                auto it = id_map->find(args[2]);
+                uint32_t id;
+                if(it == id_map->end())
+                {
+                    id = index->ids.size();
+                    (*id_map)[args[2]] = id;
+                    index->ids.push_back({args[2], (uint32_t)atoi(args[1].c_str()), {}});
+                }
+                else
+                    id = it->second;
+
+                index->signals.push_back({name, id});
+            }
+            else if(keyword[0] == '$')
+                vcd_skip_to_end(reader);
+        }
+        return false;
+    }
+
+    bool vcd_index_build(VcdIndex* index, uint64_t chunk_size)
+    {
+        VcdReader* reader = vcd_reader_open(index->vcd_path.c_str());
+        if(!reader) return false;
+
+        std::unordered_map<std::string, uint32_t> id_map;
+        if(!vcd_read_header(reader, index, &id_map))
+        {
+            fprintf(stderr, "%s is not a VCD file.\n", index->vcd_path.c_str());
+            vcd_reader_close(reader);
+            return false;
+        }
+
+        std::unordered_map<std::string, uint32_t> value_map;
+        std::vector<std::string> current_values(index->ids.size());
+        std::vector<uint64_t> current_times(index->ids.size());
+        std::vector<uint32_t> last_changed_chunk(index->ids.size(), UINT32_MAX);
+        std::vector<uint32_t> changed_ids;
+
+        auto end_chunk = [&]()
+        {
+            uint32_t chunk = index->chunks.size() - 1;
+            for(uint32_t id: changed_ids)
+            {
+                auto it = value_map.find(current_values[id]);
+                uint32_t value;
+                if(it == value_map.end())
+                {
+                    value = index->values.size();
+                    value_map[current_values[id]] = value;
+                    index->values.push_back(current_values[id]);
+                }
+                else
+                    value = it->second;
+                index->ids[id].postings.push_back({chunk, value, current_times[id]});
+            }
+            changed_ids.clear();
+        };
+
+        uint64_t time = 0, offset;
+        std::string code, value;
+        bool in_chunk = false;
+        int type;
+        while((type = vcd_read_change(reader, &time, &code, &value, &offset)) != VCD_END)
+        {
+            if(!in_chunk)
+            {
+                index->chunks.push_back({0, offset});
+                in_chunk = true;
+            }
+
+            if(type == VCD_TIME)
+            {
+                if(offset - index->chunks.back().offset >= chunk_size)
+                {
+                    end_chunk();
+                    index->chunks.push_back({time, offset});
+                }
+                continue;
+            }
+
+            auto it = id_map.find(code);
+            if(it == id_map.end()) continue;
+
+            uint32_t id = it->second;
+            current_values[id] = value;
+            current_times[id]  = time;
+            if(last_changed_chunk[id] != index->chunks.size())
+            {
+                last_changed_chunk[id] = index->chunks.size();
+                changed_ids.push_back(id);
+            }
+        }
+        if(in_chunk) end_chunk();
+
+        index->end_offset = reader->base + reader->size;
+        vcd_reader_close(reader);
+        return true;
+    }
+
+    void vcd_write_string(FILE* fp, const std::string& s)
+    {
+        uint32_t length = s.size();
+        fwrite(&length, sizeof(length), 1, fp);
+        fwrite(s.data(), 1, length, fp);
+    }
+
+    bool vcd_read_string(FILE* fp, std::string* s)
+    {
+        uint32_t length;
+        if(fread(&length, sizeof(length), 1, fp) != 1) return false;
+        s->resize(length);
+        return fread(&(*s)[0], 1, length, fp) == length;
+    }
+
+    bool vcd_index_save(const VcdIndex* index, const char* filepath, const struct stat& vcd_stat, uint64_t chunk_size)
+    {
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening index file %s.\n", filepath);
+            return false;
+        }
+
+        VcdIndexHeader header = {
+            VCD_INDEX_MAGIC, VCD_INDEX_VERSION,
+            (uint64_t)vcd_stat.st_size, (uint64_t)vcd_stat.st_mtime, chunk_size,
+            (uint32_t)index->chunks.size(), (uint32_t)index->ids.size(),
+            (uint32_t)index->signals.size(), (uint32_t)index->values.size()
+        };
+        fwrite(&header, sizeof(header), 1, fp);
+        vcd_write_string(fp, index->timescale);
+        fwrite(index->chunks.data(), sizeof(VcdChunk), index->chunks.size(), fp);
+
+        for(const VcdId& id: index->ids)
+        {
+            vcd_write_string(fp, id.code);
+            uint32_t num_postings = id.postings.size();
+            fwrite(&id.width, sizeof(id.width), 1, fp);
+            fwrite(&num_postings, sizeof(num_postings), 1, fp);
+            fwrite(id.postings.data(), sizeof(VcdPosting), num_postings, fp);
+        }
+
+        for(const VcdSignal& signal: index->signals)
+        {
+            vcd_write_string(fp, signal.name);
+            fwrite(&signal.id, sizeof(signal.id), 1, fp);
+        }
+
+        for(const std::string& value: index->values)
+            vcd_write_string(fp, value);
+
+        fclose(fp);
+        return true;
+    }
+
+    // Loads the index file, returns false if it is missing, unreadable or was
+    // built for a different version of the dump.
+    bool vcd_index_load(VcdIndex* index, const char* filepath, const struct stat& vcd_stat)
+    {
+        FILE* fp = fopen(filepath, "rb");
+        if(!fp) return false;
+
+        VcdIndexHeader header;
+        bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+            header.magic == VCD_INDEX_MAGIC && header.version == VCD_INDEX_VERSION &&
+            header.vcd_size == (uint64_t)vcd_stat.st_size && header.vcd_mtime == (uint64_t)vcd_stat.st_mtime;
+
+        ok = ok && vcd_read_string(fp, &index->timescale);
+        if(ok)
+        {
+            index->chunks.resize(header.num_chunks);
+            ok = fread(index->chunks.data(), sizeof(VcdChunk), header.num_chunks, fp) == header.num_chunks;
+        }
+
+        if(ok) index->ids.resize(header.num_ids);
+        for(uint32_t i = 0; ok && i < header.num_ids; ++i)
+        {
+            VcdId& id = index->ids[i];
+            uint32_t num_postings;
+            ok = vcd_read_string(fp, &id.code) &&
+                fread(&id.width, sizeof(id.width), 1, fp) == 1 &&
+                fread(&num_postings, sizeof(num_postings), 1, fp) == 1;
+            if(!ok) break;
+            id.postings.resize(num_postings);
+            ok = fread(id.postings.data(), sizeof(VcdPosting), num_postings, fp) == num_postings;
+        }
+
+        if(ok) index->signals.resize(header.num_signals);
+        for(uint32_t i = 0; ok && i < header.num_signals; ++i)
+            ok = vcd_read_string(fp, &index->signals[i].name) &&
+                fread(&index->signals[i].id, sizeof(uint32_t), 1, fp) == 1;
+
+        if(ok) index->values.resize(header.num_values);
+        for(uint32_t i = 0; ok && i < header.num_values; ++i)
+            ok = vcd_read_string(fp, &index->values[i]);
+
+        fclose(fp);
+        index->end_offset = vcd_stat.st_size;
+        return ok;
+    }
+
+    void vcd_index_close(VcdIndex* index)
+    {
+        if(index->reader) vcd_reader_close(index->reader);
+        delete index;
+    }
+
+    // Opens a dump for queries, loading its index or building it if it is
+    // missing or out of date. With rebuild set the index is always rebuilt.
+    VcdIndex* vcd_index_open(const char* vcd_path, bool rebuild = false, uint64_t chunk_size = VCD_INDEX_DEFAULT_CHUNK_SIZE)
+    {
+        struct stat vcd_stat;
+        if(stat(vcd_path, &vcd_stat) != 0)
+        {
+            fprintf(stderr, "Error opening %s.\n", vcd_path);
+            return nullptr;
+        }
+
+        VcdIndex* index = new VcdIndex;
+        index->vcd_path = vcd_path;
+        index->reader   = nullptr;
+
+        std::string index_path = vcd_index_path(vcd_path);
+        if(rebuild || !vcd_index_load(index, index_path.c_str(), vcd_stat))
+        {
+            *index = VcdIndex();
+            index->vcd_path = vcd_path;
+            index->reader   = nullptr;
+
+            fprintf(stderr, "Indexing %s...\n", vcd_path);
+            if(!vcd_index_build(index, chunk_size))
+            {
+                delete index;
+                return nullptr;
+            }
+            vcd_index_save(index, index_path.c_str(), vcd_stat, chunk_size);
+        }
+
+        index->reader = vcd_reader_open(vcd_path);
+        if(!index->reader)
+        {
+            delete index;
+            return nullptr;
+        }
+        return index;
+    }
+
+    // Returns the signal with the given hierarchical name, or with a unique
+    // name ending in ".<name>". Returns -1 if there is no such signal.
+    int vcd_find_signal(const VcdIndex* index, const char* name)
+    {
+        std::string suffix = std::string(".") + name;
+        int found = -1;
+        for(size_t i = 0; i < index->signals.size(); ++i)
+        {
+            const std::string& signal_name = index->signals[i].name;
+            if(signal_name == name) return i;
+            if(signal_name.size() > suffix.size() &&
+                signal_name.compare(signal_name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            {
+                if(found >= 0) return -1;
+                found = i;
+            }
+        }
+        return found;
+    }
+
+    // Calls on_change(time, value) for every change of id in the chunk up to
+    // and including time until. Stops early if on_change returns false.
+    template<typename F>
+    void vcd_scan_chunk(VcdIndex* index, uint32_t chunk, uint32_t id, uint64_t until, F on_change)
+    {
+        uint64_t end_offset = (chunk + 1 < index->chunks.size())? index->chunks[chunk + 1].offset: index->end_offset;
+        const std::string& id_code = index->ids[id].code;
+
+        VcdReader* reader = index->reader;
+        vcd_reader_seek(reader, index->chunks[chunk].offset);
+
+        uint64_t time = index->chunks[chunk].time, offset;
+        std::string code, value;
+        int type;
+        while((type = vcd_read_change(reader, &time, &code, &value, &offset)) != VCD_END && offset < end_offset)
+        {
+            if(time > until) break;
+            if(type == VCD_CHANGE && code == id_code)
+                if(!on_change(time, value)) break;
+        }
+    }
+
+    uint32_t vcd_find_chunk(const VcdIndex* index, uint64_t time)
+    {
+        auto it = std::upper_bound(index->chunks.begin(), index->chunks.end(), time,
+            [](uint64_t t, const VcdChunk& chunk) { return t < chunk.time; });
+        return (it == index->chunks.begin())? 0: (it - index->chunks.begin()) - 1;
+    }
+
+    // Returns the first posting of id in or after chunk.
+    size_t vcd_find_posting(const VcdIndex* index, uint32_t id, uint32_t chunk)
+    {
+        const std::vector<VcdPosting>& postings = index->ids[id].postings;
+        return std::lower_bound(postings.begin(), postings.end(), chunk,
+            [](const VcdPosting& posting, uint32_t c) { return posting.chunk < c; }) - postings.begin();
+    }
+
+    // Gets the value of a signal at time, after all changes at that time,
+    // and the time it was last changed. Returns false if the signal was never
+    // assigned before time.
+    bool vcd_value_at(VcdIndex* index, int signal, uint64_t time, std::string* value, uint64_t* since)
+    {
+        if(index->chunks.empty()) return false;
+
+        uint32_t id = index->signals[signal].id;
+        const std::vector<VcdPosting>& postings = index->ids[id].postings;
+        uint32_t chunk = vcd_find_chunk(index, time);
+        size_t posting = vcd_find_posting(index, id, chunk);
+
+        bool found = false;
+        if(posting < postings.size() && postings[posting].chunk == chunk)
+        {
+            vcd_scan_chunk(index, chunk, id, time, [&](uint64_t t, const std::string& v)
+            {
+                *value = v;
+                *since = t;
+                found  = true;
+                return true;
+            });
+        }
+        if(found) return true;
+        if(posting == 0) return false;
+
+        // The value is the one at the end of the last chunk the signal
+        // changed in, which the index holds without reading the chunk.
+        const VcdPosting& previous = postings[posting - 1];
+        *value = index->values[previous.value];
+        *since = previous.time;
+        return true;
+    }
+
+    // Gets all changes of a signal in the time window (start, end].
+    void vcd_changes(VcdIndex* index, int signal, uint64_t start, uint64_t end, std::vector<VcdChange>* changes)
+    {
+        if(index->chunks.empty()) return;
+
+        uint32_t id = index->signals[signal].id;
+        const std::vector<VcdPosting>& postings = index->ids[id].postings;
+        uint32_t last_chunk = vcd_find_chunk(index, end);
+        for(size_t i = vcd_find_posting(index, id, vcd_find_chunk(index, start)); i < postings.size() && postings[i].chunk <= last_chunk; ++i)
+        {
+            vcd_scan_chunk(index, postings[i].chunk, id, end, [&](uint64_t t, const std::string& v)
+            {
+                if(t > start) changes->push_back({t, v});
+                return true;
+            });
+        }
+    }
+}
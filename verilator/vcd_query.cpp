@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "vcd_index.h"
+
+// Answers queries on VCD dumps written by the simulators without loading the
+// whole dump, using the sidecar index from vcd_index.h. The index is built on
+// the first query, or explicitly with the index command.
+//
+// Usage: vcd_query <dump> <command> [args]
+//     index [chunk KB]               (re)build the index
+//     list [pattern]                 list signals whose name contains pattern
+//     value <time> <signal>...       value of signals at time
+//     changes <start> <end> <signal> changes of signal in (start, end]
+//
+// Signals are given by their full hierarchical name, or any unique suffix
+// after a '.', e.g. cpu.PC.
+
+// Prints bus values as hex if they have no x or z bits.
+static std::string format_value(const std::string& value, uint32_t width)
+{
+    if(width <= 1 || value.find_first_not_of("01") != std::string::npos)
+        return value;
+
+    std::string bits = value;
+    size_t num_digits = (width + 3) / 4;
+    if(bits.size() < num_digits * 4)
+        bits.insert(0, num_digits * 4 - bits.size(), '0');
+
+    std::string hex = "0x";
+    for(size_t i = bits.size() - num_digits * 4; i < bits.size(); i += 4)
+    {
+        int digit = 0;
+        for(size_t j = 0; j < 4; ++j)
+            digit = (digit << 1) | (bits[i + j] - '0');
+        hex += "0123456789ABCDEF"[digit];
+    }
+    return hex;
+}
+
+static int find_signal(const VcdIndex* index, const char* name)
+{
+    int signal = vcd_find_signal(index, name);
+    if(signal < 0)
+        fprintf(stderr, "No unique signal named %s.\n", name);
+    return signal;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr,
+            "Usage: %s <dump> <command> [args]\n"
+            "    index [chunk KB]\n"
+            "    list [pattern]\n"
+            "    value <time> <signal>...\n"
+            "    changes <start> <end> <signal>\n",
+            argv[0]
+        );
+        return 1;
+    }
+
+    const char* vcd_path = argv[1];
+    const char* command  = argv[2];
+
+    if(strcmp(command, "index") == 0)
+    {
+        uint64_t chunk_size = (argc > 3)? strtoull(argv[3], nullptr, 10) * 1024: VCD_INDEX_DEFAULT_CHUNK_SIZE;
+        VcdIndex* index = vcd_index_open(vcd_path, true, chunk_size);
+        if(!index) return 1;
+
+        size_t num_postings = 0;
+        for(const VcdId& id: index->ids)
+            num_postings += id.postings.size();
+        printf("%zu signals, %zu chunks, %zu postings, %zu distinct values.\n",
+            index->signals.size(), index->chunks.size(), num_postings, index->values.size()
+        );
+        vcd_index_close(index);
+        return 0;
+    }
+
+    VcdIndex* index = vcd_index_open(vcd_path);
+    if(!index) return 1;
+
+    int result = 0;
+    if(strcmp(command, "list") == 0)
+    {
+        const char* pattern = (argc > 3)? argv[3]: "";
+        for(const VcdSignal& signal: index->signals)
+            if(signal.name.find(pattern) != std::string::npos)
+                printf("%s\t%u\n", signal.name.c_str(), index->ids[signal.id].width);
+    }
+    else if(strcmp(command, "value") == 0 && argc > 4)
+    {
+        uint64_t time = strtoull(argv[3], nullptr, 10);
+        for(int i = 4; i < argc; ++i)
+        {
+            int signal = find_signal(index, argv[i]);
+            if(signal < 0)
+            {
+                result = 1;
+                continue;
+            }
+
+            std::string value;
+            uint64_t since;
+            uint32_t width = index->ids[index->signals[signal].id].width;
+            if(vcd_value_at(index, signal, time, &value, &since))
+                printf("%s\t%s\t(since %llu)\n", index->signals[signal].name.c_str(), format_value(value, width).c_str(), (unsigned long long)since);
+            else
+                printf("%s\tx\n", index->signals[signal].name.c_str());
+        }
+    }
+    else if(strcmp(command, "changes") == 0 && argc == 6)
+    {
+        uint64_t start = strtoull(argv[3], nullptr, 10);
+        uint64_t end   = strtoull(argv[4], nullptr, 10);
+        int signal = find_signal(index, argv[5]);
+        if(signal >= 0)
+        {
+            uint32_t width = index->ids[index->signals[signal].id].width;
+
+            std::string value;
+            uint64_t since;
+            if(vcd_value_at(index, signal, start, &value, &since))
+                printf("%llu\t%s\n", (unsigned long long)since, format_value(value, width).c_str());
+
+            std::vector<VcdChange> changes;
+            vcd_changes(index, signal, start, end, &changes);
+            for(const VcdChange& change: changes)
+                printf("%llu\t%s\n", (unsigned long long)change.time, format_value(change.value, width).c_str());
+        }
+        else result = 1;
+    }
+    else
+    {
+        fprintf(stderr, "Unknown command or wrong number of arguments: %s.\n", command);
+        result = 1;
+    }
+
+    vcd_index_close(index);
+    return result;
+}
@@ -0,0 +1,251 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+#include "video_record.h"
+
+// Converts a video recording (see video_record.h) to a Y4M video and a WAV
+// file, and optionally muxes them into a single lossless file with ffmpeg.
+//
+// Usage: video_export [-y4m <path>] [-wav <path>] [-scale <n>] [-mux <path>] <video>
+//     -y4m    writes the frames as grayscale Y4M, repeats included, at the
+//             mean frame rate of the recording.
+//     -wav    writes the sound as 8-bit mono WAV, starting at the first frame.
+//     -scale  scales the frames up by n, default 1.
+//     -mux    runs ffmpeg to mux the Y4M and WAV files into <path>, as FFV1
+//             and FLAC, e.g. into a .mkv file. Needs -y4m and -wav.
+//
+// Without any option it prints the number of frames, repeats and samples.
+// Pixels are shaded by the recorded contrast as in the frames written by
+// minx_sim.
+
+namespace
+{
+    struct VideoStats
+    {
+        uint32_t num_frames;
+        uint32_t num_repeats;
+        uint64_t num_samples;
+        uint64_t first_timestamp;
+        uint64_t last_timestamp;
+    };
+
+    // Reads the chunks after the header, calling on_chunk with every chunk
+    // and its data. Returns false if the stream is truncated.
+    template<typename F>
+    bool read_chunks(FILE* fp, F on_chunk)
+    {
+        std::vector<uint8_t> data;
+        VideoChunk chunk;
+        while(fread(&chunk, sizeof(chunk), 1, fp) == 1)
+        {
+            data.resize(chunk.size);
+            if(fread(data.data(), 1, chunk.size, fp) != chunk.size)
+            {
+                fprintf(stderr, "Error: Truncated chunk at cycle %llu.\n", (unsigned long long)chunk.timestamp);
+                return false;
+            }
+            if(chunk.type == VIDEO_CHUNK_FRAME && chunk.size != 1 + VIDEO_FRAME_SIZE)
+            {
+                fprintf(stderr, "Error: Frame of %u bytes at cycle %llu.\n", chunk.size, (unsigned long long)chunk.timestamp);
+                return false;
+            }
+            on_chunk(chunk, data.data());
+        }
+        return true;
+    }
+
+    void write_wav_header(FILE* fp, uint32_t sample_rate, uint32_t num_samples)
+    {
+        uint32_t riff_size = 36 + num_samples;
+        uint32_t fmt_size = 16;
+        uint16_t format = 1, channels = 1, block_align = 1, bits = 8;
+        fwrite("RIFF", 1, 4, fp);
+        fwrite(&riff_size, 4, 1, fp);
+        fwrite("WAVEfmt ", 1, 8, fp);
+        fwrite(&fmt_size, 4, 1, fp);
+        fwrite(&format, 2, 1, fp);
+        fwrite(&channels, 2, 1, fp);
+        fwrite(&sample_rate, 4, 1, fp);
+        fwrite(&sample_rate, 4, 1, fp); // Bytes per second.
+        fwrite(&block_align, 2, 1, fp);
+        fwrite(&bits, 2, 1, fp);
+        fwrite("data", 1, 4, fp);
+        fwrite(&num_samples, 4, 1, fp);
+    }
+
+    void frame_to_image(const uint8_t* frame, int scale, uint8_t* image)
+    {
+        uint8_t contrast = (frame[0] > 0x20)? 0x20: frame[0];
+        uint8_t off = 255;
+        uint8_t on  = (uint8_t)(255.0 * (1.0 - (float)contrast / 0x20));
+        int width = VIDEO_WIDTH * scale;
+        for(uint32_t y = 0; y < VIDEO_HEIGHT; ++y)
+        {
+            for(uint32_t x = 0; x < VIDEO_WIDTH; ++x)
+            {
+                uint8_t value = ((frame[1 + (y >> 3) * VIDEO_WIDTH + x] >> (y & 7)) & 1)? on: off;
+                for(int sy = 0; sy < scale; ++sy)
+                    memset(image + (y * scale + sy) * width + x * scale, value, scale);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* y4m_path = nullptr;
+    const char* wav_path = nullptr;
+    const char* mux_path = nullptr;
+    const char* filepath = nullptr;
+    int scale = 1;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-y4m") == 0 && i + 1 < argc)
+            y4m_path = argv[++i];
+        else if(strcmp(argv[i], "-wav") == 0 && i + 1 < argc)
+            wav_path = argv[++i];
+        else if(strcmp(argv[i], "-mux") == 0 && i + 1 < argc)
+            mux_path = argv[++i];
+        else if(strcmp(argv[i], "-scale") == 0 && i + 1 < argc)
+        {
+            scale = atoi(argv[++i]);
+            if(scale < 1 || scale > 16)
+            {
+                fprintf(stderr, "Error: Expected a -scale of 1 to 16, got %s.\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+            filepath = argv[i];
+    }
+
+    if(!filepath || (mux_path && (!y4m_path || !wav_path)))
+    {
+        fprintf(stderr, "Usage: %s [-y4m <path>] [-wav <path>] [-scale <n>] [-mux <path>] <video>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* fp = fopen(filepath, "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "Error opening %s.\n", filepath);
+        return 1;
+    }
+
+    VideoHeader header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != VIDEO_MAGIC || header.version != VIDEO_VERSION ||
+       header.width != VIDEO_WIDTH || header.height != VIDEO_HEIGHT)
+    {
+        fprintf(stderr, "%s is not a video recording.\n", filepath);
+        return 1;
+    }
+
+    // First pass for the frame rate and the audio to skip before the first
+    // frame.
+    VideoStats stats = {};
+    bool ok = read_chunks(fp, [&](const VideoChunk& chunk, const uint8_t*)
+    {
+        if(chunk.type == VIDEO_CHUNK_AUDIO)
+        {
+            stats.num_samples += chunk.size;
+            return;
+        }
+        if(stats.num_frames == 0) stats.first_timestamp = chunk.timestamp;
+        stats.last_timestamp = chunk.timestamp;
+        stats.num_repeats += (chunk.type == VIDEO_CHUNK_REPEAT);
+        ++stats.num_frames;
+    });
+    if(!ok) return 1;
+
+    uint64_t cycles_per_frame = (stats.num_frames > 1)?
+        (stats.last_timestamp - stats.first_timestamp + (stats.num_frames - 1) / 2) / (stats.num_frames - 1): 0;
+    printf("%u frames, %u of them repeats, %llu cycles per frame, %llu samples.\n", stats.num_frames, stats.num_repeats,
+        (unsigned long long)cycles_per_frame, (unsigned long long)stats.num_samples);
+    if(!y4m_path && !wav_path) return 0;
+    if(stats.num_frames == 0 || cycles_per_frame == 0)
+    {
+        fprintf(stderr, "Error: %s has fewer than 2 frames.\n", filepath);
+        return 1;
+    }
+
+    FILE* y4m_fp = nullptr;
+    if(y4m_path)
+    {
+        y4m_fp = fopen(y4m_path, "wb");
+        if(!y4m_fp)
+        {
+            fprintf(stderr, "Error opening %s.\n", y4m_path);
+            return 1;
+        }
+        fprintf(y4m_fp, "YUV4MPEG2 W%u H%u F%u:%llu Ip A1:1 Cmono\n", VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale,
+            header.clock_rate, (unsigned long long)cycles_per_frame);
+    }
+
+    FILE* wav_fp = nullptr;
+    if(wav_path)
+    {
+        wav_fp = fopen(wav_path, "wb");
+        if(!wav_fp)
+        {
+            fprintf(stderr, "Error opening %s.\n", wav_path);
+            return 1;
+        }
+        write_wav_header(wav_fp, header.audio_rate, 0); // Sizes are written at the end.
+    }
+
+    std::vector<uint8_t> image(VIDEO_WIDTH * VIDEO_HEIGHT * scale * scale);
+    uint32_t num_samples = 0;
+    fseek(fp, sizeof(header), SEEK_SET);
+    ok = read_chunks(fp, [&](const VideoChunk& chunk, const uint8_t* data)
+    {
+        if(chunk.type == VIDEO_CHUNK_AUDIO)
+        {
+            if(!wav_fp) return;
+            // Align the sound with the first frame.
+            uint64_t skip = 0;
+            if(chunk.timestamp < stats.first_timestamp)
+                skip = (stats.first_timestamp - chunk.timestamp) * header.audio_rate / header.clock_rate;
+            if(skip >= chunk.size) return;
+            fwrite(data + skip, 1, chunk.size - skip, wav_fp);
+            num_samples += chunk.size - skip;
+            return;
+        }
+        if(!y4m_fp) return;
+        if(chunk.type == VIDEO_CHUNK_FRAME) frame_to_image(data, scale, image.data());
+        fprintf(y4m_fp, "FRAME\n");
+        fwrite(image.data(), 1, image.size(), y4m_fp);
+    });
+    fclose(fp);
+
+    if(y4m_fp)
+    {
+        fclose(y4m_fp);
+        printf("%u frames written to %s.\n", stats.num_frames, y4m_path);
+    }
+    if(wav_fp)
+    {
+        fseek(wav_fp, 0, SEEK_SET);
+        write_wav_header(wav_fp, header.audio_rate, num_samples);
+        fclose(wav_fp);
+        printf("%u samples written to %s.\n", num_samples, wav_path);
+    }
+    if(!ok) return 1;
+
+    if(mux_path)
+    {
+        char command[4096];
+        snprintf(command, sizeof(command), "ffmpeg -y -loglevel error -i \"%s\" -i \"%s\" -c:v ffv1 -c:a flac \"%s\"",
+            y4m_path, wav_path, mux_path);
+        printf("%s\n", command);
+        if(system(command) != 0)
+        {
+            fprintf(stderr, "Error muxing %s with ffmpeg.\n", mux_path);
+            return 1;
+        }
+    }
+
+    return 0;
+}
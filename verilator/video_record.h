@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// Lossless recording of the LCD and the sound output at native resolution.
+// A frame is recorded at every frame_complete as the 8 pages of 96 bytes of
+// the LCD, bit i of a byte being row i of its page, with the contrast and the
+// cycle it completed at. A frame identical to the one before, including the
+// contrast, is stored as a repeat marker of 16 bytes instead. The sound output
+// is averaged down to VIDEO_AUDIO_RATE unsigned 8-bit samples, written before
+// every frame. Convert a recording to Y4M and WAV, or mux them with ffmpeg,
+// with tools/video_export.
+//
+// The stream starts with a VideoHeader, followed by VideoChunks, each
+// followed by size bytes of data:
+//
+//     VIDEO_CHUNK_FRAME   the contrast, then the 768 bytes of the LCD.
+//     VIDEO_CHUNK_REPEAT  no data, the last frame is shown again.
+//     VIDEO_CHUNK_AUDIO   the samples, the timestamp is that of the first.
+
+#define VIDEO_MAGIC   0x44564D50 // 'PMVD'
+#define VIDEO_VERSION 1
+
+const uint32_t VIDEO_WIDTH      = 96;
+const uint32_t VIDEO_HEIGHT     = 64;
+const uint32_t VIDEO_FRAME_SIZE = VIDEO_WIDTH * VIDEO_HEIGHT / 8;
+const uint32_t VIDEO_CLOCK_RATE = 4000000; // Cycles per second.
+const uint32_t VIDEO_AUDIO_RATE = 32768;   // Samples per second.
+
+// The sound output, -127 to 127, as played and recorded: the pulse at the
+// amplitude of the volume register.
+inline int8_t video_sound_level(uint8_t volume, uint8_t sound_pulse)
+{
+    int8_t multiplier = (volume == 0)? 0: ((volume == 3)? 127: 63);
+    return (2 * sound_pulse - 1) * multiplier;
+}
+
+enum
+{
+    VIDEO_CHUNK_FRAME,
+    VIDEO_CHUNK_REPEAT,
+    VIDEO_CHUNK_AUDIO
+};
+
+struct VideoHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t clock_rate;
+    uint32_t audio_rate;
+};
+
+struct VideoChunk
+{
+    uint32_t type;
+    uint32_t size;
+    uint64_t timestamp; // In cycles.
+};
+
+namespace
+{
+    struct VideoRecorder
+    {
+        FILE* fp;
+        uint8_t last_frame[1 + VIDEO_FRAME_SIZE]; // Contrast and the LCD.
+        uint32_t num_frames;
+        uint32_t num_repeats;
+
+        int32_t audio_sum;
+        uint32_t audio_count;
+        uint32_t audio_phase;
+        uint64_t audio_timestamp; // Of the first buffered sample.
+        uint32_t num_samples;
+        uint8_t samples[VIDEO_AUDIO_RATE]; // Flushed at every frame.
+    };
+
+    VideoRecorder* video_record_open(const char* filepath)
+    {
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening video file %s.\n", filepath);
+            return nullptr;
+        }
+
+        VideoHeader header = {VIDEO_MAGIC, VIDEO_VERSION, VIDEO_WIDTH, VIDEO_HEIGHT, VIDEO_CLOCK_RATE, VIDEO_AUDIO_RATE};
+        fwrite(&header, sizeof(header), 1, fp);
+
+        VideoRecorder* recorder = new VideoRecorder;
+        memset(recorder, 0, sizeof(VideoRecorder));
+        recorder->fp = fp;
+        return recorder;
+    }
+
+    void video_record_flush_audio(VideoRecorder* recorder)
+    {
+        if(recorder->num_samples == 0) return;
+        VideoChunk chunk = {VIDEO_CHUNK_AUDIO, recorder->num_samples, recorder->audio_timestamp};
+        fwrite(&chunk, sizeof(chunk), 1, recorder->fp);
+        fwrite(recorder->samples, 1, recorder->num_samples, recorder->fp);
+        recorder->num_samples = 0;
+    }
+
+    // Call every clock cycle with the sound output, -127 to 127.
+    inline void video_record_audio(VideoRecorder* recorder, int8_t level, uint64_t cycles)
+    {
+        recorder->audio_sum += level;
+        ++recorder->audio_count;
+        recorder->audio_phase += VIDEO_AUDIO_RATE;
+        if(recorder->audio_phase < VIDEO_CLOCK_RATE) return;
+
+        recorder->audio_phase -= VIDEO_CLOCK_RATE;
+        if(recorder->num_samples == VIDEO_AUDIO_RATE) video_record_flush_audio(recorder);
+        if(recorder->num_samples == 0) recorder->audio_timestamp = cycles;
+        recorder->samples[recorder->num_samples++] = (uint8_t)(128 + recorder->audio_sum / (int32_t)recorder->audio_count);
+        recorder->audio_sum   = 0;
+        recorder->audio_count = 0;
+    }
+
+    // Call at frame_complete, pages being the first byte of 8 pages of 96
+    // bytes, each stride bytes after the one before.
+    void video_record_frame(VideoRecorder* recorder, uint64_t cycles, uint8_t contrast, const uint8_t* pages, int stride)
+    {
+        uint8_t frame[1 + VIDEO_FRAME_SIZE];
+        frame[0] = contrast;
+        for(uint32_t page = 0; page < VIDEO_HEIGHT / 8; ++page)
+            memcpy(frame + 1 + page * VIDEO_WIDTH, pages + page * stride, VIDEO_WIDTH);
+
+        video_record_flush_audio(recorder);
+        bool repeat = recorder->num_frames > 0 && memcmp(frame, recorder->last_frame, sizeof(frame)) == 0;
+        VideoChunk chunk = {repeat? (uint32_t)VIDEO_CHUNK_REPEAT: (uint32_t)VIDEO_CHUNK_FRAME, repeat? 0: (uint32_t)sizeof(frame), cycles};
+        fwrite(&chunk, sizeof(chunk), 1, recorder->fp);
+        if(!repeat)
+        {
+            fwrite(frame, 1, sizeof(frame), recorder->fp);
+            memcpy(recorder->last_frame, frame, sizeof(frame));
+        }
+        recorder->num_repeats += repeat;
+        ++recorder->num_frames;
+    }
+
+    // Writes the buffered samples and prints the counts.
+    void video_record_close(VideoRecorder* recorder)
+    {
+        if(!recorder) return;
+        video_record_flush_audio(recorder);
+        printf("%u video frames recorded, %u of them repeats, %ld bytes.\n",
+            recorder->num_frames, recorder->num_repeats, ftell(recorder->fp));
+        fclose(recorder->fp);
+        delete recorder;
+    }
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "signal_registry.h"
+#include "bus_access.h"
+
+// Log of a list of signals and bus writes, configured at runtime by name. The
+// names are resolved once when the log is opened; after that watch_update
+// only compares each signal against its previous value and appends a
+// WatchRecord when it differs. Print a log with tools/watch_print.
+//
+// The watch file has one entry per line, empty lines and lines starting with
+// '#' are ignored:
+//
+//     <signal>                 logged when it changes
+//     <signal> @ <pc>...       logged when an instruction at one of the
+//                              physical PCs retires, even if unchanged
+//     write <address>          every bus write to address with its data,
+//                              including writes of the same value
+//
+// See signal_registry.h for the syntax of signal names. Records of the last
+// two kinds hold the physical PC of the instruction.
+//
+// The log starts with a WatchHeader, followed by num_signals entries of
+// <uint32 width> <uint32 kind> <uint32 name length> <name>, and then
+// WatchRecords. The first record of each changed signal holds its value when
+// the log was opened.
+
+#define WATCH_MAGIC   0x54574D50 // 'PMWT'
+#define WATCH_VERSION 2
+
+const int WATCH_MAX_SIGNALS = 256;
+const int WATCH_MAX_PCS     = 8;
+
+enum
+{
+    WATCH_CHANGE,
+    WATCH_AT_PC,
+    WATCH_WRITE
+};
+
+struct WatchHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_signals;
+    uint32_t reserved;
+};
+
+struct WatchRecord
+{
+    uint64_t timestamp;
+    uint64_t value;
+    uint32_t index;
+    uint32_t pc; // Of WATCH_AT_PC and WATCH_WRITE records, 0 otherwise.
+};
+
+namespace
+{
+    const size_t WATCH_BUFFER_RECORDS = 4096;
+
+    // Watched signals of one storage size, so the per-cycle check is a plain
+    // compare loop per type.
+    template<typename T>
+    struct WatchGroup
+    {
+        int num_signals;
+        const T* data[WATCH_MAX_SIGNALS];
+        T previous[WATCH_MAX_SIGNALS];
+        uint32_t index[WATCH_MAX_SIGNALS];
+    };
+
+    struct WatchAtPc
+    {
+        SignalRef ref;
+        uint32_t index;
+        int num_pcs;
+        uint32_t pcs[WATCH_MAX_PCS];
+    };
+
+    struct WatchWrite
+    {
+        uint32_t address;
+        uint32_t index;
+    };
+
+    // A parsed line of the watch file.
+    struct WatchEntry
+    {
+        int kind;
+        SignalRef ref;
+        uint32_t address;
+        int num_pcs;
+        uint32_t pcs[WATCH_MAX_PCS];
+    };
+
+    struct WatchList
+    {
+        FILE* fp;
+        int num_signals;
+        WatchGroup<uint8_t> signals8;
+        WatchGroup<uint16_t> signals16;
+        WatchGroup<uint32_t> signals32;
+        WatchGroup<uint64_t> signals64;
+        int num_at_pc;
+        WatchAtPc at_pc[WATCH_MAX_SIGNALS];
+        int num_writes;
+        WatchWrite writes[WATCH_MAX_SIGNALS];
+
+        uint64_t num_records_written;
+        size_t num_records;
+        WatchRecord records[WATCH_BUFFER_RECORDS];
+    };
+
+    void watch_flush(WatchList* watch)
+    {
+        if(watch->num_records == 0) return;
+        fwrite(watch->records, sizeof(WatchRecord), watch->num_records, watch->fp);
+        watch->num_records_written += watch->num_records;
+        watch->num_records = 0;
+    }
+
+    inline void watch_write(WatchList* watch, uint64_t timestamp, uint32_t index, uint64_t value, uint32_t pc = 0)
+    {
+        if(watch->num_records == WATCH_BUFFER_RECORDS)
+            watch_flush(watch);
+
+        WatchRecord& record = watch->records[watch->num_records++];
+        record.timestamp = timestamp;
+        record.value     = value;
+        record.index     = index;
+        record.pc        = pc;
+    }
+
+    template<typename T>
+    void watch_add(WatchGroup<T>* group, const void* data, uint32_t index)
+    {
+        int i = group->num_signals++;
+        group->data[i]     = (const T*)data;
+        group->previous[i] = *group->data[i];
+        group->index[i]    = index;
+    }
+
+    template<typename T>
+    inline void watch_check(WatchList* watch, WatchGroup<T>* group, uint64_t timestamp)
+    {
+        for(int i = 0; i < group->num_signals; ++i)
+        {
+            T value = *group->data[i];
+            if(value != group->previous[i])
+            {
+                group->previous[i] = value;
+                watch_write(watch, timestamp, group->index[i], value);
+            }
+        }
+    }
+
+    // Parses a line of the watch file into entry, returns false for comments
+    // and, after reporting them, invalid lines.
+    bool watch_parse(const SignalInfo* signals, size_t num_signals, const char* line, WatchEntry* entry, std::string* name)
+    {
+        char first[256];
+        if(sscanf(line, "%255s", first) != 1 || first[0] == '#') return false;
+        const char* rest = strstr(line, first) + strlen(first);
+
+        char text[32];
+        if(strcmp(first, "write") == 0)
+        {
+            char* end;
+            entry->kind      = WATCH_WRITE;
+            entry->address   = strtoul(rest, &end, 0);
+            entry->ref.width = 8;
+            if(end == rest)
+            {
+                fprintf(stderr, "Missing address of write watch.\n");
+                return false;
+            }
+            snprintf(text, sizeof(text), "write 0x%06X", entry->address);
+            *name = text;
+            return true;
+        }
+
+        if(!signal_resolve(signals, num_signals, first, &entry->ref)) return false;
+        if(entry->ref.size > 8)
+        {
+            fprintf(stderr, "Signal %s is wider than 64 bits and can't be watched.\n", first);
+            return false;
+        }
+        *name = first;
+
+        const char* at = strchr(rest, '@');
+        if(!at)
+        {
+            entry->kind = WATCH_CHANGE;
+            return true;
+        }
+
+        entry->kind    = WATCH_AT_PC;
+        entry->num_pcs = 0;
+        const char* pcs = at + 1;
+        for(;;)
+        {
+            char* end;
+            uint32_t pc = strtoul(pcs, &end, 0);
+            if(end == pcs) break;
+            pcs = end;
+            if(entry->num_pcs == WATCH_MAX_PCS)
+            {
+                fprintf(stderr, "Too many PCs for %s, ignoring 0x%06X.\n", first, pc);
+                continue;
+            }
+            entry->pcs[entry->num_pcs++] = pc;
+            snprintf(text, sizeof(text), "%s0x%06X", (entry->num_pcs == 1)? " @ ": " ", pc);
+            *name += text;
+        }
+        if(entry->num_pcs == 0)
+        {
+            fprintf(stderr, "Missing PCs of %s.\n", first);
+            return false;
+        }
+        return true;
+    }
+
+    // Opens a watch log for the entries of watch_filepath. Unknown signals
+    // are reported and skipped. Returns nullptr if nothing could be watched.
+    WatchList* watch_open(const char* filepath, const char* watch_filepath, const SignalInfo* signals, size_t num_signals, uint64_t timestamp)
+    {
+        FILE* watch_fp = fopen(watch_filepath, "r");
+        if(!watch_fp)
+        {
+            fprintf(stderr, "Error opening watch file %s.\n", watch_filepath);
+            return nullptr;
+        }
+
+        std::vector<WatchEntry> entries;
+        std::vector<std::string> names;
+        char line[256];
+        while(fgets(line, sizeof(line), watch_fp))
+        {
+            WatchEntry entry = {};
+            std::string name;
+            if(!watch_parse(signals, num_signals, line, &entry, &name)) continue;
+
+            if(entries.size() == WATCH_MAX_SIGNALS)
+            {
+                fprintf(stderr, "Too many watched signals, ignoring %s.\n", name.c_str());
+                continue;
+            }
+            entries.push_back(entry);
+            names.push_back(name);
+        }
+        fclose(watch_fp);
+
+        int num_refs = entries.size();
+        if(num_refs == 0)
+        {
+            fprintf(stderr, "No signals to watch in %s.\n", watch_filepath);
+            return nullptr;
+        }
+
+        FILE* fp = fopen(filepath, "wb");
+        if(!fp)
+        {
+            fprintf(stderr, "Error opening watch log %s.\n", filepath);
+            return nullptr;
+        }
+
+        WatchHeader header = {WATCH_MAGIC, WATCH_VERSION, (uint32_t)num_refs, 0};
+        fwrite(&header, sizeof(header), 1, fp);
+
+        WatchList* watch = new WatchList;
+        watch->fp                    = fp;
+        watch->num_signals           = num_refs;
+        watch->signals8.num_signals  = 0;
+        watch->signals16.num_signals = 0;
+        watch->signals32.num_signals = 0;
+        watch->signals64.num_signals = 0;
+        watch->num_at_pc             = 0;
+        watch->num_writes            = 0;
+        watch->num_records_written   = 0;
+        watch->num_records           = 0;
+
+        for(int i = 0; i < num_refs; ++i)
+        {
+            const WatchEntry& entry = entries[i];
+            const SignalRef& ref = entry.ref;
+            uint32_t kind        = entry.kind;
+            uint32_t name_length = names[i].size();
+            fwrite(&ref.width, sizeof(ref.width), 1, fp);
+            fwrite(&kind, sizeof(kind), 1, fp);
+            fwrite(&name_length, sizeof(name_length), 1, fp);
+            fwrite(names[i].data(), 1, name_length, fp);
+
+            if(entry.kind == WATCH_WRITE)
+            {
+                watch->writes[watch->num_writes++] = {entry.address, (uint32_t)i};
+                continue;
+            }
+            if(entry.kind == WATCH_AT_PC)
+            {
+                WatchAtPc& at_pc = watch->at_pc[watch->num_at_pc++];
+                at_pc.ref     = ref;
+                at_pc.index   = i;
+                at_pc.num_pcs = entry.num_pcs;
+                memcpy(at_pc.pcs, entry.pcs, sizeof(entry.pcs));
+                continue;
+            }
+
+            switch(ref.size)
+            {
+                case 1:  watch_add(&watch->signals8,  ref.data, i); break;
+                case 2:  watch_add(&watch->signals16, ref.data, i); break;
+                case 4:  watch_add(&watch->signals32, ref.data, i); break;
+                default: watch_add(&watch->signals64, ref.data, i); break;
+            }
+            watch_write(watch, timestamp, i, signal_read(ref));
+        }
+
+        return watch;
+    }
+
+    void watch_close(WatchList* watch)
+    {
+        watch_flush(watch);
+        fclose(watch->fp);
+        delete watch;
+    }
+
+    inline void watch_update(WatchList* watch, uint64_t timestamp)
+    {
+        watch_check(watch, &watch->signals8,  timestamp);
+        watch_check(watch, &watch->signals16, timestamp);
+        watch_check(watch, &watch->signals32, timestamp);
+        watch_check(watch, &watch->signals64, timestamp);
+    }
+
+    // Call when an instruction retires, pc being its physical address.
+    inline void watch_instruction(WatchList* watch, uint64_t timestamp, uint32_t pc)
+    {
+        for(int i = 0; i < watch->num_at_pc; ++i)
+        {
+            const WatchAtPc& at_pc = watch->at_pc[i];
+            for(int j = 0; j < at_pc.num_pcs; ++j)
+                if(at_pc.pcs[j] == pc)
+                    watch_write(watch, timestamp, at_pc.index, signal_read(at_pc.ref), pc);
+        }
+    }
+
+    // Call every simulation step, pc being the physical address of the
+    // current instruction.
+    inline void watch_bus(WatchList* watch, uint64_t timestamp, const BusAccess& bus_access, uint32_t pc)
+    {
+        if(!bus_access.is_new || bus_access.type != BUS_ACCESS_WRITE) return;
+        for(int i = 0; i < watch->num_writes; ++i)
+            if(watch->writes[i].address == bus_access.address)
+                watch_write(watch, timestamp, watch->writes[i].index, bus_access.data, pc);
+    }
+}
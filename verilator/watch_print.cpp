@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "watch.h"
+
+// Prints a watch log (see watch.h) as text, one record per line:
+//
+//     <timestamp>\t<signal>\t<value in hex>[\t<pc>]
+//
+// The PC is printed for signals watched at PCs and for bus writes.
+//
+// Usage: watch_print <watch log> [signal...]
+//     Only prints the given signals if any are listed, "write" selects all
+//     bus writes.
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <watch log> [signal...]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* fp = fopen(argv[1], "rb");
+    if(!fp)
+    {
+        fprintf(stderr, "Error opening %s.\n", argv[1]);
+        return 1;
+    }
+
+    WatchHeader header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != WATCH_MAGIC || header.version != WATCH_VERSION)
+    {
+        fprintf(stderr, "%s is not a watch log.\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<std::string> names(header.num_signals);
+    std::vector<int> num_digits(header.num_signals);
+    std::vector<uint32_t> kinds(header.num_signals);
+    std::vector<bool> selected(header.num_signals, argc == 2);
+    for(uint32_t i = 0; i < header.num_signals; ++i)
+    {
+        uint32_t width, name_length;
+        if(fread(&width, sizeof(width), 1, fp) != 1 || fread(&kinds[i], sizeof(kinds[i]), 1, fp) != 1 ||
+           fread(&name_length, sizeof(name_length), 1, fp) != 1)
+        {
+            fprintf(stderr, "Error: Truncated watch log header.\n");
+            return 1;
+        }
+        names[i].resize(name_length);
+        fread(&names[i][0], 1, name_length, fp);
+        num_digits[i] = (width + 3) / 4;
+
+        // Names of watches at PCs and of writes have arguments after a space.
+        std::string base = names[i].substr(0, names[i].find(' '));
+        for(int j = 2; j < argc; ++j)
+            if(names[i] == argv[j] || base == argv[j]) selected[i] = true;
+    }
+
+    WatchRecord records[4096];
+    size_t num_read;
+    while((num_read = fread(records, sizeof(WatchRecord), 4096, fp)) > 0)
+    {
+        for(size_t i = 0; i < num_read; ++i)
+        {
+            const WatchRecord& record = records[i];
+            if(record.index >= header.num_signals || !selected[record.index]) continue;
+            printf("%llu\t%s\t0x%0*llX",
+                (unsigned long long)record.timestamp, names[record.index].c_str(),
+                num_digits[record.index], (unsigned long long)record.value
+            );
+            if(kinds[record.index] == WATCH_CHANGE)
+                printf("\n");
+            else
+                printf("\t0x%06X\n", record.pc);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}